@@ -9,25 +9,76 @@ TRANSLATIONS += \
 
 TEMPLATE = app
 
+# Debug messages (MYDEBUG) are compiled out of release builds, see humlog.h
+CONFIG(release, debug|release): DEFINES += HUM_LOG_COMPILE_LEVEL=HUM_LOG_INFO
+
+# shm_open() is in librt before glibc 2.34
+linux: LIBS += -lrt
+
 SOURCES += \
     MariaDBInterface.cpp \
+    broadcaster.cpp \
+    compactjson.cpp \
     controllerinterface.cpp \
+    controllerpool.cpp \
     databridge.cpp \
+    examcache.cpp \
+    examfile.cpp \
+    examhttpstream.cpp \
+    examindex.cpp \
+    examsummary.cpp \
+    framedecoder.cpp \
+    framestreamserver.cpp \
+    humatric_protocol.cpp \
+    humlog.cpp \
+    licenserenewal.cpp \
     licenseserverinterface.cpp \
     main.cpp \
+    metrics.cpp \
+    realtime.cpp \
+    replaysource.cpp \
+    serialcapture.cpp \
+    serialdiscovery.cpp \
     settings.cpp \
-    systemkeystore.cpp
+    shmframering.cpp \
+    startupsequence.cpp \
+    staticassets.cpp \
+    systemkeystore.cpp \
+    trace.cpp
 
 
 HEADERS += \
     MariaDBInterface.h \
+    broadcaster.h \
+    compactjson.h \
     controllerinterface.h \
+    controllerpool.h \
     databridge.h \
+    examcache.h \
+    examdata.h \
+    examfile.h \
+    examhttpstream.h \
+    examindex.h \
+    examsummary.h \
+    framedecoder.h \
+    framestreamserver.h \
     humatric_protocol.h \
+    humlog.h \
+    humshm.h \
     humtoken.h \
+    licenserenewal.h \
     licenseserverinterface.h \
+    metrics.h \
+    realtime.h \
+    replaysource.h \
+    serialcapture.h \
+    serialdiscovery.h \
     settings.h \
+    shmframering.h \
+    startupsequence.h \
+    staticassets.h \
     systemkeystore.h \
+    trace.h \
     websockettransport.h
 
 RESOURCES +=
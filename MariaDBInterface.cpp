@@ -1,5 +1,13 @@
 #include "MariaDBInterface.h"
 #include "settings.h"
+#include "examsummary.h"
+#include "examindex.h"
+#include "examfile.h"
+#include "metrics.h"
+#include "trace.h"
+#include <QJsonArray>
+#include <algorithm>
+#include <limits>
 #include <QDebug>
 
 MariaDBInterface::MariaDBInterface(QObject *parent)
@@ -9,7 +17,9 @@ MariaDBInterface::MariaDBInterface(QObject *parent)
 
 bool MariaDBInterface::connect(const QString &host, int port, const QString &user, const QString &password)
 {
-    db = QSqlDatabase::addDatabase("QMYSQL");
+    // Named connection: the interface lives in its own thread, queries must not
+    // go through the default connection of the main thread
+    db = QSqlDatabase::addDatabase("QMYSQL", dbName);
 
     db.setHostName(host);
     db.setPort(port);
@@ -26,9 +36,58 @@ bool MariaDBInterface::connect(const QString &host, int port, const QString &use
     return true;
 }
 
+// Tables hanging off t_exams, shared by createDatabaseAndTables() and upgradeSchema()
+static QStringList examTables()
+{
+    return {
+        "CREATE TABLE IF NOT EXISTS t_exam_summaries ("
+        "  IDexam INT PRIMARY KEY,"
+        "  frame_count INT UNSIGNED NOT NULL,"
+        "  duration_ms INT UNSIGNED NOT NULL,"
+        "  peak_fz SMALLINT NOT NULL,"
+        "  pads VARCHAR(1024) NOT NULL DEFAULT '',"         // global pads, "1,2,17"
+        "  fx_min SMALLINT, fx_max SMALLINT, fx_mean DOUBLE,"
+        "  fy_min SMALLINT, fy_max SMALLINT, fy_mean DOUBLE,"
+        "  fz_min SMALLINT, fz_max SMALLINT, fz_mean DOUBLE,"
+        "  mx_min SMALLINT, mx_max SMALLINT, mx_mean DOUBLE,"
+        "  my_min SMALLINT, my_max SMALLINT, my_mean DOUBLE,"
+        "  mz_min SMALLINT, mz_max SMALLINT, mz_mean DOUBLE,"
+        "  preview VARBINARY(1024),"
+        "  FOREIGN KEY (IDexam) REFERENCES t_exams(ID) ON DELETE CASCADE"
+        ");",
+        // frames split in chunks, (t_start, t_end) is the sparse time index
+        "CREATE TABLE IF NOT EXISTS t_exam_chunks ("
+        "  IDexam INT NOT NULL,"
+        "  seq INT NOT NULL,"
+        "  first_sample INT UNSIGNED NOT NULL,"
+        "  t_start INT UNSIGNED NOT NULL,"
+        "  t_end INT UNSIGNED NOT NULL,"
+        "  sample_count INT NOT NULL,"
+        "  data MEDIUMBLOB NOT NULL,"
+        "  PRIMARY KEY (IDexam, seq),"
+        "  INDEX idx_chunks_time (IDexam, t_start, t_end),"
+        "  FOREIGN KEY (IDexam) REFERENCES t_exams(ID) ON DELETE CASCADE"
+        ");",
+        // one pyramid per pad; pad 255 (ExamIndexBuilder::ALL_PADS) is the all pads
+        // pyramid of the exams stored before
+        "CREATE TABLE IF NOT EXISTS t_exam_pyramid ("
+        "  IDexam INT NOT NULL,"
+        "  pad TINYINT UNSIGNED NOT NULL DEFAULT 255,"
+        "  level INT NOT NULL,"
+        "  bucket_ms INT UNSIGNED NOT NULL,"
+        "  t0 INT UNSIGNED NOT NULL,"
+        "  bucket_count INT NOT NULL,"
+        "  data LONGBLOB NOT NULL,"
+        "  PRIMARY KEY (IDexam, pad, level),"
+        "  FOREIGN KEY (IDexam) REFERENCES t_exams(ID) ON DELETE CASCADE"
+        ");"
+    };
+}
+
 bool MariaDBInterface::databaseExists()
 {
-    QSqlQuery query("SHOW DATABASES LIKE 'humDB'");
+    QSqlQuery query(db);
+    query.exec("SHOW DATABASES LIKE 'humDB'");
     return query.next();
 }
 
@@ -37,7 +96,16 @@ bool MariaDBInterface::ensureDatabaseAndTables()
     if (databaseExists())
     {
         MYDEBUG << "Database 'humDB' already exists.";
-        return true;
+
+        QSqlQuery query(db);
+        if (!query.exec("USE humDB;"))
+        {
+            MYCRITICAL << "SQL error:" << query.lastError().text();
+            return false;
+        }
+
+        //i DB creati con versioni precedenti vanno aggiornati
+        return upgradeSchema();
     }
 
     return createDatabaseAndTables();
@@ -54,7 +122,8 @@ bool MariaDBInterface::createDatabaseAndTables()
         "  name VARCHAR(255) NOT NULL,"
         "  surname VARCHAR(255) NOT NULL,"
         "  height_cm INT,"
-        "  weight_kg INT"
+        "  weight_kg INT,"
+        "  INDEX idx_patients_surname_name (surname, name)"
         ");",
         "CREATE TABLE t_types ("
         "  ID INT AUTO_INCREMENT PRIMARY KEY,"
@@ -66,13 +135,46 @@ bool MariaDBInterface::createDatabaseAndTables()
         "  IDpatient INT NOT NULL,"
         "  date DATE NOT NULL,"
         "  time TIME NOT NULL,"
-        "  frames BLOB,"
+        "  frames LONGBLOB,"        // only exams saved before t_exam_chunks
+        "  sample_rate INT,"
+        "  channel_mask INT UNSIGNED,"
+        "  INDEX idx_exams_patient_date (IDpatient, date, time),"
+        "  INDEX idx_exams_type_date (IDexa, date, time),"
         "  FOREIGN KEY (IDexa) REFERENCES t_types(ID),"
         "  FOREIGN KEY (IDpatient) REFERENCES t_patients(ID)"
         ");"
     };
+    sqlStatements << examTables();
+
+    QSqlQuery query(db);
+    for (const QString &stmt : sqlStatements)
+    {
+        if (!query.exec(stmt))
+        {
+            MYCRITICAL << "SQL error:" << query.lastError().text();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MariaDBInterface::upgradeSchema()
+{
+    // Brings an existing database to the schema of createDatabaseAndTables()
+    QStringList sqlStatements = {
+        "CREATE INDEX IF NOT EXISTS idx_patients_surname_name ON t_patients (surname, name);",
+        "CREATE INDEX IF NOT EXISTS idx_exams_patient_date ON t_exams (IDpatient, date, time);",
+        "CREATE INDEX IF NOT EXISTS idx_exams_type_date ON t_exams (IDexa, date, time);",
+        "DROP INDEX IF EXISTS idx_exams_type ON t_exams;",     // replaced by idx_exams_type_date
+        "ALTER TABLE t_exams MODIFY frames LONGBLOB;",
+        "ALTER TABLE t_exams ADD COLUMN IF NOT EXISTS sample_rate INT,"
+        "  ADD COLUMN IF NOT EXISTS channel_mask INT UNSIGNED;"
+    };
+    sqlStatements << examTables();
+    sqlStatements << "ALTER TABLE t_exam_summaries ADD COLUMN IF NOT EXISTS pads VARCHAR(1024) NOT NULL DEFAULT '';";
 
-    QSqlQuery query;
+    QSqlQuery query(db);
     for (const QString &stmt : sqlStatements)
     {
         if (!query.exec(stmt))
@@ -82,9 +184,830 @@ bool MariaDBInterface::createDatabaseAndTables()
         }
     }
 
+    // pad_mask (pads 0..63 as bits) becomes the pads list, done once
+    if (query.exec("SHOW COLUMNS FROM t_exam_summaries LIKE 'pad_mask'") && query.next())
+    {
+        QSqlQuery update(db);
+        update.prepare("UPDATE t_exam_summaries SET pads = :pads WHERE IDexam = :exam");
+        if (!query.exec("SELECT IDexam, pad_mask FROM t_exam_summaries WHERE pad_mask <> 0"))
+        {
+            MYCRITICAL << "SQL error:" << query.lastError().text();
+            return false;
+        }
+        while (query.next())
+        {
+            const quint64 mask = query.value(1).toULongLong();
+            PadSet pads;
+            for (int pad = 0; pad < 64; ++pad)
+            {
+                pads[size_t(pad)] = (mask >> pad) & 1;
+            }
+            update.bindValue(":pads", ExamSummary::padsToText(pads));
+            update.bindValue(":exam", query.value(0).toInt());
+            if (!update.exec())
+            {
+                MYCRITICAL << "SQL error:" << update.lastError().text();
+                return false;
+            }
+        }
+        if (!query.exec("ALTER TABLE t_exam_summaries DROP COLUMN pad_mask"))
+        {
+            MYCRITICAL << "SQL error:" << query.lastError().text();
+            return false;
+        }
+    }
+
+    // per pad pyramids: the key changes, done once; the existing rows become ALL_PADS
+    if (query.exec("SHOW COLUMNS FROM t_exam_pyramid LIKE 'pad'") && !query.next())
+    {
+        if (!query.exec("ALTER TABLE t_exam_pyramid ADD COLUMN pad TINYINT UNSIGNED NOT NULL DEFAULT 255 AFTER IDexam,"
+                        "  DROP PRIMARY KEY, ADD PRIMARY KEY (IDexam, pad, level);"))
+        {
+            MYCRITICAL << "SQL error:" << query.lastError().text();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QVariantList MariaDBInterface::searchPatients(const QString &text, const QVariantMap &after, int pageSize, QVariantMap &next)
+{
+    HUM_TRACE("db", "searchPatients");
+    QVariantList rows;
+    next.clear();
+
+    // Matches the surname prefix so that idx_patients_surname_name is used for both
+    // the filter and the ordering; the cursor condition continues from the last row
+    // of the previous page instead of skipping rows with OFFSET
+    QString sql = "SELECT ID, name, surname, height_cm, weight_kg FROM t_patients"
+                  " WHERE surname LIKE :prefix";
+    if (!after.isEmpty())
+    {
+        sql += " AND (surname > :surname OR (surname = :surname AND"
+               " (name > :name OR (name = :name AND ID > :id))))";
+    }
+    sql += " ORDER BY surname, name, ID LIMIT :limit";
+
+    QString prefix = text.trimmed();
+    prefix.replace('\\', "\\\\").replace('%', "\\%").replace('_', "\\_");
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    query.bindValue(":prefix", prefix + '%');
+    if (!after.isEmpty())
+    {
+        query.bindValue(":surname", after.value("surname").toString());
+        query.bindValue(":name", after.value("name").toString());
+        query.bindValue(":id", after.value("ID").toInt());
+    }
+    query.bindValue(":limit", pageSize + 1);   // one more row tells if there is a next page
+
+    if (!query.exec())
+    {
+        MYWARNING << "SQL error:" << query.lastError().text();
+        return rows;
+    }
+
+    while (query.next())
+    {
+        if (rows.size() == pageSize)
+        {
+            const QVariantMap last = rows.last().toMap();
+            next["surname"] = last.value("surname");
+            next["name"] = last.value("name");
+            next["ID"] = last.value("ID");
+            break;
+        }
+
+        QVariantMap row;
+        row["ID"] = query.value(0);
+        row["name"] = query.value(1);
+        row["surname"] = query.value(2);
+        row["height_cm"] = query.value(3);
+        row["weight_kg"] = query.value(4);
+        rows.append(row);
+    }
+
+    return rows;
+}
+
+QVariantList MariaDBInterface::listExams(int patientID, int typeID, const QVariantMap &after, int pageSize, QVariantMap &next)
+{
+    HUM_TRACE("db", "listExams");
+    QVariantList rows;
+    next.clear();
+
+    // Newest exams first. With patientID the query runs on idx_exams_patient_date,
+    // with only typeID on idx_exams_type_date
+    // The summary comes from t_exam_summaries, frames are never read here
+    QString sql = "SELECT e.ID, e.IDpatient, e.IDexa, t.exa_type, e.date, e.time,"
+                  " s.frame_count, s.duration_ms, s.peak_fz, s.preview"
+                  " FROM t_exams e JOIN t_types t ON t.ID = e.IDexa"
+                  " LEFT JOIN t_exam_summaries s ON s.IDexam = e.ID WHERE 1 = 1";
+    if (patientID > 0)
+    {
+        sql += " AND e.IDpatient = :patient";
+    }
+    if (typeID > 0)
+    {
+        sql += " AND e.IDexa = :type";
+    }
+    if (!after.isEmpty())
+    {
+        sql += " AND (e.date < :date OR (e.date = :date AND"
+               " (e.time < :time OR (e.time = :time AND e.ID < :id))))";
+    }
+    sql += " ORDER BY e.date DESC, e.time DESC, e.ID DESC LIMIT :limit";
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    if (patientID > 0)
+    {
+        query.bindValue(":patient", patientID);
+    }
+    if (typeID > 0)
+    {
+        query.bindValue(":type", typeID);
+    }
+    if (!after.isEmpty())
+    {
+        query.bindValue(":date", after.value("date").toDate());
+        query.bindValue(":time", after.value("time").toTime());
+        query.bindValue(":id", after.value("ID").toInt());
+    }
+    query.bindValue(":limit", pageSize + 1);
+
+    if (!query.exec())
+    {
+        MYWARNING << "SQL error:" << query.lastError().text();
+        return rows;
+    }
+
+    while (query.next())
+    {
+        if (rows.size() == pageSize)
+        {
+            const QVariantMap last = rows.last().toMap();
+            next["date"] = last.value("date");
+            next["time"] = last.value("time");
+            next["ID"] = last.value("ID");
+            break;
+        }
+
+        QVariantMap row;
+        row["ID"] = query.value(0);
+        row["IDpatient"] = query.value(1);
+        row["IDexa"] = query.value(2);
+        row["exa_type"] = query.value(3);
+        row["date"] = query.value(4).toDate().toString(Qt::ISODate);
+        row["time"] = query.value(5).toTime().toString(Qt::ISODate);
+        if (!query.isNull(6))
+        {
+            row["frame_count"] = query.value(6);
+            row["duration_ms"] = query.value(7);
+            row["peak_fz"] = query.value(8);
+            row["preview"] = QString::fromLatin1(query.value(9).toByteArray().toBase64());
+        }
+        rows.append(row);
+    }
+
+    return rows;
+}
+
+int MariaDBInterface::saveExam(int patientID, int typeID, const QDateTime &start, int sampleRate, quint32 channelMask,
+                               ExamIndexBuilder &index, const ExamSummary &summary)
+{
+    HUM_TRACE("db", "saveExam");
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!db.transaction())
+    {
+        MYWARNING << "Cannot start transaction:" << db.lastError().text();
+        return -1;
+    }
+
+    const int examID = insertExam(patientID, typeID, start, sampleRate, channelMask);
+    if (examID < 0)
+    {
+        db.rollback();
+        return -1;
+    }
+
+    // the chunks completed while acquiring, then the last partial one
+    if (!insertChunks(examID, index))
+    {
+        db.rollback();
+        return -1;
+    }
+    index.finish();
+
+    if (!insertChunks(examID, index) || !insertPyramid(examID, index) || !insertSummary(examID, summary))
+    {
+        db.rollback();
+        return -1;
+    }
+
+    if (!db.commit())
+    {
+        MYWARNING << "Commit failed:" << db.lastError().text();
+        return -1;
+    }
+
+    metrics().dbWriteLatency.recordSince(timer);
+    MYDEBUG << "Exam" << examID << "saved," << summary.frameCount() << "frames";
+    return examID;
+}
+
+int MariaDBInterface::insertExam(int patientID, int typeID, const QDateTime &start, int sampleRate, quint32 channelMask)
+{
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO t_exams (IDexa, IDpatient, date, time, sample_rate, channel_mask)"
+                  " VALUES (:type, :patient, :date, :time, :rate, :mask)");
+    query.bindValue(":type", typeID);
+    query.bindValue(":patient", patientID);
+    query.bindValue(":date", start.date());
+    query.bindValue(":time", start.time());
+    query.bindValue(":rate", sampleRate);
+    query.bindValue(":mask", channelMask);
+    if (!query.exec())
+    {
+        MYWARNING << "SQL error:" << query.lastError().text();
+        return -1;
+    }
+
+    return query.lastInsertId().toInt();
+}
+
+bool MariaDBInterface::insertChunks(int examID, ExamIndexBuilder &index)
+{
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO t_exam_chunks (IDexam, seq, first_sample, t_start, t_end, sample_count, data)"
+                  " VALUES (:exam, :seq, :first, :tstart, :tend, :count, :data)");
+
+    while (index.hasChunk())
+    {
+        const ExamIndexBuilder::Chunk chunk = index.takeChunk();
+        query.bindValue(":exam", examID);
+        query.bindValue(":seq", chunk.seq);
+        query.bindValue(":first", chunk.firstSample);
+        query.bindValue(":tstart", chunk.tStart);
+        query.bindValue(":tend", chunk.tEnd);
+        query.bindValue(":count", chunk.count);
+        query.bindValue(":data", chunk.data);
+        if (!query.exec())
+        {
+            MYWARNING << "SQL error:" << query.lastError().text();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MariaDBInterface::insertPyramid(int examID, const ExamIndexBuilder &index)
+{
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO t_exam_pyramid (IDexam, pad, level, bucket_ms, t0, bucket_count, data)"
+                  " VALUES (:exam, :pad, :level, :bucketms, :t0, :count, :data)");
+
+    const QList<quint8> pads = index.pyramidPads();
+    for (quint8 pad : pads)
+    {
+        for (int level = 0; level < index.pyramidLevels(pad); ++level)
+        {
+            const QByteArray data = index.pyramidLevel(pad, level);
+            query.bindValue(":exam", examID);
+            query.bindValue(":pad", pad);
+            query.bindValue(":level", level);
+            query.bindValue(":bucketms", ExamIndexBuilder::bucketMs(level));
+            query.bindValue(":t0", index.startTimestamp());
+            query.bindValue(":count", data.size() / ExamIndexBuilder::PYRAMID_BUCKET_BYTES);
+            query.bindValue(":data", data);
+            if (!query.exec())
+            {
+                MYWARNING << "SQL error:" << query.lastError().text();
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool MariaDBInterface::insertSummary(int examID, const ExamSummary &summary)
+{
+    QStringList columns = { "IDexam", "frame_count", "duration_ms", "peak_fz", "pads", "preview" };
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        const QString name = QString::fromLatin1(examChannelNames[c]);
+        columns << name + "_min" << name + "_max" << name + "_mean";
+    }
+
+    QSqlQuery query(db);
+    query.prepare(QString("INSERT INTO t_exam_summaries (%1) VALUES (:%2)")
+                      .arg(columns.join(", "), columns.join(", :")));
+    query.bindValue(":IDexam", examID);
+    query.bindValue(":frame_count", summary.frameCount());
+    query.bindValue(":duration_ms", summary.durationMs());
+    query.bindValue(":peak_fz", summary.peakFz());
+    query.bindValue(":pads", ExamSummary::padsToText(summary.padSet()));
+    query.bindValue(":preview", summary.preview());
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        const QString name = QString::fromLatin1(examChannelNames[c]);
+        query.bindValue(":" + name + "_min", summary.channelMin(c));
+        query.bindValue(":" + name + "_max", summary.channelMax(c));
+        query.bindValue(":" + name + "_mean", summary.channelMean(c));
+    }
+    if (!query.exec())
+    {
+        MYWARNING << "SQL error:" << query.lastError().text();
+        return false;
+    }
+
+    return true;
+}
+
+ExamCache::Entry MariaDBInterface::loadExam(int examID)
+{
+    HUM_TRACE("db", "loadExam");
+    ExamCache::Entry samples = cache.get(examID);
+    if (!samples)
+    {
+        samples = ExamCache::Entry::create(readChunks(examID, 0, std::numeric_limits<quint32>::max()));
+        if (!samples->isEmpty())
+        {
+            cache.insert(examID, samples);
+        }
+    }
+    return samples;
+}
+
+ExamSamples MariaDBInterface::readExamRange(int examID, quint32 fromMs, quint32 toMs)
+{
+    HUM_TRACE("db", "readExamRange");
+    ExamCache::Entry cached = cache.get(examID);
+    if (!cached)
+    {
+        return readChunks(examID, fromMs, toMs);
+    }
+
+    // samples are in timestamp order
+    auto first = std::lower_bound(cached->cbegin(), cached->cend(), fromMs,
+                                  [](const ExamSample &s, quint32 t) { return s.timestamp < t; });
+    auto last = std::upper_bound(first, cached->cend(), toMs,
+                                 [](quint32 t, const ExamSample &s) { return t < s.timestamp; });
+    return ExamSamples(first, last);
+}
+
+QVector<ExamChunkInfo> MariaDBInterface::examChunks(int examID)
+{
+    HUM_TRACE("db", "examChunks");
+    QVector<ExamChunkInfo> chunks;
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT seq, first_sample, sample_count, t_start, t_end FROM t_exam_chunks"
+                  " WHERE IDexam = :exam ORDER BY seq");
+    query.bindValue(":exam", examID);
+    if (!query.exec())
+    {
+        MYWARNING << "SQL error:" << query.lastError().text();
+        return chunks;
+    }
+    while (query.next())
+    {
+        ExamChunkInfo chunk;
+        chunk.seq = query.value(0).toInt();
+        chunk.firstSample = query.value(1).toLongLong();
+        chunk.sampleCount = query.value(2).toInt();
+        chunk.tStart = query.value(3).toUInt();
+        chunk.tEnd = query.value(4).toUInt();
+        chunks.append(chunk);
+    }
+
+    if (chunks.isEmpty())
+    {
+        // exams stored before chunking
+        query.prepare("SELECT LENGTH(frames) FROM t_exams WHERE ID = :exam AND frames IS NOT NULL");
+        query.bindValue(":exam", examID);
+        if (query.exec() && query.next())
+        {
+            ExamChunkInfo legacy;
+            legacy.seq = -1;
+            legacy.sampleCount = int(query.value(0).toLongLong() / EXAM_SAMPLE_BYTES);
+            legacy.tEnd = std::numeric_limits<quint32>::max();
+            chunks.append(legacy);
+        }
+    }
+    return chunks;
+}
+
+QByteArray MariaDBInterface::readChunkData(int examID, int seq)
+{
+    HUM_TRACE("db", "readChunkData");
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (seq < 0)
+    {
+        query.prepare("SELECT frames FROM t_exams WHERE ID = :exam");
+    }
+    else
+    {
+        query.prepare("SELECT data FROM t_exam_chunks WHERE IDexam = :exam AND seq = :seq");
+        query.bindValue(":seq", seq);
+    }
+    query.bindValue(":exam", examID);
+    if (!query.exec() || !query.next())
+    {
+        MYWARNING << "Chunk" << seq << "of exam" << examID << "not found" << query.lastError().text();
+        return QByteArray();
+    }
+    return query.value(0).toByteArray();
+}
+
+ExamSamples MariaDBInterface::readChunks(int examID, quint32 fromMs, quint32 toMs)
+{
+    HUM_TRACE("db", "readChunks");
+    ExamSamples samples;
+
+    // Only the chunks overlapping [fromMs, toMs] are read, found through idx_chunks_time
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT data FROM t_exam_chunks"
+                  " WHERE IDexam = :exam AND t_start <= :to AND t_end >= :from ORDER BY seq");
+    query.bindValue(":exam", examID);
+    query.bindValue(":from", fromMs);
+    query.bindValue(":to", toMs);
+    if (!query.exec())
+    {
+        MYWARNING << "SQL error:" << query.lastError().text();
+        return samples;
+    }
+
+    bool chunked = false;
+    while (query.next())
+    {
+        chunked = true;
+        const QByteArray data = query.value(0).toByteArray();
+        for (int offset = 0; offset + EXAM_SAMPLE_BYTES <= data.size(); offset += EXAM_SAMPLE_BYTES)
+        {
+            const ExamSample s = readSample(data.constData() + offset);
+            if (s.timestamp >= fromMs && s.timestamp <= toMs)
+            {
+                samples.append(s);
+            }
+        }
+    }
+
+    if (!chunked)
+    {
+        // Exams stored before chunking: the whole frames BLOB has to be decoded
+        query.prepare("SELECT frames FROM t_exams WHERE ID = :exam AND frames IS NOT NULL");
+        query.bindValue(":exam", examID);
+        if (query.exec() && query.next())
+        {
+            const QByteArray data = query.value(0).toByteArray();
+            for (int offset = 0; offset + EXAM_SAMPLE_BYTES <= data.size(); offset += EXAM_SAMPLE_BYTES)
+            {
+                const ExamSample s = readSample(data.constData() + offset);
+                if (s.timestamp >= fromMs && s.timestamp <= toMs)
+                {
+                    samples.append(s);
+                }
+            }
+        }
+    }
+
+    return samples;
+}
+
+QVariantMap MariaDBInterface::readExamOverview(int examID, int pad, quint32 fromMs, quint32 toMs, int maxPoints)
+{
+    HUM_TRACE("db", "readExamOverview");
+    QVariantMap result;
+    if (toMs < fromMs || maxPoints <= 0)
+    {
+        return result;
+    }
+
+    // Finest level that fits in maxPoints buckets over the requested span
+    int level = 0;
+    const quint64 span = quint64(toMs) - fromMs + 1;     // 2^32 for the whole exam
+    while (span / ExamIndexBuilder::bucketMs(level) > quint64(maxPoints))
+    {
+        ++level;
+    }
+
+    // exams stored before per pad pyramids only have the ALL_PADS one
+    QSqlQuery query(db);
+    query.prepare("SELECT level, bucket_ms, t0, bucket_count, pad FROM t_exam_pyramid"
+                  " WHERE IDexam = :exam AND pad IN (:pad, :allpads) AND level <= :level"
+                  " ORDER BY pad = :allpads2, level DESC LIMIT 1");
+    query.bindValue(":exam", examID);
+    query.bindValue(":pad", pad);
+    query.bindValue(":allpads", int(ExamIndexBuilder::ALL_PADS));
+    query.bindValue(":allpads2", int(ExamIndexBuilder::ALL_PADS));
+    query.bindValue(":level", level);
+    if (!query.exec() || !query.next())
+    {
+        MYWARNING << "No pyramid for exam" << examID << "pad" << pad << query.lastError().text();
+        return result;
+    }
+
+    level = query.value(0).toInt();
+    const quint32 bucketMs = query.value(1).toUInt();
+    const quint32 t0 = query.value(2).toUInt();
+    const int bucketCount = query.value(3).toInt();
+    pad = query.value(4).toInt();
+
+    // Buckets are at fixed time steps, so only the needed bytes are fetched
+    const int first = fromMs > t0 ? qMin(int((fromMs - t0) / bucketMs), bucketCount) : 0;
+    const int last = toMs > t0 ? qMin(int((toMs - t0) / bucketMs), bucketCount - 1) : -1;
+    const int count = last - first + 1;
+
+    result["pad"] = pad;
+    result["level"] = level;
+    result["bucket_ms"] = bucketMs;
+    result["t_first"] = t0 + quint32(first) * bucketMs;
+    result["bucket_count"] = qMax(count, 0);
+    if (count <= 0)
+    {
+        result["data"] = QString();
+        return result;
+    }
+
+    query.prepare("SELECT SUBSTRING(data, :offset, :length) FROM t_exam_pyramid"
+                  " WHERE IDexam = :exam AND pad = :pad AND level = :level");
+    query.bindValue(":offset", first * ExamIndexBuilder::PYRAMID_BUCKET_BYTES + 1);
+    query.bindValue(":length", count * ExamIndexBuilder::PYRAMID_BUCKET_BYTES);
+    query.bindValue(":exam", examID);
+    query.bindValue(":pad", pad);
+    query.bindValue(":level", level);
+    if (!query.exec() || !query.next())
+    {
+        MYWARNING << "SQL error:" << query.lastError().text();
+        return {};
+    }
+
+    result["data"] = QString::fromLatin1(query.value(0).toByteArray().toBase64());
+    return result;
+}
+
+bool MariaDBInterface::exportExam(int examID, const QString &path)
+{
+    HUM_TRACE("db", "exportExam");
+    QSqlQuery query(db);
+    query.prepare("SELECT p.ID, p.name, p.surname, p.height_cm, p.weight_kg,"
+                  " e.IDexa, t.exa_type, e.date, e.time, e.sample_rate, e.channel_mask, s.pads"
+                  " FROM t_exams e JOIN t_patients p ON p.ID = e.IDpatient"
+                  " JOIN t_types t ON t.ID = e.IDexa"
+                  " LEFT JOIN t_exam_summaries s ON s.IDexam = e.ID WHERE e.ID = :exam");
+    query.bindValue(":exam", examID);
+    if (!query.exec() || !query.next())
+    {
+        MYWARNING << "Exam" << examID << "not found" << query.lastError().text();
+        return false;
+    }
+
+    QJsonObject patient;
+    patient["ID"] = query.value(0).toInt();
+    patient["name"] = query.value(1).toString();
+    patient["surname"] = query.value(2).toString();
+    patient["height_cm"] = query.value(3).toInt();
+    patient["weight_kg"] = query.value(4).toInt();
+
+    QJsonObject exam;
+    exam["ID"] = examID;
+    exam["IDexa"] = query.value(5).toInt();
+    exam["exa_type"] = query.value(6).toString();
+    exam["date"] = query.value(7).toDate().toString(Qt::ISODate);
+    exam["time"] = query.value(8).toTime().toString(Qt::ISODate);
+
+    const quint32 sampleRate = query.value(9).toUInt();
+    const quint32 channelMask = query.value(10).toUInt();
+    const PadSet padSet = ExamSummary::padsFromText(query.value(11).toString());
+
+    QJsonArray pads;
+    for (size_t pad = 0; pad < padSet.size(); ++pad)
+    {
+        if (padSet.test(pad))
+        {
+            pads.append(int(pad));
+        }
+    }
+
+    QJsonObject padConfig;
+    padConfig["pads"] = pads;
+    padConfig["channel_mask"] = qint64(channelMask);
+
+    // samples are stored as sent by the pads
+    QJsonObject calibration;
+    calibration["applied"] = false;
+    calibration["units"] = "adc";
+
+    QJsonArray columns;
+    columns.append(QJsonObject{ { "name", "timestamp" }, { "type", "u32" }, { "unit", "ms" } });
+    columns.append(QJsonObject{ { "name", "pad" }, { "type", "u8" } });
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        columns.append(QJsonObject{ { "name", examChannelNames[c] }, { "type", "i16" } });
+    }
+
+    QJsonObject metadata;
+    metadata["format"] = "HumServer exam";
+    metadata["patient"] = patient;
+    metadata["exam"] = exam;
+    metadata["pad_configuration"] = padConfig;
+    metadata["calibration"] = calibration;
+    metadata["sample_rate"] = qint64(sampleRate);
+    metadata["columns"] = columns;
+
+    ExamFileWriter writer;
+    if (!writer.open(path, metadata, sampleRate, channelMask))
+    {
+        return false;
+    }
+
+    // One chunk at a time by primary key: the driver buffers whole result sets,
+    // a single query over all chunks would pull the entire exam in memory
+    QSqlQuery chunkQuery(db);
+    chunkQuery.prepare("SELECT data FROM t_exam_chunks WHERE IDexam = :exam AND seq = :seq");
+    int chunks = 0;
+    for (;; ++chunks)
+    {
+        chunkQuery.bindValue(":exam", examID);
+        chunkQuery.bindValue(":seq", chunks);
+        if (!chunkQuery.exec())
+        {
+            MYWARNING << "SQL error:" << chunkQuery.lastError().text();
+            writer.abort();
+            return false;
+        }
+        if (!chunkQuery.next())
+        {
+            break;
+        }
+
+        const QByteArray data = chunkQuery.value(0).toByteArray();
+        ExamSamples samples;
+        samples.reserve(data.size() / EXAM_SAMPLE_BYTES);
+        for (int offset = 0; offset + EXAM_SAMPLE_BYTES <= data.size(); offset += EXAM_SAMPLE_BYTES)
+        {
+            samples.append(readSample(data.constData() + offset));
+        }
+        if (!writer.writeBlock(samples))
+        {
+            MYWARNING << "Error writing" << path << ":" << writer.errorString();
+            writer.abort();
+            return false;
+        }
+    }
+
+    if (chunks == 0)
+    {
+        // exams stored before chunking
+        const ExamSamples legacy = readChunks(examID, 0, std::numeric_limits<quint32>::max());
+        for (int i = 0; i < legacy.size(); i += ExamIndexBuilder::CHUNK_SAMPLES)
+        {
+            if (!writer.writeBlock(legacy.mid(i, ExamIndexBuilder::CHUNK_SAMPLES)))
+            {
+                writer.abort();
+                return false;
+            }
+        }
+    }
+
+    if (!writer.close())
+    {
+        return false;
+    }
+
+    MYDEBUG << "Exam" << examID << "exported to" << path;
     return true;
 }
 
+int MariaDBInterface::importExam(const QString &path, int patientID)
+{
+    HUM_TRACE("db", "importExam");
+    QElapsedTimer timer;
+    timer.start();
+
+    ExamFileReader reader;
+    if (!reader.open(path))
+    {
+        return -1;
+    }
+
+    const QJsonObject metadata = reader.metadata();
+    const QJsonObject patient = metadata.value("patient").toObject();
+    const QJsonObject exam = metadata.value("exam").toObject();
+
+    if (!db.transaction())
+    {
+        MYWARNING << "Cannot start transaction:" << db.lastError().text();
+        return -1;
+    }
+
+    // IDs differ between sites: the exam type is matched by name. Two patients
+    // with the same name are not the same person, the caller says whose exam it is.
+    QSqlQuery query(db);
+    if (patientID > 0)
+    {
+        query.prepare("SELECT ID FROM t_patients WHERE ID = :id");
+        query.bindValue(":id", patientID);
+        if (!query.exec() || !query.next())
+        {
+            MYWARNING << "Import of" << path << ": patient" << patientID << "not found";
+            db.rollback();
+            return -1;
+        }
+    }
+    else
+    {
+        patientID = -1;
+        query.prepare("INSERT INTO t_patients (name, surname, height_cm, weight_kg)"
+                      " VALUES (:name, :surname, :height, :weight)");
+        query.bindValue(":name", patient.value("name").toString());
+        query.bindValue(":surname", patient.value("surname").toString());
+        query.bindValue(":height", patient.value("height_cm").toInt());
+        query.bindValue(":weight", patient.value("weight_kg").toInt());
+        if (query.exec())
+        {
+            patientID = query.lastInsertId().toInt();
+        }
+    }
+
+    query.prepare("INSERT INTO t_types (exa_type) VALUES (:type)"
+                  " ON DUPLICATE KEY UPDATE ID = LAST_INSERT_ID(ID)");
+    query.bindValue(":type", exam.value("exa_type").toString());
+    const int typeID = query.exec() ? query.lastInsertId().toInt() : -1;
+
+    if (patientID < 0 || typeID < 0)
+    {
+        MYWARNING << "SQL error:" << query.lastError().text();
+        db.rollback();
+        return -1;
+    }
+
+    const QDateTime start(QDate::fromString(exam.value("date").toString(), Qt::ISODate),
+                          QTime::fromString(exam.value("time").toString(), Qt::ISODate));
+    const int examID = insertExam(patientID, typeID, start, int(reader.header().sampleRate),
+                                  reader.header().channelMask);
+    if (examID < 0)
+    {
+        db.rollback();
+        return -1;
+    }
+
+    // Blocks are read in place from the mapped file and rechunked as they go
+    ExamIndexBuilder index;
+    ExamSummary summary;
+    for (int b = 0; b < reader.blockCount(); ++b)
+    {
+        const ExamFileReader::Block block = reader.block(b);
+        for (int i = 0; i < block.count; ++i)
+        {
+            ExamSample s;
+            s.timestamp = block.timestamps[i];
+            s.padAddress = block.pads[i];
+            s.controller = controllerOfPad(s.padAddress);
+            for (int c = 0; c < EXAM_CHANNELS; ++c)
+            {
+                s.channel[c] = block.channel[c][i];
+            }
+            index.addSample(s);
+            summary.addSample(s);
+        }
+        if (index.hasChunk() && !insertChunks(examID, index))
+        {
+            db.rollback();
+            return -1;
+        }
+    }
+    index.finish();
+
+    if (!insertChunks(examID, index) || !insertPyramid(examID, index) || !insertSummary(examID, summary))
+    {
+        db.rollback();
+        return -1;
+    }
+
+    if (!db.commit())
+    {
+        MYWARNING << "Commit failed:" << db.lastError().text();
+        return -1;
+    }
+
+    metrics().dbWriteLatency.recordSince(timer);
+    MYDEBUG << "Imported" << path << "as exam" << examID << "," << summary.frameCount() << "frames";
+    return examID;
+}
+
 void MariaDBInterface::exampleQuery()
 {
     MYDEBUG << "Placeholder for query implementation.";
@@ -5,6 +5,23 @@
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
+#include <QDateTime>
+#include "examdata.h"
+#include "examcache.h"
+
+class ExamSummary;
+class ExamIndexBuilder;
+
+// Storage chunk of an exam, as listed for streaming. Exams stored before chunking
+// have a single entry with seq -1 standing for the whole frames BLOB.
+struct ExamChunkInfo
+{
+    int seq = 0;
+    qint64 firstSample = 0;
+    int sampleCount = 0;
+    quint32 tStart = 0;
+    quint32 tEnd = 0;
+};
 
 class MariaDBInterface : public QObject
 {
@@ -16,13 +33,59 @@ public:
     bool connect(const QString &host, int port, const QString &user, const QString &password);
     bool ensureDatabaseAndTables();
 
+    // Keyset pagination: 'after' is the cursor returned in 'next' by the previous page
+    // (empty map for the first page). 'next' is left empty when there are no more rows.
+    QVariantList searchPatients(const QString &text, const QVariantMap &after, int pageSize, QVariantMap &next);
+    QVariantList listExams(int patientID, int typeID, const QVariantMap &after, int pageSize, QVariantMap &next);
+
+    // Stores an exam recorded live: 'index' and 'summary' were fed sample by sample
+    // while acquiring (DataBridge::startRecording()), here the index is finished and
+    // everything written. Returns the new t_exams.ID, -1 on error.
+    int saveExam(int patientID, int typeID, const QDateTime &start, int sampleRate, quint32 channelMask,
+                 ExamIndexBuilder &index, const ExamSummary &summary);
+
+    // Whole decoded exam, from the cache when possible
+    ExamCache::Entry loadExam(int examID);
+    ExamCache *examCache() { return &cache; }
+
+    // Samples with timestamp in [fromMs, toMs]: from the cache if the exam is there,
+    // otherwise reading only the chunks covering the range
+    ExamSamples readExamRange(int examID, quint32 fromMs, quint32 toMs);
+
+    // Min/max envelope of one pad over [fromMs, toMs] with at most maxPoints buckets,
+    // taken from the finest pyramid level that fits. Bucket layout is described in
+    // examindex.h. Exams stored before per pad pyramids give the all pads envelope,
+    // with "pad" ExamIndexBuilder::ALL_PADS in the result.
+    QVariantMap readExamOverview(int examID, int pad, quint32 fromMs, quint32 toMs, int maxPoints);
+
+    // Piecewise access for streaming: the chunk list in seq order (empty if the exam
+    // does not exist), then the data of one chunk at a time in the storage encoding
+    QVector<ExamChunkInfo> examChunks(int examID);
+    QByteArray readChunkData(int examID, int seq);
+
+    // Native exam file (examfile.h). Both stream one chunk at a time, the whole
+    // exam is never held in memory.
+    bool exportExam(int examID, const QString &path);
+    // The exam goes to patient 'patientID', which must exist, or with 0 to a new
+    // patient made from the file metadata: patients are never matched by name.
+    int importExam(const QString &path, int patientID = 0);     // new t_exams.ID, -1 on error
+
     // Placeholder method for future query
     void exampleQuery();
 
 private:
     QSqlDatabase db;
     QString dbName = "humDB";
+    ExamCache cache;
 
     bool databaseExists();
     bool createDatabaseAndTables();
-};
\ No newline at end of file
+    bool upgradeSchema();
+    ExamSamples readChunks(int examID, quint32 fromMs, quint32 toMs);
+
+    // saveExam()/importExam() steps, to be called inside a transaction
+    int insertExam(int patientID, int typeID, const QDateTime &start, int sampleRate, quint32 channelMask);
+    bool insertChunks(int examID, ExamIndexBuilder &index);
+    bool insertPyramid(int examID, const ExamIndexBuilder &index);
+    bool insertSummary(int examID, const ExamSummary &summary);
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <QtGlobal>
+
+// Process-wide count of heap allocations, for the "allocations per message"
+// figures of the benchmarks. On glibc malloc/calloc/realloc are interposed, so
+// Qt containers (which use malloc directly) are counted too; elsewhere only
+// operator new is.
+quint64 allocationCount();
+
+class AllocationScope
+{
+public:
+    AllocationScope() : start(allocationCount()) {}
+    quint64 count() const { return allocationCount() - start; }
+
+private:
+    quint64 start;
+};
@@ -0,0 +1,52 @@
+QT += core testlib websockets webchannel serialport
+QT -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = humbench
+
+# the benchmarks build the server sources directly
+INCLUDEPATH += ..
+
+SOURCES += \
+    alloccounter.cpp \
+    bench_logging.cpp \
+    bench_processing.cpp \
+    bench_protocol.cpp \
+    bench_storage.cpp \
+    bench_token.cpp \
+    bench_transport.cpp \
+    benchdata.cpp \
+    main.cpp \
+    ../broadcaster.cpp \
+    ../compactjson.cpp \
+    ../controllerinterface.cpp \
+    ../examindex.cpp \
+    ../examsummary.cpp \
+    ../framedecoder.cpp \
+    ../framestreamserver.cpp \
+    ../humatric_protocol.cpp \
+    ../humlog.cpp \
+    ../metrics.cpp \
+    ../serialcapture.cpp \
+    ../settings.cpp \
+    ../trace.cpp
+
+HEADERS += \
+    alloccounter.h \
+    bench_logging.h \
+    bench_processing.h \
+    bench_protocol.h \
+    bench_storage.h \
+    bench_token.h \
+    bench_transport.h \
+    benchdata.h \
+    ../broadcaster.h \
+    ../controllerinterface.h \
+    ../framestreamserver.h \
+    ../humlog.h \
+    ../humtoken.h \
+    ../trace.h \
+    ../websockettransport.h
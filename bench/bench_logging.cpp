@@ -0,0 +1,149 @@
+#include "bench_logging.h"
+#include "humlog.h"
+#include <QElapsedTimer>
+#include <QTest>
+#include <QThread>
+#include <functional>
+#include <vector>
+
+// Below the ring size, so that no call is measured while the ring is full
+static const int CALLS = HumLog::RING_SLOTS / 2;
+static const int ROUNDS = 50;
+
+// What MYDEBUG expands to when HUM_LOG_COMPILE_LEVEL excludes it
+#define BENCH_COMPILED_OUT  if (HUM_LOG_ALL > HUM_LOG_WARNINGS || HUM_LOG_ALL > logLevel) {} else HumLogLine(HUM_LOG_ALL, __FILE__, __LINE__)
+
+// Best of ROUNDS, the ring is emptied by the writer between rounds
+static double nsPerCall(const std::function<void(int)> &call)
+{
+    double best = 1e300;
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        HumLog::flush();
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < CALLS; ++i)
+        {
+            call(i);
+        }
+        best = qMin(best, double(timer.nsecsElapsed()) / CALLS);
+    }
+    return best;
+}
+
+static void report(const char *what, double ns)
+{
+    qInfo("%s: %.1f ns/call, %llu dropped", what, ns, (unsigned long long)HumLog::droppedCount());
+    QTest::setBenchmarkResult(ns, QTest::WalltimeNanoseconds);
+}
+
+void LoggingBench::initTestCase()
+{
+    // no sinks: the writer formats and throws away, only the caller side is measured
+    HumLog::start(QString(), 0, 0, false);
+}
+
+void LoggingBench::cleanupTestCase()
+{
+    logLevel = HUM_LOG_ALL;
+    HumLog::stop();
+}
+
+void LoggingBench::disabledCompileTime()
+{
+    logLevel = HUM_LOG_ALL;
+    report("compiled out", nsPerCall([](int i) {
+        BENCH_COMPILED_OUT << "sample" << i << "dropped";
+    }));
+}
+
+void LoggingBench::disabledRunTime()
+{
+    logLevel = HUM_LOG_WARNINGS;
+    report("filtered at run time", nsPerCall([](int i) {
+        MYDEBUG << "sample" << i << "dropped";
+    }));
+    logLevel = HUM_LOG_ALL;
+}
+
+void LoggingBench::enabled_data()
+{
+    QTest::addColumn<QString>("args");
+    QTest::newRow("text") << "text";
+    QTest::newRow("numbers") << "numbers";
+    QTest::newRow("QString") << "QString";
+}
+
+void LoggingBench::enabled()
+{
+    QFETCH(QString, args);
+    logLevel = HUM_LOG_ALL;
+    const QString port = QStringLiteral("/dev/ttyUSB0");
+
+    double ns = 0;
+    if (args == "text")
+    {
+        ns = nsPerCall([](int) { MYDEBUG << "Controller answered"; });
+    }
+    else if (args == "numbers")
+    {
+        ns = nsPerCall([](int i) { MYDEBUG << "pad" << (i & 15) << "seq" << quint32(i) << "fz" << 812.5 + i; });
+    }
+    else
+    {
+        ns = nsPerCall([&port](int i) { MYDEBUG << "Opened" << port << "attempt" << i; });
+    }
+    report(args.toLatin1().constData(), ns);
+}
+
+void LoggingBench::enabledFourThreads()
+{
+    logLevel = HUM_LOG_ALL;
+    const int THREADS = 4;
+    const int PER_THREAD = CALLS / THREADS;
+
+    double best = 1e300;
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        HumLog::flush();
+        std::vector<QThread *> threads;
+        std::vector<qint64> elapsed(THREADS);
+        for (int t = 0; t < THREADS; ++t)
+        {
+            threads.push_back(QThread::create([t, PER_THREAD, &elapsed]() {
+                QElapsedTimer timer;
+                timer.start();
+                for (int i = 0; i < PER_THREAD; ++i)
+                {
+                    MYDEBUG << "thread" << t << "sample" << i;
+                }
+                elapsed[t] = timer.nsecsElapsed();
+            }));
+        }
+        for (QThread *thread : threads)
+        {
+            thread->start();
+        }
+        qint64 total = 0;
+        for (int t = 0; t < THREADS; ++t)
+        {
+            threads[t]->wait();
+            delete threads[t];
+            total += elapsed[t];
+        }
+        best = qMin(best, double(total) / (PER_THREAD * THREADS));
+    }
+    report("4 threads", best);
+}
+
+// Previous macros: qDebug() formats on the calling thread, here into a handler
+// that discards the text so that no I/O is measured
+void LoggingBench::qDebugBaseline()
+{
+    QtMessageHandler previous = qInstallMessageHandler([](QtMsgType, const QMessageLogContext &, const QString &) {});
+    const double ns = nsPerCall([](int i) {
+        qDebug() << __FILE__ << ":" << __LINE__ << "pad" << (i & 15) << "seq" << quint32(i) << "fz" << 812.5 + i;
+    });
+    qInstallMessageHandler(previous);
+    report("qDebug() baseline", ns);
+}
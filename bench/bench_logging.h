@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QObject>
+
+// Cost of a log call on the calling thread, in nanoseconds per call: filtered
+// out at compile time, filtered out at run time, accepted and queued for the
+// writer thread, and the previous qDebug() path formatting on the caller.
+class LoggingBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void disabledCompileTime();
+    void disabledRunTime();
+    void enabled_data();
+    void enabled();
+    void enabledFourThreads();
+    void qDebugBaseline();
+};
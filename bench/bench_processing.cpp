@@ -0,0 +1,33 @@
+#include "bench_processing.h"
+#include "benchdata.h"
+#include "framestreamserver.h"
+#include "examsummary.h"
+#include <QTest>
+
+static void addBatchRows()
+{
+    QTest::addColumn<int>("samples");
+    QTest::newRow("20 ms") << 80;
+    QTest::newRow("1 s") << 4000;
+}
+
+void ProcessingBench::filter_data() { addBatchRows(); }
+void ProcessingBench::filter()
+{
+    QFETCH(int, samples);
+    const ExamSamples batch = syntheticSamples(samples);
+    StreamFilter streamFilter;
+    FilteredSamples out;
+    QBENCHMARK { streamFilter.run(batch, out); }
+    QCOMPARE(out.size(), batch.size());
+}
+
+void ProcessingBench::summary_data() { addBatchRows(); }
+void ProcessingBench::summary()
+{
+    QFETCH(int, samples);
+    const ExamSamples batch = syntheticSamples(samples);
+    ExamSummary examSummary;
+    QBENCHMARK { examSummary.addSamples(batch); }
+    QVERIFY(examSummary.frameCount() > 0);
+}
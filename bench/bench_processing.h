@@ -0,0 +1,17 @@
+#pragma once
+
+#include <QObject>
+
+// Per-batch processing on the acquisition path: the data stream low-pass
+// filter and the exam summary accumulated while recording. Batches are
+// one stream period (20 ms) and one second of 4 pads at 1 kHz.
+class ProcessingBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void filter_data();
+    void filter();
+    void summary_data();
+    void summary();
+};
@@ -0,0 +1,127 @@
+#include "bench_protocol.h"
+#include "benchdata.h"
+#include "controllerinterface.h"
+#include "framedecoder.h"
+#include "serialcapture.h"
+#include <QTest>
+#include <cstring>
+
+static const int STREAM_FRAMES = 4096;
+
+void ProtocolBench::crc16_data()
+{
+    QTest::addColumn<int>("bytes");
+    QTest::newRow("frame") << int(sizeof(T_Frame) - 6);
+    QTest::newRow("64") << 64;
+    QTest::newRow("1024") << 1024;
+}
+
+void ProtocolBench::crc16()
+{
+    QFETCH(int, bytes);
+    QByteArray data(bytes, Qt::Uninitialized);
+    for (int i = 0; i < bytes; ++i)
+    {
+        data[i] = char(i * 31);
+    }
+    const uint8_t *raw = reinterpret_cast<const uint8_t *>(data.constData());
+
+    uint16_t crc = 0;
+    QBENCHMARK { crc ^= ::crc16(raw, size_t(bytes)); }
+    Q_UNUSED(crc);
+}
+
+void ProtocolBench::buildCommand()
+{
+    QByteArray command;
+    QBENCHMARK { command = ControllerInterface::buildCommand(0x000F, CMD_START_STREAM); }
+    QCOMPARE(command.size(), int(sizeof(T_CommandBase)));
+}
+
+// GET_SERIAL_NUMBER answer, the response the startup probe decodes
+void ProtocolBench::handleResponse()
+{
+    T_SerialNumberResponse rsp;
+    memset(&rsp, 0, sizeof(rsp));
+    uint8_t *raw = reinterpret_cast<uint8_t *>(&rsp);
+    raw[0] = RSP_HEADER_MARKER >> 8;
+    raw[1] = RSP_HEADER_MARKER & 0xFF;
+    rsp.padAddress = 1;
+    rsp.commandCode = CMD_GET_SERIAL_NUMBER;
+    qstrncpy(rsp.serialID, "HUM-0042-7781", sizeof(rsp.serialID));
+    const uint16_t crc = ::crc16(raw + 2, sizeof(rsp) - 6);
+    raw[sizeof(rsp) - 4] = uint8_t(crc & 0xFF);
+    raw[sizeof(rsp) - 3] = uint8_t(crc >> 8);
+    rsp.eot1 = PROTOCOL_EOT;
+    rsp.eot2 = PROTOCOL_EOT;
+    const QByteArray data(reinterpret_cast<const char *>(&rsp), sizeof(rsp));
+
+    QVariant result;
+    QBENCHMARK { result = ControllerInterface::handleResponse(data); }
+    QCOMPARE(result.toString(), QString("HUM-0042-7781"));
+}
+
+// STREAM_FRAMES frames of 4 pads per iteration, demultiplexed from one byte
+// stream: delivered at once, in serial-sized reads, and with 1% bad CRCs
+void ProtocolBench::decodeStream_data()
+{
+    QTest::addColumn<int>("readSize");
+    QTest::addColumn<int>("corruptEvery");
+    QTest::newRow("whole buffer") << 0 << 0;
+    QTest::newRow("64 byte reads") << 64 << 0;
+    QTest::newRow("1% bad CRC") << 64 << 100;
+}
+
+void ProtocolBench::decodeStream()
+{
+    QFETCH(int, readSize);
+    QFETCH(int, corruptEvery);
+    const QByteArray stream = syntheticFrames(syntheticSamples(STREAM_FRAMES), corruptEvery);
+    const int step = readSize > 0 ? readSize : stream.size();
+
+    FrameDecoder decoder;
+    ExamSamples samples;
+    samples.reserve(STREAM_FRAMES);
+    QBENCHMARK
+    {
+        samples.resize(0);
+        for (int pos = 0; pos < stream.size(); pos += step)
+        {
+            decoder.feed(stream.constData() + pos, qMin(step, int(stream.size()) - pos), samples);
+        }
+    }
+    QCOMPARE(samples.size(), corruptEvery > 0 ? STREAM_FRAMES - STREAM_FRAMES / corruptEvery : STREAM_FRAMES);
+}
+
+// A field capture, chunked as it was read from the port
+void ProtocolBench::decodeCapture()
+{
+    const QString path = qEnvironmentVariable("HUM_BENCH_CAPTURE");
+    if (path.isEmpty())
+    {
+        QSKIP("HUM_BENCH_CAPTURE not set");
+    }
+    SerialCaptureReader reader;
+    QVERIFY2(reader.open(path), qPrintable(reader.errorString()));
+    QList<QByteArray> chunks;
+    SerialCaptureReader::Chunk chunk;
+    while (reader.next(chunk))
+    {
+        if (!chunk.sent)
+        {
+            chunks.append(chunk.data);
+        }
+    }
+
+    FrameDecoder decoder;
+    ExamSamples samples;
+    QBENCHMARK
+    {
+        samples.resize(0);
+        for (const QByteArray &data : std::as_const(chunks))
+        {
+            decoder.feed(data.constData(), int(data.size()), samples);
+        }
+    }
+    qInfo("%d chunks, %d frames per pass", int(chunks.size()), int(samples.size()));
+}
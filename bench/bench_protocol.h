@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QObject>
+
+// Controller protocol: CRC, command building, synchronous response decoding
+// and the streaming frame decoder on 4 interleaved pads. decodeCapture runs the
+// decoder on the capture file named by HUM_BENCH_CAPTURE (serialcapture.h).
+class ProtocolBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void crc16_data();
+    void crc16();
+    void buildCommand();
+    void handleResponse();
+    void decodeStream_data();
+    void decodeStream();
+    void decodeCapture();
+};
@@ -0,0 +1,69 @@
+#include "bench_storage.h"
+#include "benchdata.h"
+#include "examindex.h"
+#include <QTest>
+
+static const int EXAM_SAMPLES = 4 * 60 * 1000;
+
+void StorageBench::indexBuild()
+{
+    const ExamSamples samples = syntheticSamples(EXAM_SAMPLES);
+    int chunks = 0;
+    QBENCHMARK
+    {
+        ExamIndexBuilder index;
+        chunks = 0;
+        for (const ExamSample &s : samples)
+        {
+            index.addSample(s);
+            while (index.hasChunk())
+            {
+                index.takeChunk();
+                chunks++;
+            }
+        }
+        index.finish();
+        while (index.hasChunk())
+        {
+            index.takeChunk();
+            chunks++;
+        }
+    }
+    QCOMPARE(chunks, (EXAM_SAMPLES + ExamIndexBuilder::CHUNK_SAMPLES - 1) / ExamIndexBuilder::CHUNK_SAMPLES);
+}
+
+void StorageBench::encodeSamples()
+{
+    const ExamSamples samples = syntheticSamples(EXAM_SAMPLES);
+    QByteArray out;
+    out.reserve(EXAM_SAMPLES * EXAM_SAMPLE_BYTES);
+    QBENCHMARK
+    {
+        out.resize(0);
+        for (const ExamSample &s : samples)
+        {
+            appendSample(out, s);
+        }
+    }
+    QCOMPARE(out.size(), EXAM_SAMPLES * EXAM_SAMPLE_BYTES);
+}
+
+void StorageBench::decodeSamples()
+{
+    QByteArray data;
+    for (const ExamSample &s : syntheticSamples(EXAM_SAMPLES))
+    {
+        appendSample(data, s);
+    }
+    ExamSamples out;
+    out.reserve(EXAM_SAMPLES);
+    QBENCHMARK
+    {
+        out.resize(0);
+        for (int pos = 0; pos + EXAM_SAMPLE_BYTES <= data.size(); pos += EXAM_SAMPLE_BYTES)
+        {
+            out.append(readSample(data.constData() + pos));
+        }
+    }
+    QCOMPARE(out.size(), EXAM_SAMPLES);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <QObject>
+
+// Exam storage encoding: chunking plus min/max pyramid as saveExam() does it,
+// and the sample encoding alone both ways. One minute of 4 pads at 1 kHz.
+class StorageBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void indexBuild();
+    void encodeSamples();
+    void decodeSamples();
+};
@@ -0,0 +1,31 @@
+#include "bench_token.h"
+#include <QDateTime>
+#include <QDebug>
+#include "humtoken.h"
+#include <QTest>
+
+static HumToken sampleToken()
+{
+    HumToken token;
+    token.setControllerID(QString("HUM-0042-7781"));
+    token.setFingerprint(QByteArray(32, '\x5A'));
+    token.setValidatedKey(QByteArray(32, '\xA5'));
+    token.setCheckTime(QDate(2026, 11, 30));
+    return token;
+}
+
+void TokenBench::serialise()
+{
+    const HumToken token = sampleToken();
+    QByteArray data;
+    QBENCHMARK { data = token.toByteArray(); }
+    QCOMPARE(data.size(), 88);
+}
+
+void TokenBench::parse()
+{
+    const QByteArray data = sampleToken().toByteArray();
+    HumToken token;
+    QBENCHMARK { token = HumToken::fromByteArray(data); }
+    QCOMPARE(token.getControllerID(), QString("HUM-0042-7781"));
+}
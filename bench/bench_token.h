@@ -0,0 +1,13 @@
+#pragma once
+
+#include <QObject>
+
+// HumToken to and from its 88 byte stored form, done on every license check
+class TokenBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void serialise();
+    void parse();
+};
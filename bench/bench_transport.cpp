@@ -0,0 +1,216 @@
+#include "bench_transport.h"
+#include "alloccounter.h"
+#include "websockettransport.h"
+#include "compactjson.h"
+#include "framestreamserver.h"
+#include "benchdata.h"
+#include <QJsonArray>
+#include <QElapsedTimer>
+#include <QTest>
+#include <functional>
+
+// Typical QWebChannel traffic with the humBridge object
+static QJsonObject typicalMessage(const QString &name)
+{
+    if (name == "invoke")
+    {
+        return QJsonObject{ { "type", 6 }, { "object", "humBridge" }, { "method", 17 },
+                            { "args", QJsonArray{ "Ros", QJsonObject(), 50 } }, { "id", 42 } };
+    }
+    if (name == "response")
+    {
+        return QJsonObject{ { "type", 10 }, { "id", 42 }, { "data", 7 } };
+    }
+    if (name == "liveUpdate")
+    {
+        QJsonObject changes;
+        for (int pad = 1; pad <= 4; ++pad)
+        {
+            const QString p = QString("p%1.").arg(pad);
+            changes[p + "fx"] = 12 * pad;
+            changes[p + "fy"] = -7 * pad;
+            changes[p + "fz"] = 812 + pad;
+            changes[p + "copx"] = 0.125 * pad;
+            changes[p + "copy"] = -0.031 * pad;
+        }
+        changes["status.rate"] = 1600;
+        return QJsonObject{ { "type", 1 }, { "object", "humBridge" }, { "signal", 23 },
+                            { "args", QJsonArray{ changes } } };
+    }
+    // propertyUpdate
+    QJsonArray list;
+    for (int i = 0; i < 5; ++i)
+    {
+        list.append(QString("Valore %1").arg(1000 + i * 77));
+    }
+    return QJsonObject{ { "type", 2 },
+                        { "data", QJsonArray{ QJsonObject{ { "object", "humBridge" },
+                                                           { "signals", QJsonObject{ { "5", QJsonArray() } } },
+                                                           { "properties", QJsonObject{ { "1", list } } } } } } };
+}
+
+static void addMessageRows()
+{
+    QTest::addColumn<QString>("message");
+    for (const char *name : { "invoke", "response", "liveUpdate", "propertyUpdate" })
+    {
+        QTest::newRow(name) << QString::fromLatin1(name);
+    }
+}
+
+// Previous path: QJsonDocument -> QByteArray -> QString, then QWebSocket::sendTextMessage()
+// converts back to UTF-8
+static QByteArray serialiseViaQString(const QJsonObject &message)
+{
+    const QString text = QString::fromUtf8(QJsonDocument(message).toJson(QJsonDocument::Compact));
+    return text.toUtf8();
+}
+
+static void reportThroughput(const char *path, const std::function<void()> &send)
+{
+    const int N = 20000;
+    AllocationScope allocations;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < N; ++i)
+    {
+        send();
+    }
+    const qint64 ns = timer.nsecsElapsed();
+    const double perMessage = double(allocations.count()) / N;
+
+    qInfo("%s: %.0f messages/s, %.2f allocations/message", path, N * 1e9 / ns, perMessage);
+    QTest::setBenchmarkResult(perMessage, QTest::Events);
+}
+
+void TransportBench::serialiseQString_data() { addMessageRows(); }
+void TransportBench::serialiseQString()
+{
+    QFETCH(QString, message);
+    const QJsonObject msg = typicalMessage(message);
+    QByteArray out;
+    QBENCHMARK { out = serialiseViaQString(msg); }
+    QVERIFY(!out.isEmpty());
+}
+
+void TransportBench::serialiseUtf8_data() { addMessageRows(); }
+void TransportBench::serialiseUtf8()
+{
+    QFETCH(QString, message);
+    const QJsonObject msg = typicalMessage(message);
+    QByteArray buffer;
+    QBENCHMARK
+    {
+        buffer.resize(0);
+        writeCompactJson(msg, buffer);
+    }
+    QCOMPARE(QJsonDocument::fromJson(buffer).object(), msg);
+}
+
+void TransportBench::serialiseBroadcast4_data() { addMessageRows(); }
+void TransportBench::serialiseBroadcast4()
+{
+    // one QWebChannel broadcast reaching four transports
+    QFETCH(QString, message);
+    const QJsonObject msg = typicalMessage(message);
+    QBENCHMARK
+    {
+        const QJsonObject copy = QJsonObject(msg);   // fresh message each round, same shared data
+        for (int client = 0; client < 4; ++client)
+        {
+            WebSocketTransport::serialise(copy);
+        }
+        QJsonObject other = msg;
+        other["id"] = 0;                             // invalidates the cache for the next round
+        WebSocketTransport::serialise(other);
+    }
+}
+
+void TransportBench::parseQString_data() { addMessageRows(); }
+void TransportBench::parseQString()
+{
+    QFETCH(QString, message);
+    const QString text = QString::fromUtf8(QJsonDocument(typicalMessage(message)).toJson(QJsonDocument::Compact));
+    QJsonObject out;
+    QBENCHMARK { WebSocketTransport::parse(text.toUtf8(), out); }
+}
+
+void TransportBench::parseUtf8_data() { addMessageRows(); }
+void TransportBench::parseUtf8()
+{
+    QFETCH(QString, message);
+    const QByteArray bytes = QJsonDocument(typicalMessage(message)).toJson(QJsonDocument::Compact);
+    QJsonObject out;
+    QBENCHMARK { WebSocketTransport::parse(bytes, out); }
+}
+
+void TransportBench::throughputQString_data() { addMessageRows(); }
+void TransportBench::throughputQString()
+{
+    QFETCH(QString, message);
+    const QJsonObject msg = typicalMessage(message);
+    reportThroughput("QString path", [&msg]() {
+        QByteArray out = serialiseViaQString(msg);
+        Q_UNUSED(out);
+    });
+}
+
+void TransportBench::throughputUtf8_data() { addMessageRows(); }
+void TransportBench::throughputUtf8()
+{
+    QFETCH(QString, message);
+    const QJsonObject msg = typicalMessage(message);
+    QByteArray buffer;
+    reportThroughput("UTF-8 path", [&msg, &buffer]() {
+        buffer.resize(0);
+        writeCompactJson(msg, buffer);
+    });
+}
+
+// One 20 ms batch of 4 pads at 1 kHz, every column / every 4th sample
+static void addStreamRows()
+{
+    QTest::addColumn<int>("decimation");
+    QTest::newRow("full rate") << 1;
+    QTest::newRow("decimated 4") << 4;
+}
+
+void TransportBench::streamBinary_data() { addStreamRows(); }
+void TransportBench::streamBinary()
+{
+    QFETCH(int, decimation);
+    const ExamSamples batch = syntheticSamples(80);
+    QByteArray out;
+    QBENCHMARK { out = FrameStreamServer::encodeBatch(batch, 7, decimation); }
+    qInfo("binary batch: %d bytes", int(out.size()));
+}
+
+void TransportBench::streamJson_data() { addStreamRows(); }
+void TransportBench::streamJson()
+{
+    QFETCH(int, decimation);
+    const ExamSamples batch = syntheticSamples(80);
+    QByteArray out;
+    QBENCHMARK
+    {
+        QJsonArray t, pad, channels[EXAM_CHANNELS];
+        for (int i = 0; i < batch.size(); i += decimation)
+        {
+            const ExamSample &s = batch.at(i);
+            t.append(qint64(s.timestamp));
+            pad.append(s.padAddress);
+            for (int c = 0; c < EXAM_CHANNELS; ++c)
+            {
+                channels[c].append(s.channel[c]);
+            }
+        }
+        QJsonObject message{ { "seq", 7 }, { "t", t }, { "pad", pad } };
+        for (int c = 0; c < EXAM_CHANNELS; ++c)
+        {
+            message[examChannelNames[c]] = channels[c];
+        }
+        out.resize(0);
+        writeCompactJson(message, out);
+    }
+    qInfo("JSON batch: %d bytes", int(out.size()));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QObject>
+
+// WebSocketTransport serialisation: the previous QString round trip against
+// UTF-8 written into a reused buffer. throughput* report messages/s and, as
+// the benchmark result, allocations per message. stream* compare one data
+// stream batch in the binary format against the same batch as JSON.
+class TransportBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void serialiseQString_data();
+    void serialiseQString();
+    void serialiseUtf8_data();
+    void serialiseUtf8();
+    void serialiseBroadcast4_data();
+    void serialiseBroadcast4();
+    void parseQString_data();
+    void parseQString();
+    void parseUtf8_data();
+    void parseUtf8();
+    void throughputQString_data();
+    void throughputQString();
+    void throughputUtf8_data();
+    void throughputUtf8();
+    void streamBinary_data();
+    void streamBinary();
+    void streamJson_data();
+    void streamJson();
+};
@@ -0,0 +1,54 @@
+#include "benchdata.h"
+#include "humatric_protocol.h"
+#include <QtEndian>
+#include <cmath>
+
+ExamSamples syntheticSamples(int count, int pads)
+{
+    ExamSamples samples(count);
+    quint32 seed = 12345;
+    for (int i = 0; i < count; ++i)
+    {
+        ExamSample &s = samples[i];
+        s.padAddress = quint8(1 + i % pads);
+        s.timestamp = quint32(i / pads);
+        for (int c = 0; c < EXAM_CHANNELS; ++c)
+        {
+            seed = seed * 1103515245u + 12345u;
+            const double wave = std::sin((s.timestamp + 37 * c) * 0.01 + s.padAddress);
+            s.channel[c] = qint16(wave * (c == CH_FZ ? 8000 : 1500) + int(seed >> 24) - 128);
+        }
+    }
+    return samples;
+}
+
+QByteArray syntheticFrames(const ExamSamples &samples, int corruptEvery)
+{
+    QByteArray out;
+    out.reserve(samples.size() * int(sizeof(T_Frame)));
+    char frame[sizeof(T_Frame)];
+    for (int i = 0; i < samples.size(); ++i)
+    {
+        const ExamSample &s = samples.at(i);
+        uint8_t *raw = reinterpret_cast<uint8_t *>(frame);
+        raw[0] = RSP_HEADER_MARKER >> 8;
+        raw[1] = RSP_HEADER_MARKER & 0xFF;
+        raw[2] = s.padAddress;
+        raw[3] = CMD_START_STREAM;
+        qToLittleEndian<quint32>(s.timestamp, raw + offsetof(T_Frame, timestamp));
+        for (int c = 0; c < EXAM_CHANNELS; ++c)
+        {
+            qToLittleEndian<qint16>(s.channel[c], raw + offsetof(T_Frame, forceX) + 2 * c);
+        }
+        uint16_t crc = crc16(raw + 2, sizeof(T_Frame) - 6);
+        if (corruptEvery > 0 && i % corruptEvery == corruptEvery - 1)
+        {
+            crc ^= 0x5A5A;
+        }
+        qToLittleEndian<quint16>(crc, raw + offsetof(T_Frame, crc));
+        raw[sizeof(T_Frame) - 2] = PROTOCOL_EOT;
+        raw[sizeof(T_Frame) - 1] = PROTOCOL_EOT;
+        out.append(frame, sizeof(T_Frame));
+    }
+    return out;
+}
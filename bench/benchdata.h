@@ -0,0 +1,12 @@
+#pragma once
+
+#include <QByteArray>
+#include "examdata.h"
+
+// Synthetic acquisition data shared by the benchmarks: 'pads' pads sending
+// interleaved at 1 kHz, channels following slow sines with some noise.
+ExamSamples syntheticSamples(int count, int pads = 4);
+
+// The same samples as the controller sends them (T_Frame, valid CRC).
+// With corruptEvery > 0 one frame in corruptEvery has a bad CRC.
+QByteArray syntheticFrames(const ExamSamples &samples, int corruptEvery = 0);
@@ -0,0 +1,71 @@
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QTest>
+#include "bench_logging.h"
+#include "bench_processing.h"
+#include "bench_protocol.h"
+#include "bench_storage.h"
+#include "bench_token.h"
+#include "bench_transport.h"
+#include "humlog.h"
+
+LogLevels_t logLevel = HUM_LOG_WARNINGS;
+
+// QTest writes each "-o file,format" from scratch, so every class gets its own
+// file: "-o results.csv,csv" becomes results-ProtocolBench.csv and so on.
+static QStringList argumentsFor(const QStringList &arguments, const QString &className)
+{
+    QStringList out = arguments;
+    for (int i = 1; i + 1 < out.size(); ++i)
+    {
+        if (out.at(i) != "-o")
+        {
+            continue;
+        }
+        QString file = out.at(i + 1);
+        QString format;
+        const int comma = file.lastIndexOf(',');
+        if (comma >= 0)
+        {
+            format = file.mid(comma);
+            file.truncate(comma);
+        }
+        if (file != "-")
+        {
+            const QFileInfo info(file);
+            QString name = info.completeBaseName() + "-" + className;
+            if (!info.suffix().isEmpty())
+            {
+                name += "." + info.suffix();
+            }
+            file = info.dir().filePath(name);
+        }
+        out[++i] = file + format;
+    }
+    return out;
+}
+
+template <typename Bench>
+static int run(const QStringList &arguments)
+{
+    Bench bench;
+    return QTest::qExec(&bench, argumentsFor(arguments, bench.metaObject()->className()));
+}
+
+// Runs every benchmark class in turn. QTest options apply to all of them,
+// e.g. "-o results.csv,csv" or "-o results.xml,xml" for a machine-readable
+// report per class, to be compared between releases.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList arguments = app.arguments();
+
+    int status = 0;
+    status |= run<ProtocolBench>(arguments);
+    status |= run<ProcessingBench>(arguments);
+    status |= run<StorageBench>(arguments);
+    status |= run<TransportBench>(arguments);
+    status |= run<TokenBench>(arguments);
+    status |= run<LoggingBench>(arguments);
+    return status;
+}
@@ -0,0 +1,175 @@
+#include "broadcaster.h"
+#include "settings.h"
+#include "metrics.h"
+#include "trace.h"
+#include <QWebSocket>
+#include <QHash>
+
+Broadcaster::Broadcaster(QObject *parent)
+    : QObject(parent)
+{
+}
+
+Broadcaster::Client *Broadcaster::find(QWebSocket *socket)
+{
+    for (Client &c : clients)
+    {
+        if (c.socket == socket)
+        {
+            return &c;
+        }
+    }
+    return nullptr;
+}
+
+void Broadcaster::subscribe(QWebSocket *socket)
+{
+    if (find(socket))
+    {
+        return;
+    }
+
+    Client client;
+    client.socket = socket;
+    client.pressureWindow.start();
+    client.sincePressure.start();
+    clients.append(client);
+
+    connect(socket, &QWebSocket::bytesWritten, this, [this, socket](qint64 bytes) {
+        onBytesWritten(socket, bytes);
+    });
+    connect(socket, &QObject::destroyed, this, [this, socket]() {
+        unsubscribe(socket);
+    });
+    emit subscribersChanged(clients.size());
+}
+
+void Broadcaster::unsubscribe(QWebSocket *socket)
+{
+    for (int i = 0; i < clients.size(); ++i)
+    {
+        if (clients.at(i).socket == socket)
+        {
+            clients.removeAt(i);
+            disconnect(socket, nullptr, this, nullptr);
+            emit subscribersChanged(clients.size());
+            return;
+        }
+    }
+}
+
+void Broadcaster::setVariant(QWebSocket *socket, int variant)
+{
+    if (Client *client = find(socket))
+    {
+        client->variant = variant;
+    }
+}
+
+void Broadcaster::broadcast(const Encoder &encode)
+{
+    if (clients.isEmpty())
+    {
+        return;
+    }
+
+    QHash<quint64, QByteArray> byFormat;
+
+    for (Client &client : clients)
+    {
+        const quint64 format = (quint64(quint32(client.variant)) << 32) | quint32(client.decimation);
+        auto it = byFormat.find(format);
+        if (it == byFormat.end())
+        {
+            it = byFormat.insert(format, encode(client.variant, client.decimation));
+            ++encoded;
+        }
+
+        if (client.outstanding > HIGH_WATER_BYTES)
+        {
+            // slow client: keep only the latest message
+            if (!client.held.isNull())
+            {
+                ++dropped;
+                metrics().streamMessagesDropped.add();
+            }
+            client.held = it.value();
+            adaptDecimation(client, true);
+        }
+        else
+        {
+            send(client, it.value());
+            adaptDecimation(client, false);
+        }
+    }
+}
+
+void Broadcaster::send(Client &client, const QByteArray &message)
+{
+    HUM_TRACE("ws", "stream.send");
+    // no re-encoding per client: each socket only copies the shared bytes into its write buffer
+    client.socket->sendBinaryMessage(message);
+    client.outstanding += message.size();
+    ++sent;
+    sentBytes += quint64(message.size());
+    metrics().streamMessagesSent.add();
+    metrics().streamBytesSent.add(quint64(message.size()));
+}
+
+void Broadcaster::onBytesWritten(QWebSocket *socket, qint64 bytes)
+{
+    Client *client = find(socket);
+    if (!client)
+    {
+        return;
+    }
+
+    // written bytes include the frame headers, never go below zero
+    client->outstanding = qMax<qint64>(0, client->outstanding - bytes);
+
+    if (!client->held.isNull() && client->outstanding < LOW_WATER_BYTES)
+    {
+        const QByteArray message = client->held;
+        client->held = QByteArray();
+        send(*client, message);
+    }
+}
+
+void Broadcaster::adaptDecimation(Client &client, bool pressure)
+{
+    if (pressure)
+    {
+        client.sincePressure.restart();
+        if (client.pressureWindow.elapsed() > PRESSURE_MS)
+        {
+            client.pressureWindow.restart();
+            client.recentDrops = 0;
+        }
+
+        if (++client.recentDrops >= PRESSURE_DROPS && client.decimation < MAX_DECIMATION)
+        {
+            client.decimation *= 2;
+            client.recentDrops = 0;
+            client.pressureWindow.restart();
+            MYINFO << "Client" << client.socket->peerAddress().toString() << "too slow, decimation" << client.decimation;
+            emit decimationChanged(client.socket, client.decimation);
+        }
+    }
+    else if (client.decimation > 1 && client.sincePressure.elapsed() > RELAX_MS)
+    {
+        client.decimation /= 2;
+        client.sincePressure.restart();
+        MYINFO << "Client" << client.socket->peerAddress().toString() << "recovered, decimation" << client.decimation;
+        emit decimationChanged(client.socket, client.decimation);
+    }
+}
+
+qint64 Broadcaster::bytesQueued() const
+{
+    qint64 total = 0;
+    for (const Client &c : clients)
+    {
+        total += c.outstanding;
+    }
+    return total;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <functional>
+
+class QWebSocket;
+
+// Fan-out of binary messages to a set of WebSocket clients. A message is
+// encoded once per (variant, decimation level) in use and the same implicitly
+// shared QByteArray is queued on every socket with that pair, so the cost of a
+// batch does not grow with the number of clients watching the session. The
+// variant is an opaque number chosen by the owner, e.g. a subscription filter.
+//
+// Flow control: QWebSocket queues without limit, so the bytes not yet written
+// are tracked per client. Above HIGH_WATER_BYTES a client gets no new messages,
+// only the latest one is held back (older held ones are dropped) and sent when
+// the queue falls below LOW_WATER_BYTES. A client that keeps dropping has its
+// decimation doubled, one that has been fine for RELAX_MS has it halved.
+class Broadcaster : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const qint64 HIGH_WATER_BYTES = 256 * 1024;
+    static const qint64 LOW_WATER_BYTES = 64 * 1024;
+    static const int MAX_DECIMATION = 16;
+    static const int PRESSURE_DROPS = 3;        // drops within PRESSURE_MS raise decimation
+    static const int PRESSURE_MS = 1000;
+    static const int RELAX_MS = 5000;
+
+    // builds the message for a variant and a decimation level (1 = every sample)
+    typedef std::function<QByteArray(int variant, int decimation)> Encoder;
+
+    explicit Broadcaster(QObject *parent = nullptr);
+
+    void subscribe(QWebSocket *socket);
+    void unsubscribe(QWebSocket *socket);
+    int subscriberCount() const { return clients.size(); }
+    void setVariant(QWebSocket *socket, int variant);      // 0 for new subscribers
+
+    void broadcast(const Encoder &encode);
+
+    quint64 messagesEncoded() const { return encoded; }
+    quint64 messagesSent() const { return sent; }
+    quint64 messagesDropped() const { return dropped; }
+    quint64 bytesSent() const { return sentBytes; }
+    qint64 bytesQueued() const;
+
+signals:
+    void subscribersChanged(int count);
+    void decimationChanged(QWebSocket *socket, int decimation);
+
+private:
+    struct Client
+    {
+        QWebSocket *socket = nullptr;
+        qint64 outstanding = 0;         // sent but not yet written to the network
+        int variant = 0;
+        int decimation = 1;
+        QByteArray held;
+        int recentDrops = 0;
+        QElapsedTimer pressureWindow;
+        QElapsedTimer sincePressure;
+    };
+
+    Client *find(QWebSocket *socket);
+    void send(Client &client, const QByteArray &message);
+    void onBytesWritten(QWebSocket *socket, qint64 bytes);
+    void adaptDecimation(Client &client, bool pressure);
+
+    QList<Client> clients;
+    quint64 encoded = 0;
+    quint64 sent = 0;
+    quint64 dropped = 0;
+    quint64 sentBytes = 0;
+};
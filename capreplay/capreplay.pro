@@ -0,0 +1,25 @@
+QT += core
+QT -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = capreplay
+
+# decoder and capture format straight from the server sources
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    ../framedecoder.cpp \
+    ../humatric_protocol.cpp \
+    ../humlog.cpp \
+    ../metrics.cpp \
+    ../serialcapture.cpp \
+    ../trace.cpp
+
+HEADERS += \
+    ../framedecoder.h \
+    ../humlog.h \
+    ../serialcapture.h
@@ -0,0 +1,201 @@
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+#include "serialcapture.h"
+#include "framedecoder.h"
+#include "humlog.h"
+
+LogLevels_t logLevel = HUM_LOG_WARNINGS;
+
+// Feeds a capture written by ControllerInterface::startCapture() to the frame
+// decoder, at the captured timing (--realtime, --speed) or as fast as possible,
+// and prints what the decoder made of it. The checksum covers every decoded
+// sample: the same capture must give the same checksum after a decoder change.
+//
+//     capreplay field.humcap
+//     capreplay --repeat 20 field.humcap            throughput
+//     capreplay --realtime --samples out.csv field.humcap
+
+struct ReplayResult
+{
+    quint64 chunks = 0;
+    quint64 bytes = 0;
+    quint64 sentChunks = 0;
+    quint64 samples = 0;
+    quint64 perPad[256] = {};
+    quint64 checksum = 14695981039346656037ull;    // FNV-1a 64 of the sample encoding
+    qint64 decodeNs = 0;
+};
+
+static bool replayOnce(SerialCaptureReader &reader, double speed, QTextStream *csv, ReplayResult &result, FrameDecoder &decoder)
+{
+    if (!reader.rewind())
+    {
+        return false;
+    }
+
+    QElapsedTimer wall;
+    wall.start();
+    QElapsedTimer decodeTimer;
+    SerialCaptureReader::Chunk chunk;
+    ExamSamples samples;
+    QByteArray encoded;
+
+    while (reader.next(chunk))
+    {
+        if (chunk.sent)
+        {
+            result.sentChunks++;
+            continue;
+        }
+        if (speed > 0)
+        {
+            const qint64 dueNs = qint64(chunk.timeUs * 1000 / speed);
+            const qint64 waitNs = dueNs - wall.nsecsElapsed();
+            if (waitNs > 0)
+            {
+                QThread::usleep(quint64(waitNs / 1000));
+            }
+        }
+
+        samples.resize(0);
+        decodeTimer.start();
+        decoder.feed(chunk.data.constData(), int(chunk.data.size()), samples);
+        result.decodeNs += decodeTimer.nsecsElapsed();
+        result.chunks++;
+        result.bytes += quint64(chunk.data.size());
+
+        for (const ExamSample &s : std::as_const(samples))
+        {
+            encoded.resize(0);
+            appendSample(encoded, s);
+            for (const char c : std::as_const(encoded))
+            {
+                result.checksum = (result.checksum ^ quint8(c)) * 1099511628211ull;
+            }
+            result.perPad[s.padAddress]++;
+            if (csv)
+            {
+                *csv << chunk.timeUs << ',' << s.padAddress << ',' << s.timestamp;
+                for (int c = 0; c < EXAM_CHANNELS; ++c)
+                {
+                    *csv << ',' << s.channel[c];
+                }
+                *csv << '\n';
+            }
+        }
+        result.samples += quint64(samples.size());
+    }
+    return reader.errorString().isEmpty();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("capreplay");
+
+    // decoder and capture reader warnings, console only
+    HumLog::start();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays a HumServer serial capture through the frame decoder");
+    parser.addHelpOption();
+    parser.addPositionalArgument("capture", "Capture file (--capture of HumServer3)");
+    QCommandLineOption realtimeOption("realtime", "Replay at the captured timing");
+    QCommandLineOption speedOption("speed", "Replay at <factor> times the captured timing", "factor");
+    QCommandLineOption repeatOption("repeat", "Decode the capture <n> times (as fast as possible)", "n", "1");
+    QCommandLineOption samplesOption("samples", "Write decoded samples to <csv>", "csv");
+    parser.addOptions({ realtimeOption, speedOption, repeatOption, samplesOption });
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+    {
+        parser.showHelp(1);
+    }
+
+    SerialCaptureReader reader;
+    if (!reader.open(parser.positionalArguments().first()))
+    {
+        fprintf(stderr, "%s: %s\n", qPrintable(parser.positionalArguments().first()), qPrintable(reader.errorString()));
+        return 1;
+    }
+
+    double speed = 0;       // 0: as fast as possible
+    if (parser.isSet(speedOption))
+    {
+        speed = parser.value(speedOption).toDouble();
+    }
+    else if (parser.isSet(realtimeOption))
+    {
+        speed = 1;
+    }
+    const int repeat = speed > 0 ? 1 : qMax(1, parser.value(repeatOption).toInt());
+
+    QFile csvFile;
+    QTextStream csvStream;
+    if (parser.isSet(samplesOption))
+    {
+        csvFile.setFileName(parser.value(samplesOption));
+        if (!csvFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        {
+            fprintf(stderr, "%s: %s\n", qPrintable(csvFile.fileName()), qPrintable(csvFile.errorString()));
+            return 1;
+        }
+        csvStream.setDevice(&csvFile);
+        csvStream << "capture_us,pad,timestamp,fx,fy,fz,mx,my,mz\n";
+    }
+
+    printf("capture: %s, port %s, started %s\n", qPrintable(parser.positionalArguments().first()), qPrintable(reader.portName()),
+           qPrintable(QDateTime::fromMSecsSinceEpoch(reader.startEpochMs()).toString(Qt::ISODateWithMs)));
+
+    ReplayResult first;
+    qint64 bestNs = 0;
+    FrameDecoder decoder;
+    for (int pass = 0; pass < repeat; ++pass)
+    {
+        ReplayResult result;
+        decoder = FrameDecoder();
+        const bool complete = replayOnce(reader, speed, pass == 0 && csvFile.isOpen() ? &csvStream : nullptr, result, decoder);
+        if (pass == 0)
+        {
+            first = result;
+            if (!complete)
+            {
+                printf("warning: %s, replayed up to there\n", qPrintable(reader.errorString()));
+            }
+            printf("chunks: %llu received (%llu bytes), %llu sent\n", (unsigned long long)result.chunks,
+                   (unsigned long long)result.bytes, (unsigned long long)result.sentChunks);
+            printf("decoder: %llu frames, %llu CRC errors, %llu resyncs, %llu notifies\n",
+                   (unsigned long long)decoder.frameCount(), (unsigned long long)decoder.crcErrorCount(),
+                   (unsigned long long)decoder.resyncCount(), (unsigned long long)decoder.notifyCount());
+            for (int pad = 0; pad < 256; ++pad)
+            {
+                if (result.perPad[pad])
+                {
+                    printf("  pad %d: %llu frames\n", pad, (unsigned long long)result.perPad[pad]);
+                }
+            }
+            printf("checksum: %016llx\n", (unsigned long long)result.checksum);
+        }
+        else if (result.checksum != first.checksum)
+        {
+            printf("error: pass %d decoded differently\n", pass + 1);
+            return 2;
+        }
+        if (pass == 0 || result.decodeNs < bestNs)
+        {
+            bestNs = result.decodeNs;
+        }
+    }
+
+    if (bestNs > 0)
+    {
+        printf("decode: %.1f ms, %.1f MB/s, %.0f frames/s%s\n", bestNs / 1e6, first.bytes * 1e3 / bestNs,
+               first.samples * 1e9 / bestNs, repeat > 1 ? " (best pass)" : "");
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "compactjson.h"
+#include <QJsonArray>
+#include <QStringView>
+#include <charconv>
+#include <cmath>
+
+static void writeString(QStringView s, QByteArray &out)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out.append('"');
+    const qsizetype n = s.size();
+    for (qsizetype i = 0; i < n; ++i)
+    {
+        const char16_t c = s.at(i).unicode();
+        if (c < 0x80)
+        {
+            switch (c)
+            {
+                case '"':  out.append("\\\"", 2); break;
+                case '\\': out.append("\\\\", 2); break;
+                case '\b': out.append("\\b", 2); break;
+                case '\f': out.append("\\f", 2); break;
+                case '\n': out.append("\\n", 2); break;
+                case '\r': out.append("\\r", 2); break;
+                case '\t': out.append("\\t", 2); break;
+                default:
+                    if (c < 0x20)
+                    {
+                        const char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+                        out.append(esc, 6);
+                    }
+                    else
+                    {
+                        out.append(char(c));
+                    }
+            }
+        }
+        else if (c < 0x800)
+        {
+            out.append(char(0xC0 | (c >> 6)));
+            out.append(char(0x80 | (c & 0x3F)));
+        }
+        else if (QChar::isHighSurrogate(c) && i + 1 < n && QChar::isLowSurrogate(s.at(i + 1).unicode()))
+        {
+            const char32_t u = QChar::surrogateToUcs4(c, s.at(++i).unicode());
+            out.append(char(0xF0 | (u >> 18)));
+            out.append(char(0x80 | ((u >> 12) & 0x3F)));
+            out.append(char(0x80 | ((u >> 6) & 0x3F)));
+            out.append(char(0x80 | (u & 0x3F)));
+        }
+        else
+        {
+            // lone surrogates become U+FFFD, as with QString::toUtf8()
+            const char16_t v = QChar::isSurrogate(c) ? char16_t(QChar::ReplacementCharacter) : c;
+            out.append(char(0xE0 | (v >> 12)));
+            out.append(char(0x80 | ((v >> 6) & 0x3F)));
+            out.append(char(0x80 | (v & 0x3F)));
+        }
+    }
+    out.append('"');
+}
+
+static void writeNumber(double d, QByteArray &out)
+{
+    if (!std::isfinite(d))
+    {
+        out.append("null", 4);      // as QJsonDocument does
+        return;
+    }
+
+    // std::to_chars: locale independent (no decimal comma after setlocale())
+    // and without precision it gives the shortest text that reads back as d
+    char buf[32];
+    std::to_chars_result r;
+    if (d == std::floor(d) && std::fabs(d) < 9007199254740992.0)   // 2^53, exact integers
+    {
+        r = std::to_chars(buf, buf + sizeof(buf), static_cast<long long>(d));
+    }
+    else
+    {
+        r = std::to_chars(buf, buf + sizeof(buf), d);
+    }
+    out.append(buf, int(r.ptr - buf));
+}
+
+void writeCompactJson(const QJsonValue &value, QByteArray &out)
+{
+    switch (value.type())
+    {
+        case QJsonValue::Null:
+        case QJsonValue::Undefined:
+            out.append("null", 4);
+            break;
+        case QJsonValue::Bool:
+            if (value.toBool()) out.append("true", 4);
+            else out.append("false", 5);
+            break;
+        case QJsonValue::Double:
+            writeNumber(value.toDouble(), out);
+            break;
+        case QJsonValue::String:
+            writeString(value.toString(), out);
+            break;
+        case QJsonValue::Array:
+        {
+            const QJsonArray array = value.toArray();
+            out.append('[');
+            bool first = true;
+            for (const QJsonValue &v : array)
+            {
+                if (!first) out.append(',');
+                first = false;
+                writeCompactJson(v, out);
+            }
+            out.append(']');
+            break;
+        }
+        case QJsonValue::Object:
+            writeCompactJson(value.toObject(), out);
+            break;
+    }
+}
+
+void writeCompactJson(const QJsonObject &object, QByteArray &out)
+{
+    out.append('{');
+    bool first = true;
+    for (auto it = object.constBegin(); it != object.constEnd(); ++it)
+    {
+        if (!first) out.append(',');
+        first = false;
+        writeString(it.key(), out);
+        out.append(':');
+        writeCompactJson(it.value(), out);
+    }
+    out.append('}');
+}
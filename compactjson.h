@@ -0,0 +1,10 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+
+// Compact JSON writer appending UTF-8 straight into 'out'. Unlike
+// QJsonDocument::toJson() it does not allocate a new buffer every time:
+// pass the same QByteArray (resized to 0) and its capacity is reused.
+void writeCompactJson(const QJsonObject &object, QByteArray &out);
+void writeCompactJson(const QJsonValue &value, QByteArray &out);
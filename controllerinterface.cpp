@@ -1,18 +1,44 @@
 #include "ControllerInterface.h"
+#include "metrics.h"
+#include "trace.h"
+#include "realtime.h"
 #include <QElapsedTimer>
 #include <QDebug>
 
 ControllerInterface::ControllerInterface(Settings &settingsRef, QObject *parent)
+    : ControllerInterface(settingsRef, settingsRef.serialPort, 0, parent)
+{
+}
+
+ControllerInterface::ControllerInterface(Settings &settingsRef, const QString &portName, int index, QObject *parent)
     : QObject(parent),
       settings(settingsRef),
+      controllerIndex(index),
       serial(new QSerialPort(this))
 {
-    serial->setPortName(settings.serialPort);
-    parseSerialParams(settings.serialParams);
+    serial->setPortName(portName);
+    applySerialParams(serial, settings.serialParams);
+    decoder.setController(index);
+
+    // connected before opening: a port that fails now can still be opened
+    // later with reopen() or switchPort()
+    connect(serial, &QSerialPort::readyRead, this, &ControllerInterface::onReadyRead);
+
+    probeTimer.setSingleShot(true);
+    connect(&probeTimer, &QTimer::timeout, this, &ControllerInterface::finishProbe);
+
+    // a capture loses at most one second if the server dies
+    captureFlushTimer.setInterval(1000);
+    connect(&captureFlushTimer, &QTimer::timeout, this, [this]() {
+        if (capture)
+        {
+            capture->flush();
+        }
+    });
 
     if (!serial->open(QIODevice::ReadWrite))
     {
-        MYCRITICAL << "Failed to open serial port: " << settings.serialPort << " : " << serial->errorString();
+        MYCRITICAL << "Failed to open serial port: " << portName << " : " << serial->errorString();
         return;
     }
 
@@ -21,6 +47,7 @@ ControllerInterface::ControllerInterface(Settings &settingsRef, QObject *parent)
 
 ControllerInterface::~ControllerInterface()
 {
+    stopCapture();
     if (serial->isOpen())
     {
         serial->close();
@@ -28,7 +55,7 @@ ControllerInterface::~ControllerInterface()
     }
 }
 
-void ControllerInterface::parseSerialParams(const QString &paramString)
+void ControllerInterface::applySerialParams(QSerialPort *serial, const QString &paramString)
 {
     QStringList parts = paramString.split(',', Qt::SkipEmptyParts);
 
@@ -81,6 +108,7 @@ QByteArray ControllerInterface::readBytes(int minBytes, int maxBytes, int timeou
         QByteArray chunk = serial->read(maxBytes - result.size());
         if (!chunk.isEmpty())
         {
+            captureChunk(false, chunk);
             result.append(chunk);
         }
 
@@ -101,6 +129,7 @@ bool ControllerInterface::writeBytes(const QByteArray &data)
         return false;
     }
 
+    captureChunk(true, data);
     qint64 written = serial->write(data);
     if (!serial->waitForBytesWritten(1000))
     {
@@ -112,6 +141,11 @@ bool ControllerInterface::writeBytes(const QByteArray &data)
 
 QString ControllerInterface::getSerialNumber()
 {
+    QString result;
+    if (fromOtherThread([this, &result]() { result = getSerialNumber(); }))
+    {
+        return result;
+    }
     MYDEBUG << __func__ << "()";
 
     QByteArray command("\xFE\xED\x01\x00\x24\x4a\x9f\x04\x04", 9);
@@ -133,22 +167,258 @@ QString ControllerInterface::getSerialNumber()
     return {};
 }
 
-uint16_t ControllerInterface::computeCRC(const QByteArray &data) const
+bool ControllerInterface::reopen()
+{
+    bool ok = false;
+    if (fromOtherThread([this, &ok]() { ok = reopen(); }))
+    {
+        return ok;
+    }
+    if (serial->isOpen())
+    {
+        return true;
+    }
+    if (!serial->open(QIODevice::ReadWrite))
+    {
+        MYDEBUG << "Cannot open serial port" << serial->portName() << ":" << serial->errorString();
+        return false;
+    }
+    MYINFO << "Serial port" << serial->portName() << "opened";
+    return true;
+}
+
+void ControllerInterface::closePort()
+{
+    if (fromOtherThread([this]() { closePort(); }))
+    {
+        return;
+    }
+    if (serial->isOpen())
+    {
+        serial->close();
+    }
+}
+
+bool ControllerInterface::switchPort(const QString &portName)
+{
+    bool ok = false;
+    if (fromOtherThread([this, &portName, &ok]() { ok = switchPort(portName); }))
+    {
+        return ok;
+    }
+    closePort();
+    serial->setPortName(portName);
+    if (controllerIndex == 0)
+    {
+        settings.serialPort = portName;
+    }
+    return reopen();
+}
+
+void ControllerInterface::requestSerialNumber(int timeoutMs)
+{
+    if (fromOtherThread([this, timeoutMs]() { requestSerialNumber(timeoutMs); }))
+    {
+        return;
+    }
+    MYDEBUG << __func__ << "()";
+
+    if (probing)
+    {
+        return;
+    }
+
+    serial->clear(QSerialPort::Input);
+    probeBuffer.clear();
+    probing = true;
+
+    // same command as getSerialNumber(), pad mask 1
+    const QByteArray command = buildCommand(0x0001, CMD_GET_SERIAL_NUMBER);
+    captureChunk(true, command);
+    if (!serial->isOpen() || serial->write(command) < 0)
+    {
+        // reported asynchronously like any other failure
+        QTimer::singleShot(0, this, &ControllerInterface::finishProbe);
+        return;
+    }
+    probeTimer.start(timeoutMs);
+}
+
+void ControllerInterface::finishProbe()
+{
+    if (!probing)
+    {
+        return;
+    }
+    probing = false;
+    probeTimer.stop();
+
+    QString serialID;
+    if (probeBuffer.size() < responseLengths[RSP_SERIAL_NUMBER])
+    {
+        MYWARNING << __func__ << "() - received" << probeBuffer.size() << "bytes instead of" << responseLengths[RSP_SERIAL_NUMBER];
+    }
+    else
+    {
+        serialID = handleResponse(probeBuffer).toString();
+    }
+    probeBuffer.clear();
+
+    MYDEBUG << __func__ << "() got SID:" << serialID;
+    emit serialNumberReceived(serialID);
+}
+
+uint16_t ControllerInterface::computeCRC(const QByteArray &data)
 {
-    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data.constData());
-    size_t length = static_cast<size_t>(data.size());
+    return crc16(reinterpret_cast<const uint8_t *>(data.constData()), static_cast<size_t>(data.size()));
+}
 
-    uint16_t crc = 0xFFFF;
-    for (size_t i = 0; i < length; ++i)
+QByteArray ControllerInterface::buildCommand(uint16_t padMask, uint8_t commandCode)
+{
+    // T_CommandBase: marker big endian, padMask and CRC little endian
+    QByteArray command;
+    command.append(char(CMD_HEADER_MARKER >> 8));
+    command.append(char(CMD_HEADER_MARKER & 0xFF));
+    command.append(char(padMask & 0xFF));
+    command.append(char(padMask >> 8));
+    command.append(char(commandCode));
+    uint16_t crc = computeCRC(command.mid(2));
+    command.append(char(crc & 0xFF));
+    command.append(char(crc >> 8));
+    command.append(char(PROTOCOL_EOT));
+    command.append(char(PROTOCOL_EOT));
+    return command;
+}
+
+bool ControllerInterface::startStream(uint16_t padMask)
+{
+    bool ok = false;
+    if (fromOtherThread([this, padMask, &ok]() { ok = startStream(padMask); }))
     {
-        crc ^= static_cast<uint16_t>(bytes[i]) << 8;
-        for (uint8_t bit = 0; bit < 8; ++bit)
+        return ok;
+    }
+    MYDEBUG << __func__ << "() padMask" << Qt::hex << padMask;
+
+    if (streaming)
+    {
+        return true;
+    }
+
+    serial->clear(QSerialPort::Input);
+    decoder.reset();
+    if (!writeBytes(buildCommand(padMask, CMD_START_STREAM)))
+    {
+        MYWARNING << __func__ << "() - cannot send command";
+        return false;
+    }
+
+    // the ACK is not awaited: the decoder recognises and skips it
+    streaming = true;
+    wakeupProbe = RealTime::startWakeupProbe(this);
+    return true;
+}
+
+bool ControllerInterface::stopStream()
+{
+    bool ok = false;
+    if (fromOtherThread([this, &ok]() { ok = stopStream(); }))
+    {
+        return ok;
+    }
+    MYDEBUG << __func__ << "()";
+
+    if (!streaming)
+    {
+        return true;
+    }
+
+    streaming = false;
+    delete wakeupProbe;
+    wakeupProbe = nullptr;
+    return writeBytes(buildCommand(BROADCAST_MASK, CMD_STOP_STREAM));
+}
+
+void ControllerInterface::onReadyRead()
+{
+    if (probing)
+    {
+        const QByteArray chunk = serial->readAll();
+        captureChunk(false, chunk);
+        probeBuffer.append(chunk);
+        if (probeBuffer.size() >= responseLengths[RSP_SERIAL_NUMBER])
         {
-            if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
-            else crc <<= 1;
+            finishProbe();
         }
+        return;
+    }
+
+    if (!streaming)
+    {
+        return;     // the synchronous commands read the port themselves
+    }
+
+    HUM_TRACE("serial", "readyRead");
+    QElapsedTimer timer;
+    timer.start();
+
+    const qint64 available = serial->bytesAvailable();
+    readBuffer.resize(available);
+    readBuffer.resize(qMax<qint64>(0, serial->read(readBuffer.data(), available)));
+    const QByteArray &chunk = readBuffer;
+    captureChunk(false, chunk);
+    ExamSamples samples;
+    decoder.feed(chunk.constData(), chunk.size(), samples);
+
+    metrics().serialBytes.add(quint64(chunk.size()));
+    metrics().decodeLatency.recordSince(timer);
+    if (!samples.isEmpty())
+    {
+        emit samplesReceived(samples);
+    }
+}
+
+void ControllerInterface::reserveBuffers(int bytes)
+{
+    if (fromOtherThread([this, bytes]() { reserveBuffers(bytes); }))
+    {
+        return;
+    }
+    readBuffer.resize(bytes);
+    readBuffer.fill(0);
+    readBuffer.resize(0);
+    decoder.reserve(2 * bytes);
+}
+
+bool ControllerInterface::startCapture(const QString &path)
+{
+    bool ok = false;
+    if (fromOtherThread([this, &path, &ok]() { ok = startCapture(path); }))
+    {
+        return ok;
+    }
+    stopCapture();
+    std::unique_ptr<SerialCaptureWriter> writer(new SerialCaptureWriter);
+    if (!writer->open(path, serial->portName()))
+    {
+        return false;
+    }
+    capture = std::move(writer);
+    captureFlushTimer.start();
+    return true;
+}
+
+void ControllerInterface::stopCapture()
+{
+    if (fromOtherThread([this]() { stopCapture(); }))
+    {
+        return;
+    }
+    if (!capture)
+    {
+        return;
     }
-    return crc;
+    captureFlushTimer.stop();
+    capture.reset();        // flushes and closes
 }
 
 QVariant ControllerInterface::handleResponse(const QByteArray &data)
@@ -3,27 +3,115 @@
 #include <QObject>
 #include <QSerialPort>
 #include <QHostAddress>
+#include <QTimer>
+#include <QThread>
 #include "settings.h"
 #include "humatric_protocol.h"
+#include "framedecoder.h"
+#include "serialcapture.h"
+#include <memory>
 
+// One controller on one serial port. The public methods can be called from any
+// thread: they run in the thread the object lives in (its acquisition thread
+// when it belongs to a ControllerPool) and the caller waits for the result.
 class ControllerInterface : public QObject
 {
     Q_OBJECT
 
 public:
     explicit ControllerInterface(Settings &settingsRef, QObject *parent = nullptr);
+    // Controller 'index' of a ControllerPool: its pads are renumbered with globalPad()
+    ControllerInterface(Settings &settingsRef, const QString &portName, int index, QObject *parent = nullptr);
     ~ControllerInterface();
 
+    static const int PROBE_TIMEOUT_MS = 3000;
+
     QString getSerialNumber();
 
+    // Non blocking variant used at startup: the answer comes with
+    // serialNumberReceived(), an empty string on timeout or bad response
+    void requestSerialNumber(int timeoutMs = PROBE_TIMEOUT_MS);
+    int index() const { return controllerIndex; }
+    bool isOpen() const { return serial->isOpen(); }
+    bool reopen();
+    void closePort();
+    bool switchPort(const QString &portName);      // closes the current one, opens this
+    QString portName() const { return serial->portName(); }
+
+    // T_CommandBase for the pads in padMask
+    static QByteArray buildCommand(uint16_t padMask, uint8_t commandCode);
+    // "baud,dataBits,parity,stopBits" as in Settings::serialParams
+    static void applySerialParams(QSerialPort *port, const QString &paramString);
+
+    // Synchronous command responses: checks marker and CRC, returns the payload
+    // (serial number as QString, firmware versions as QVariantMap) or an invalid QVariant
+    static QVariant handleResponse(const QByteArray &data);
+    static uint16_t computeCRC(const QByteArray &data);
+
+    // Real-time streaming: frames are decoded as they arrive and delivered
+    // with samplesReceived()
+    bool startStream(uint16_t padMask = BROADCAST_MASK);
+    bool stopStream();
+    bool isStreaming() const { return streaming; }
+    const FrameDecoder &frameDecoder() const { return decoder; }
+
+    // Allocates the read and decode buffers now (and touches them), so that
+    // streaming does not grow them. Called in the acquisition thread in real-time mode.
+    static const int READ_BUFFER_BYTES = 64 * 1024;
+    void reserveBuffers(int bytes = READ_BUFFER_BYTES);
+
+    // Every chunk read from and written to the port goes to a capture file
+    // (serialcapture.h) until stopCapture(). Replay it with capreplay.
+    bool startCapture(const QString &path);
+    void stopCapture();
+    bool isCapturing() const { return capture != nullptr; }
+
+signals:
+    void samplesReceived(const ExamSamples &samples);
+    void serialNumberReceived(const QString &serialID);
+
+private slots:
+    void onReadyRead();
+    void finishProbe();
+
 private:
     QByteArray readBytes(int minBytes, int maxBytes, int timeoutMs);
     bool writeBytes(const QByteArray &data);
-    QVariant handleResponse(const QByteArray &data);
-    uint16_t computeCRC(const QByteArray &data) const;
-    void parseSerialParams(const QString &paramString);
+
+    // Runs 'call' in this object's thread and waits, when called from another one.
+    // Returns false when already in the right thread: the caller goes on itself.
+    template <typename F>
+    bool fromOtherThread(F call)
+    {
+        if (QThread::currentThread() == thread())
+        {
+            return false;
+        }
+        QMetaObject::invokeMethod(this, call, Qt::BlockingQueuedConnection);
+        return true;
+    }
+
+    void captureChunk(bool sent, const QByteArray &data)
+    {
+        if (capture)
+        {
+            capture->record(sent, data.constData(), int(data.size()));
+        }
+    }
 
 private:
     Settings &settings;
+    int controllerIndex = 0;
     QSerialPort *serial;
+    FrameDecoder decoder;
+    QByteArray readBuffer;              // keeps its capacity, readAll() would allocate on every read
+    bool streaming = false;
+    QTimer *wakeupProbe = nullptr;      // while streaming, see RealTime::startWakeupProbe()
+
+    bool probing = false;
+    QByteArray probeBuffer;
+    QTimer probeTimer;
+
+    std::unique_ptr<SerialCaptureWriter> capture;
+    QTimer captureFlushTimer;
 };
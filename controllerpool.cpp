@@ -0,0 +1,219 @@
+#include "controllerpool.h"
+#include "ControllerInterface.h"
+#include "settings.h"
+#include "metrics.h"
+#include "realtime.h"
+#include "trace.h"
+#include <QThread>
+#include <algorithm>
+
+ControllerPool::ControllerPool(Settings &settings, QObject *parent)
+    : QObject(parent)
+{
+    QStringList ports;
+    ports << settings.serialPort << settings.extraSerialPorts;
+    if (ports.size() > MAX_CONTROLLERS)
+    {
+        MYWARNING << "Too many controllers," << MAX_CONTROLLERS << "are used";
+        ports = ports.mid(0, MAX_CONTROLLERS);
+    }
+
+    const bool realTime = settings.realTimeEnabled;
+    const QList<int> cpus = RealTime::parseCpuList(settings.realTimeCpus);
+
+    for (int index = 0; index < ports.size(); ++index)
+    {
+        Source source;
+        source.thread = new QThread(this);
+        source.thread->setObjectName(QString("controller %1").arg(index));
+        if (realTime)
+        {
+            source.thread->setStackSize(RealTime::STACK_BYTES);
+        }
+        source.thread->start();
+
+        // created in its thread, so that the port and its notifiers belong to it,
+        // and the real-time setup applies to that thread
+        const int cpu = cpus.isEmpty() ? -1 : cpus.at(index % cpus.size());
+        bool scheduled = false;
+        QString error;
+        QObject *anchor = new QObject;
+        anchor->moveToThread(source.thread);
+        QMetaObject::invokeMethod(anchor, [&, index]() {
+            source.controller = index == 0 ? new ControllerInterface(settings)
+                                           : new ControllerInterface(settings, ports.at(index), index);
+            if (realTime)
+            {
+                RealTime::prefaultStack();
+                source.controller->reserveBuffers();
+                scheduled = RealTime::applyToCurrentThread(settings.realTimePriority, cpu, error);
+            }
+        }, Qt::BlockingQueuedConnection);
+        anchor->deleteLater();
+
+        if (realTime)
+        {
+            if (scheduled)
+            {
+                metrics().realTimeThreads.add(1);
+                MYINFO << "Controller" << index << "thread: real-time priority" << settings.realTimePriority
+                       << (cpu >= 0 ? QString("on CPU %1").arg(cpu) : QString("not pinned"));
+            }
+            else
+            {
+                MYWARNING << "Controller" << index << "thread: real-time setup failed," << error;
+            }
+        }
+
+        connect(source.thread, &QThread::finished, source.controller, &QObject::deleteLater);
+        connect(source.controller, &ControllerInterface::samplesReceived, this, [this, index](const ExamSamples &samples) {
+            onSamples(index, samples);
+        });
+        sources.append(source);
+        if (index > 0)
+        {
+            MYINFO << "Controller" << index << "on" << ports.at(index) << ", pads"
+                   << globalPad(index, 1) << "-" << globalPad(index, PADS_PER_CONTROLLER);
+        }
+    }
+
+    clock.start();
+    stallTimer.setInterval(MERGE_STALL_MS);
+    connect(&stallTimer, &QTimer::timeout, this, &ControllerPool::release);
+}
+
+ControllerPool::~ControllerPool()
+{
+    for (Source &source : sources)
+    {
+        source.thread->quit();
+    }
+    for (Source &source : sources)
+    {
+        source.thread->wait();
+    }
+}
+
+bool ControllerPool::startStream()
+{
+    bool ok = true;
+    for (Source &source : sources)
+    {
+        source.pending.clear();
+        source.synced = false;
+        source.lastArrivalMs = -1;
+        if (!source.controller->startStream())
+        {
+            MYWARNING << "Controller" << source.controller->index() << "did not start streaming";
+            ok = false;
+        }
+    }
+    if (sources.size() > 1)
+    {
+        stallTimer.start();
+    }
+    return ok;
+}
+
+bool ControllerPool::stopStream()
+{
+    bool ok = true;
+    for (Source &source : sources)
+    {
+        ok &= source.controller->stopStream();
+    }
+    stallTimer.stop();
+
+    // whatever is still held back goes out now
+    for (Source &source : sources)
+    {
+        source.lastArrivalMs = -1;
+    }
+    release();
+    return ok;
+}
+
+void ControllerPool::startCapture(const QString &path)
+{
+    for (const Source &source : std::as_const(sources))
+    {
+        const int index = source.controller->index();
+        source.controller->startCapture(index == 0 ? path : path + "." + QString::number(index));
+    }
+}
+
+void ControllerPool::onSamples(int index, const ExamSamples &samples)
+{
+    if (sources.size() == 1)
+    {
+        emit samplesReceived(samples);
+        return;
+    }
+
+    HUM_TRACE("process", "controllers.merge");
+    Source &source = sources[index];
+    const qint64 now = clock.elapsed();
+    if (!source.synced)
+    {
+        source.offsetMs = now - qint64(samples.first().timestamp);
+        source.synced = true;
+    }
+
+    for (ExamSample s : samples)
+    {
+        s.timestamp = quint32(qMax<qint64>(0, qint64(s.timestamp) + source.offsetMs));
+        source.pending.append(s);
+        source.lastTimestamp = qMax(source.lastTimestamp, s.timestamp);
+    }
+    source.lastArrivalMs = now;
+    release();
+}
+
+// Releases the samples no sending controller can still precede
+void ControllerPool::release()
+{
+    const qint64 now = clock.elapsed();
+    bool bounded = false;
+    quint32 watermark = 0;
+    for (const Source &source : std::as_const(sources))
+    {
+        if (source.lastArrivalMs >= 0 && now - source.lastArrivalMs < MERGE_STALL_MS)
+        {
+            watermark = bounded ? qMin(watermark, source.lastTimestamp) : source.lastTimestamp;
+            bounded = true;
+        }
+    }
+
+    merged.resize(0);
+    for (Source &source : sources)
+    {
+        if (source.pending.isEmpty())
+        {
+            continue;
+        }
+        if (!bounded)
+        {
+            merged.append(source.pending);
+            source.pending.clear();
+            continue;
+        }
+        // a controller's samples are in timestamp order, pads interleaved
+        auto firstHeld = std::stable_partition(source.pending.begin(), source.pending.end(),
+                                               [watermark](const ExamSample &s) { return s.timestamp <= watermark; });
+        const int count = int(firstHeld - source.pending.begin());
+        for (int i = 0; i < count; ++i)
+        {
+            merged.append(source.pending.at(i));
+        }
+        source.pending.remove(0, count);
+    }
+
+    if (merged.isEmpty())
+    {
+        return;
+    }
+    std::stable_sort(merged.begin(), merged.end(), [](const ExamSample &a, const ExamSample &b) {
+        return a.timestamp < b.timestamp;
+    });
+    emit samplesReceived(merged);
+}
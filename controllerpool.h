@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QObject>
+#include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "examdata.h"
+
+class Settings;
+class ControllerInterface;
+class QThread;
+
+// All the controllers of the installation: the one on Settings::serialPort
+// (index 0, the one probed and licensed at startup) plus one for each of
+// Settings::extraSerialPorts. Each controller lives in its own thread, where
+// its port is read and its frames decoded, so decoding scales with the cores.
+//
+// With a single controller samplesReceived() passes its batches through as
+// they are. With more, each controller's timestamps are moved to a common
+// time base (the host clock at its first batch after startStream()) and the
+// batches are merged in timestamp order: samples are held until every
+// controller that is still sending has reached their time, a controller
+// silent for MERGE_STALL_MS no longer holds the others back. Pads are
+// numbered across controllers, see globalPad().
+//
+// With Settings::realTimeEnabled the acquisition threads are set up as
+// described in realtime.h.
+class ControllerPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int MAX_CONTROLLERS = 15;      // global pad addresses fit a byte, and a PadSet
+    static const int MERGE_STALL_MS = 50;
+
+    explicit ControllerPool(Settings &settings, QObject *parent = nullptr);
+    ~ControllerPool();
+
+    int count() const { return sources.size(); }
+    ControllerInterface *controller(int index) const { return sources.at(index).controller; }
+
+    bool startStream();
+    bool stopStream();
+
+    // Controller 0 captures to 'path', the others to path.1, path.2, ...
+    void startCapture(const QString &path);
+
+signals:
+    void samplesReceived(const ExamSamples &samples);
+
+private:
+    struct Source
+    {
+        ControllerInterface *controller = nullptr;
+        QThread *thread = nullptr;
+        ExamSamples pending;            // common time base, not yet released
+        bool synced = false;
+        qint64 offsetMs = 0;            // device timestamp -> common time base
+        quint32 lastTimestamp = 0;
+        qint64 lastArrivalMs = -1;
+    };
+
+    void onSamples(int index, const ExamSamples &samples);
+    void release();
+
+    QVector<Source> sources;
+    QElapsedTimer clock;
+    QTimer stallTimer;
+    ExamSamples merged;
+};
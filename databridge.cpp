@@ -1,10 +1,297 @@
 #include "databridge.h"
+#include "MariaDBInterface.h"
+#include "controllerpool.h"
+#include "framestreamserver.h"
+#include "replaysource.h"
+#include "examdata.h"
 #include "settings.h"
+#include "metrics.h"
+#include "trace.h"
+#include "websockettransport.h"
 #include <QDebug>
+#include <QDir>
 #include <QRandomGenerator>
 
+static const int MAX_PAGE_SIZE = 500;
+static const int MIN_COP_FZ = 20;          // below this the COP is meaningless (raw units)
+
 DataBridge::DataBridge(QObject *parent) : QObject(parent) {
     m_dataList << "Iniziale 1" << "Iniziale 2";
+
+    connect(&m_displayTick, &QTimer::timeout, this, &DataBridge::flushLive);
+    setDisplayRate(30);
+    setLive("startup.ready", false);
+    m_rateTimer.start();
+}
+
+void DataBridge::setDisplayRate(int hz) {
+    hz = qBound(1, hz, 120);
+    m_displayTick.setTimerType(Qt::PreciseTimer);
+    m_displayTick.start(1000 / hz);
+}
+
+void DataBridge::setDatabase(MariaDBInterface *db) {
+    m_db = db;
+}
+
+void DataBridge::setStartupStage(const QString &stage, const QString &state) {
+    setLive("startup." + stage, state);
+}
+
+void DataBridge::setStartupReady(bool registered) {
+    setLive("startup.ready", true);
+    setLive("startup.registered", registered);
+}
+
+void DataBridge::setLicenseState(const QString &state, const QDate &checkDate) {
+    setLive("license.renewal", state);
+    setLive("license.checkDate", checkDate.toString(Qt::ISODate));
+}
+
+void DataBridge::setControllers(ControllerPool *controllers) {
+    m_controllers = controllers;
+}
+
+void DataBridge::setFrameStream(FrameStreamServer *stream) {
+    m_stream = stream;
+}
+
+void DataBridge::setSampleRate(int hz) {
+    m_sampleRate = hz;
+}
+
+void DataBridge::setReplay(ReplaySource *replay) {
+    m_replay = replay;
+    connect(m_replay, &ReplaySource::stateChanged, this, [this](bool playing) {
+        setLive("replay.playing", playing);
+        setLive("replay.position", m_replay->position());
+    });
+}
+
+int DataBridge::replayExam(int examID) {
+    const int requestID = ++m_lastRequestID;
+
+    // the entry keeps the samples alive even if the cache evicts them
+    bool queued = m_replay && runInDatabase([this, requestID, examID](MariaDBInterface *db) {
+        const ExamCache::Entry samples = db->loadExam(examID);
+        QMetaObject::invokeMethod(this, [this, requestID, examID, samples]() {
+            m_replay->setSamples(samples, examID);
+            setLive("replay.exam", examID);
+            setLive("replay.duration", m_replay->duration());
+            setLive("replay.position", 0);
+            setLive("replay.speed", m_replay->speed());
+            emit replayLoaded(requestID, examID, m_replay->duration());
+        }, Qt::QueuedConnection);
+    });
+
+    if (!queued) {
+        QMetaObject::invokeMethod(this, [this, requestID, examID]() {
+            emit replayLoaded(requestID, examID, 0);
+        }, Qt::QueuedConnection);
+    }
+    return requestID;
+}
+
+bool DataBridge::replayPlay() {
+    if (!m_replay)
+        return false;
+    if (m_streaming) {
+        MYWARNING << "Replay refused: the controllers are streaming";
+        return false;
+    }
+    m_replay->play();
+    return true;
+}
+
+void DataBridge::replayPause() {
+    if (m_replay)
+        m_replay->pause();
+}
+
+void DataBridge::replaySeek(double ms) {
+    if (!m_replay)
+        return;
+    m_replay->seek(quint32(qBound(0.0, ms, 4294967295.0)));
+    setLive("replay.position", m_replay->position());
+}
+
+void DataBridge::replaySetSpeed(double speed) {
+    if (!m_replay)
+        return;
+    m_replay->setSpeed(speed);
+    setLive("replay.speed", m_replay->speed());
+}
+
+void DataBridge::replayStop() {
+    if (!m_replay)
+        return;
+    m_replay->pause();
+    m_replay->seek(0);
+    setLive("replay.position", 0);
+}
+
+bool DataBridge::subscribe(const QString &client, const QVariantMap &subscription) {
+    StreamSubscription sub;
+    if (!m_stream || client.isEmpty() || !StreamSubscription::fromVariant(subscription, sub))
+        return false;
+    return m_stream->setSubscription(client, sub);
+}
+
+QVariantMap DataBridge::subscription(const QString &client) const {
+    StreamSubscription sub;
+    if (!m_stream || client.isEmpty() || !m_stream->subscription(client, sub))
+        return {};
+    return sub.toVariant();
+}
+
+bool DataBridge::startStream() {
+    if (m_replay && m_replay->isPlaying()) {
+        MYWARNING << "Stream refused: a replay is playing";
+        return false;
+    }
+    const bool ok = m_controllers && m_controllers->startStream();
+    m_streaming = ok;
+    setLive("status.streaming", ok);
+    return ok;
+}
+
+bool DataBridge::stopStream() {
+    const bool ok = m_controllers && m_controllers->stopStream();
+    m_streaming = false;
+    setLive("status.streaming", false);
+    if (m_recording)
+        stopRecording();
+    return ok;
+}
+
+bool DataBridge::startRecording(int patientID, int typeID) {
+    if (m_recording || !m_streaming || !m_db || patientID <= 0 || typeID <= 0) {
+        MYWARNING << "Recording refused:" << (m_recording ? "already recording" : !m_streaming ? "not streaming" : "no database or invalid IDs");
+        return false;
+    }
+    m_recording = true;
+    m_recordPatient = patientID;
+    m_recordType = typeID;
+    m_recordStart = QDateTime::currentDateTime();
+    m_recordIndex = ExamIndexBuilder();
+    m_recordSummary.reset();
+    setLive("recording.active", true);
+    setLive("recording.frames", 0);
+    MYINFO << "Recording exam of patient" << patientID << "type" << typeID;
+    return true;
+}
+
+int DataBridge::stopRecording() {
+    const int requestID = ++m_lastRequestID;
+    if (!m_recording) {
+        QMetaObject::invokeMethod(this, [this, requestID]() {
+            emit examRecorded(requestID, -1);
+        }, Qt::QueuedConnection);
+        return requestID;
+    }
+
+    m_recording = false;
+    setLive("recording.active", false);
+    setLive("recording.frames", m_recordSummary.frameCount());
+
+    // the builder and summary move to the job, the next recording starts empty
+    const int patientID = m_recordPatient;
+    const int typeID = m_recordType;
+    const QDateTime start = m_recordStart;
+    const int sampleRate = m_sampleRate;
+    ExamIndexBuilder index = std::move(m_recordIndex);
+    const ExamSummary summary = m_recordSummary;
+    m_recordIndex = ExamIndexBuilder();
+    m_recordSummary.reset();
+
+    bool queued = runInDatabase([this, requestID, patientID, typeID, start, sampleRate, index, summary](MariaDBInterface *db) mutable {
+        const quint32 channelMask = (1u << EXAM_CHANNELS) - 1;
+        const int examID = summary.frameCount() > 0
+                               ? db->saveExam(patientID, typeID, start, sampleRate, channelMask, index, summary)
+                               : -1;
+        QMetaObject::invokeMethod(this, [this, requestID, examID]() {
+            emit examRecorded(requestID, examID);
+        }, Qt::QueuedConnection);
+    });
+
+    if (!queued) {
+        QMetaObject::invokeMethod(this, [this, requestID]() {
+            emit examRecorded(requestID, -1);
+        }, Qt::QueuedConnection);
+    }
+    return requestID;
+}
+
+QVariantMap DataBridge::liveSnapshot() const {
+    QVariantMap snapshot = m_liveSent;
+    for (auto it = m_livePending.cbegin(); it != m_livePending.cend(); ++it)
+        snapshot.insert(it.key(), it.value());
+    return snapshot;
+}
+
+void DataBridge::onSamples(const ExamSamples &samples) {
+    HUM_TRACE("process", "live.samples");
+    m_samplesSinceTick += quint64(samples.size());
+
+    if (m_recording) {
+        for (const ExamSample &s : samples)
+            m_recordIndex.addSample(s);
+        m_recordSummary.addSamples(samples);
+        setLive("recording.frames", m_recordSummary.frameCount());
+    }
+
+    // only the newest sample of each pad matters for the display
+    const ExamSample *latest[256] = {};
+    for (const ExamSample &s : samples)
+        latest[s.padAddress] = &s;
+
+    for (int pad = 0; pad < 256; ++pad) {
+        const ExamSample *s = latest[pad];
+        if (!s)
+            continue;
+
+        const QString prefix = QString("p%1.").arg(pad);
+        for (int c = 0; c < EXAM_CHANNELS; ++c)
+            setLive(prefix + examChannelNames[c], s->channel[c]);
+
+        // COP on the plate surface: x = -My / Fz, y = Mx / Fz
+        const int fz = s->channel[CH_FZ];
+        if (qAbs(fz) >= MIN_COP_FZ) {
+            setLive(prefix + "copx", qRound(-1000.0 * s->channel[CH_MY] / fz) / 1000.0);
+            setLive(prefix + "copy", qRound(1000.0 * s->channel[CH_MX] / fz) / 1000.0);
+        }
+    }
+    metrics().livePendingFields.set(m_livePending.size());
+}
+
+void DataBridge::setLive(const QString &key, const QVariant &value) {
+    auto sent = m_liveSent.constFind(key);
+    if (sent != m_liveSent.cend() && sent.value() == value)
+        m_livePending.remove(key);     // back to what the clients have
+    else
+        m_livePending.insert(key, value);
+}
+
+void DataBridge::flushLive() {
+    HUM_TRACE("process", "live.flush");
+    const qint64 elapsed = m_rateTimer.restart();
+    if (elapsed > 0)
+        setLive("status.rate", qRound(m_samplesSinceTick * 1000.0 / elapsed));
+    m_samplesSinceTick = 0;
+
+    if (m_replay && m_replay->isPlaying())
+        setLive("replay.position", m_replay->position());
+
+    if (m_livePending.isEmpty())
+        return;
+
+    for (auto it = m_livePending.cbegin(); it != m_livePending.cend(); ++it)
+        m_liveSent.insert(it.key(), it.value());
+
+    QVariantMap changes;
+    changes.swap(m_livePending);
+    metrics().livePendingFields.set(0);
+    emit liveUpdate(changes);
 }
 
 QStringList DataBridge::dataList() const {
@@ -22,3 +309,214 @@ void DataBridge::sendLog(const QString &msg) {
     MYDEBUG << "[Browser log]: " << msg;
     emit logSent(QString("Qt ha ricevuto: %1").arg(msg));
 }
+
+bool DataBridge::runInDatabase(const std::function<void(MariaDBInterface *)> &job) {
+    if (!m_db) {
+        MYWARNING << "Database not available";
+        return false;
+    }
+
+    MariaDBInterface *db = m_db;
+    QElapsedTimer queued;
+    queued.start();
+    metrics().dbPendingJobs.add(1);
+
+    QMetaObject::invokeMethod(db, [db, job, queued]() {
+        metrics().dbPendingJobs.add(-1);
+        metrics().dbQueueLatency.recordSince(queued);
+
+        HUM_TRACE("db", "job");
+        QElapsedTimer timer;
+        timer.start();
+        job(db);
+        metrics().dbJobLatency.recordSince(timer);
+    }, Qt::QueuedConnection);
+    return true;
+}
+
+int DataBridge::searchPatients(const QString &text, const QVariantMap &after, int pageSize) {
+    const int requestID = ++m_lastRequestID;
+    pageSize = qBound(1, pageSize, MAX_PAGE_SIZE);
+
+    // Runs in the database thread, the page is emitted back in this one
+    bool queued = runInDatabase([this, requestID, text, after, pageSize](MariaDBInterface *db) {
+        QVariantMap next;
+        QVariantList rows = db->searchPatients(text, after, pageSize, next);
+        QMetaObject::invokeMethod(this, [this, requestID, rows, next]() {
+            emit patientsPage(requestID, rows, next);
+        }, Qt::QueuedConnection);
+    });
+
+    if (!queued) {
+        QMetaObject::invokeMethod(this, [this, requestID]() {
+            emit patientsPage(requestID, {}, {});
+        }, Qt::QueuedConnection);
+    }
+    return requestID;
+}
+
+int DataBridge::listExams(int patientID, int typeID, const QVariantMap &after, int pageSize) {
+    const int requestID = ++m_lastRequestID;
+    pageSize = qBound(1, pageSize, MAX_PAGE_SIZE);
+
+    bool queued = runInDatabase([this, requestID, patientID, typeID, after, pageSize](MariaDBInterface *db) {
+        QVariantMap next;
+        QVariantList rows = db->listExams(patientID, typeID, after, pageSize, next);
+        QMetaObject::invokeMethod(this, [this, requestID, rows, next]() {
+            emit examsPage(requestID, rows, next);
+        }, Qt::QueuedConnection);
+    });
+
+    if (!queued) {
+        QMetaObject::invokeMethod(this, [this, requestID]() {
+            emit examsPage(requestID, {}, {});
+        }, Qt::QueuedConnection);
+    }
+    return requestID;
+}
+
+int DataBridge::readExamRange(int examID, double fromMs, double toMs) {
+    const int requestID = ++m_lastRequestID;
+    const quint32 from = quint32(qBound(0.0, fromMs, 4294967295.0));
+    const quint32 to = quint32(qBound(0.0, toMs, 4294967295.0));
+
+    bool queued = runInDatabase([this, requestID, examID, from, to](MariaDBInterface *db) {
+        const ExamSamples samples = db->readExamRange(examID, from, to);
+        QByteArray data;
+        data.reserve(samples.size() * EXAM_SAMPLE_BYTES);
+        for (const ExamSample &s : samples)
+            appendSample(data, s);
+        const QString encoded = QString::fromLatin1(data.toBase64());
+        QMetaObject::invokeMethod(this, [this, requestID, encoded]() {
+            emit examRange(requestID, encoded);
+        }, Qt::QueuedConnection);
+    });
+
+    if (!queued) {
+        QMetaObject::invokeMethod(this, [this, requestID]() {
+            emit examRange(requestID, QString());
+        }, Qt::QueuedConnection);
+    }
+    return requestID;
+}
+
+int DataBridge::readExamOverview(int examID, int pad, double fromMs, double toMs, int maxPoints) {
+    const int requestID = ++m_lastRequestID;
+    const quint32 from = quint32(qBound(0.0, fromMs, 4294967295.0));
+    const quint32 to = quint32(qBound(0.0, toMs, 4294967295.0));
+
+    bool queued = runInDatabase([this, requestID, examID, pad, from, to, maxPoints](MariaDBInterface *db) {
+        const QVariantMap overview = db->readExamOverview(examID, pad, from, to, maxPoints);
+        QMetaObject::invokeMethod(this, [this, requestID, overview]() {
+            emit examOverview(requestID, overview);
+        }, Qt::QueuedConnection);
+    });
+
+    if (!queued) {
+        QMetaObject::invokeMethod(this, [this, requestID]() {
+            emit examOverview(requestID, {});
+        }, Qt::QueuedConnection);
+    }
+    return requestID;
+}
+
+int DataBridge::openExam(int examID) {
+    const int requestID = ++m_lastRequestID;
+
+    QObject *client = WebSocketTransport::current();
+    releaseExam(client);
+    if (m_db) {
+        if (client && !m_openExams.contains(client)) {
+            connect(client, &QObject::destroyed, this, [this, client]() {
+                releaseExam(client);
+                m_openExams.remove(client);
+            });
+        }
+        m_db->examCache()->pin(examID);
+        m_openExams.insert(client, examID);
+    }
+
+    bool queued = runInDatabase([this, requestID, examID](MariaDBInterface *db) {
+        const int frameCount = db->loadExam(examID)->size();
+        QMetaObject::invokeMethod(this, [this, requestID, examID, frameCount]() {
+            emit examOpened(requestID, examID, frameCount);
+        }, Qt::QueuedConnection);
+    });
+
+    if (!queued) {
+        QMetaObject::invokeMethod(this, [this, requestID, examID]() {
+            emit examOpened(requestID, examID, 0);
+        }, Qt::QueuedConnection);
+    }
+    return requestID;
+}
+
+void DataBridge::closeExam() {
+    releaseExam(WebSocketTransport::current());
+}
+
+void DataBridge::releaseExam(QObject *client) {
+    auto it = m_openExams.find(client);
+    if (it == m_openExams.end() || it.value() <= 0)
+        return;
+    if (m_db)
+        m_db->examCache()->unpin(it.value());
+    it.value() = 0;
+}
+
+QVariantMap DataBridge::examCacheStats() const {
+    if (!m_db)
+        return {};
+    return m_db->examCache()->stats();
+}
+
+void DataBridge::setExportDirectory(const QString &dir) {
+    m_exportDir = dir;
+}
+
+QString DataBridge::exportFilePath(const QString &fileName) const {
+    if (m_exportDir.isEmpty() || fileName.isEmpty() || fileName == "." || fileName.contains("..")
+        || fileName.contains('/') || fileName.contains('\\') || fileName.contains(':')) {
+        MYWARNING << "Exam file name refused:" << fileName;
+        return QString();
+    }
+    return QDir(m_exportDir).filePath(fileName);
+}
+
+int DataBridge::exportExam(int examID, const QString &fileName) {
+    const int requestID = ++m_lastRequestID;
+    const QString path = exportFilePath(fileName);
+
+    bool queued = !path.isEmpty() && QDir().mkpath(m_exportDir) && runInDatabase([this, requestID, examID, path](MariaDBInterface *db) {
+        const bool ok = db->exportExam(examID, path);
+        QMetaObject::invokeMethod(this, [this, requestID, ok]() {
+            emit examExported(requestID, ok);
+        }, Qt::QueuedConnection);
+    });
+
+    if (!queued) {
+        QMetaObject::invokeMethod(this, [this, requestID]() {
+            emit examExported(requestID, false);
+        }, Qt::QueuedConnection);
+    }
+    return requestID;
+}
+
+int DataBridge::importExam(const QString &fileName, int patientID) {
+    const int requestID = ++m_lastRequestID;
+    const QString path = exportFilePath(fileName);
+
+    bool queued = !path.isEmpty() && runInDatabase([this, requestID, path, patientID](MariaDBInterface *db) {
+        const int examID = db->importExam(path, patientID);
+        QMetaObject::invokeMethod(this, [this, requestID, examID]() {
+            emit examImported(requestID, examID);
+        }, Qt::QueuedConnection);
+    });
+
+    if (!queued) {
+        QMetaObject::invokeMethod(this, [this, requestID]() {
+            emit examImported(requestID, -1);
+        }, Qt::QueuedConnection);
+    }
+    return requestID;
+}
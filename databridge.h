@@ -3,6 +3,22 @@
 
 #include <QObject>
 #include <QStringList>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QDate>
+#include <QDateTime>
+#include <QHash>
+#include <functional>
+#include "examdata.h"
+#include "examindex.h"
+#include "examsummary.h"
+
+class MariaDBInterface;
+class ControllerPool;
+class FrameStreamServer;
+class ReplaySource;
 
 class DataBridge : public QObject {
     Q_OBJECT
@@ -11,17 +27,139 @@ class DataBridge : public QObject {
 public:
     explicit DataBridge(QObject *parent = nullptr);
 
+    // The database interface lives in its own thread, queries are queued to it
+    void setDatabase(MariaDBInterface *db);
+    void setControllers(ControllerPool *controllers);
+    void setFrameStream(FrameStreamServer *stream);
+    void setReplay(ReplaySource *replay);
+    void setSampleRate(int hz);             // stored with the recorded exams
+
+    // Live values (per pad forces, COP, status) are not pushed as they change:
+    // changes are gathered and flushed once per display tick as a single
+    // liveUpdate() carrying only the fields that changed since the last one
+    void setDisplayRate(int hz);
+
     Q_INVOKABLE void triggerData();
     Q_INVOKABLE void sendLog(const QString &msg);
 
+    // Samples go out on the binary data stream socket, not on the web channel
+    Q_INVOKABLE bool startStream();
+    Q_INVOKABLE bool stopStream();
+
+    // Records the live stream as a new exam of 'patientID'. Summary, storage chunks
+    // and pyramid are built as the samples arrive, stopRecording() only writes them
+    // and examRecorded() gives the new exam ID (-1 on error). Needs the controllers
+    // streaming; stopStream() also ends the recording. "recording.*" live fields
+    // follow it.
+    Q_INVOKABLE bool startRecording(int patientID, int typeID);
+    Q_INVOKABLE int stopRecording();
+
+    // Selects what the data stream client 'client' (the token sent by the server
+    // when the data socket connects) receives: { pads: [1, 2], channels: ["fz"],
+    // streams: ["raw", "filtered", "cop"] }. Missing lists mean everything,
+    // unsubscribed pads and columns are never encoded for that client.
+    Q_INVOKABLE bool subscribe(const QString &client, const QVariantMap &subscription);
+    Q_INVOKABLE QVariantMap subscription(const QString &client) const;
+
+    // Replay of a stored exam through the live pipeline. replayExam() loads it
+    // (replayLoaded() gives its duration, 0 on error), the others control playback;
+    // state and position come as "replay.*" live fields. Replayed samples take the
+    // same path as the live ones with the same pad addresses: replayPlay() fails
+    // while the controllers are streaming, startStream() while a replay plays.
+    Q_INVOKABLE int replayExam(int examID);
+    Q_INVOKABLE bool replayPlay();
+    Q_INVOKABLE void replayPause();
+    Q_INVOKABLE void replaySeek(double ms);
+    Q_INVOKABLE void replaySetSpeed(double speed);
+    Q_INVOKABLE void replayStop();
+
+    // Every live field with its last sent value, for a client that just connected
+    Q_INVOKABLE QVariantMap liveSnapshot() const;
+
+    // Keyset-paginated searches: the result comes back with patientsPage()/examsPage()
+    // carrying the returned request ID. Pass the 'next' cursor of a page as 'after'
+    // to get the following one, an empty object for the first page.
+    Q_INVOKABLE int searchPatients(const QString &text, const QVariantMap &after, int pageSize);
+    Q_INVOKABLE int listExams(int patientID, int typeID, const QVariantMap &after, int pageSize);
+
+    // Seek inside a stored exam: examRange() carries the samples in [fromMs, toMs]
+    // as base64 of the storage encoding (examdata.h), examOverview() the min/max
+    // pyramid buckets of one pad for plotting long spans (examindex.h)
+    Q_INVOKABLE int readExamRange(int examID, double fromMs, double toMs);
+    Q_INVOKABLE int readExamOverview(int examID, int pad, double fromMs, double toMs, int maxPoints);
+
+    // The open exam is loaded in the exam cache and pinned there until the same
+    // client opens another one, calls closeExam() or disconnects. Each channel
+    // client has its own open exam. examOpened() reports the frame count
+    Q_INVOKABLE int openExam(int examID);
+    Q_INVOKABLE void closeExam();
+    Q_INVOKABLE QVariantMap examCacheStats() const;
+
+    // Native exam files. Clients only give a file name, the file is always in the
+    // export directory (Settings::exportPath): names with separators or ".." fail.
+    void setExportDirectory(const QString &dir);
+    Q_INVOKABLE int exportExam(int examID, const QString &fileName);
+    // patientID 0 imports the exam for a new patient, see MariaDBInterface::importExam()
+    Q_INVOKABLE int importExam(const QString &fileName, int patientID);
+
     QStringList dataList() const;
 
+public slots:
+    void onSamples(const ExamSamples &samples);
+
+    // Startup progress (StartupSequence) as "startup.<stage>" live fields, then
+    // "startup.ready" and "startup.registered"
+    void setStartupStage(const QString &stage, const QString &state);
+    void setStartupReady(bool registered);
+
+    // Background license renewal (LicenseRenewal) as "license.*" live fields
+    void setLicenseState(const QString &state, const QDate &checkDate);
+
 signals:
     void dataListChanged();
     void logSent(const QString &msg);
+    void patientsPage(int requestID, const QVariantList &rows, const QVariantMap &next);
+    void examsPage(int requestID, const QVariantList &rows, const QVariantMap &next);
+    void examRange(int requestID, const QString &samples);
+    void examOverview(int requestID, const QVariantMap &overview);
+    void examOpened(int requestID, int examID, int frameCount);
+    void examExported(int requestID, bool ok);
+    void examImported(int requestID, int examID);      // -1 on error
+    void examRecorded(int requestID, int examID);      // -1 on error
+    void liveUpdate(const QVariantMap &changes);
+    void replayLoaded(int requestID, int examID, double durationMs);
 
 private:
+    bool runInDatabase(const std::function<void(MariaDBInterface *)> &job);
+    void setLive(const QString &key, const QVariant &value);
+    void flushLive();
+    void releaseExam(QObject *client);
+    QString exportFilePath(const QString &fileName) const;     // empty if not a bare file name
+
     QStringList m_dataList;
+    MariaDBInterface *m_db = nullptr;
+    ControllerPool *m_controllers = nullptr;
+    FrameStreamServer *m_stream = nullptr;
+    ReplaySource *m_replay = nullptr;
+    int m_lastRequestID = 0;
+    bool m_streaming = false;
+    int m_sampleRate = 0;
+
+    // exam being recorded
+    bool m_recording = false;
+    int m_recordPatient = 0;
+    int m_recordType = 0;
+    QDateTime m_recordStart;
+    ExamIndexBuilder m_recordIndex;
+    ExamSummary m_recordSummary;
+    QHash<QObject *, int> m_openExams;      // by WebSocketTransport::current(), 0 = none
+    QString m_exportDir;
+
+    QVariantMap m_liveSent;         // values the clients already have
+    QVariantMap m_livePending;      // changed since the last tick
+    QTimer m_displayTick;
+    QElapsedTimer m_rateTimer;
+    quint64 m_samplesSinceTick = 0;
 };
 
 #endif // DATABRIDGE_H
@@ -0,0 +1,153 @@
+#include "examcache.h"
+#include "settings.h"
+
+ExamCache::ExamCache(qint64 budgetBytes)
+    : budgetBytes(budgetBytes)
+{
+}
+
+void ExamCache::setBudget(qint64 budgetBytes)
+{
+    QMutexLocker locker(&mutex);
+    this->budgetBytes = budgetBytes;
+    evict();
+}
+
+qint64 ExamCache::budget() const
+{
+    QMutexLocker locker(&mutex);
+    return budgetBytes;
+}
+
+ExamCache::Entry ExamCache::get(int examID)
+{
+    QMutexLocker locker(&mutex);
+
+    auto it = entries.find(examID);
+    if (it == entries.end())
+    {
+        ++missCount;
+        return {};
+    }
+
+    ++hitCount;
+    lru.splice(lru.begin(), lru, it->position);
+    return it->samples;
+}
+
+void ExamCache::insert(int examID, const Entry &samples)
+{
+    if (!samples)
+    {
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+
+    const qint64 cost = qint64(samples->size()) * qint64(sizeof(ExamSample));
+    if (cost > budgetBytes && !pins.contains(examID))
+    {
+        MYDEBUG << "Exam" << examID << "exceeds the cache budget, not cached";
+        return;
+    }
+
+    auto it = entries.find(examID);
+    if (it != entries.end())
+    {
+        usedBytes -= it->cost;
+        lru.erase(it->position);
+        entries.erase(it);
+    }
+
+    lru.push_front(examID);
+    Node node;
+    node.samples = samples;
+    node.cost = cost;
+    node.position = lru.begin();
+    entries.insert(examID, node);
+    usedBytes += cost;
+
+    evict();
+}
+
+void ExamCache::remove(int examID)
+{
+    QMutexLocker locker(&mutex);
+
+    auto it = entries.find(examID);
+    if (it != entries.end())
+    {
+        usedBytes -= it->cost;
+        lru.erase(it->position);
+        entries.erase(it);
+    }
+}
+
+void ExamCache::pin(int examID)
+{
+    QMutexLocker locker(&mutex);
+    ++pins[examID];
+}
+
+void ExamCache::unpin(int examID)
+{
+    QMutexLocker locker(&mutex);
+
+    auto it = pins.find(examID);
+    if (it == pins.end())
+    {
+        return;
+    }
+    if (--it.value() <= 0)
+    {
+        pins.erase(it);
+        evict();
+    }
+}
+
+void ExamCache::evict()
+{
+    // called with mutex locked; walks from the least recently used, skipping pinned exams
+    auto it = lru.end();
+    while (usedBytes > budgetBytes && it != lru.begin())
+    {
+        --it;
+        const int examID = *it;
+        if (pins.contains(examID))
+        {
+            continue;
+        }
+
+        usedBytes -= entries.value(examID).cost;
+        entries.remove(examID);
+        it = lru.erase(it);
+        ++evictionCount;
+    }
+}
+
+quint64 ExamCache::hits() const
+{
+    QMutexLocker locker(&mutex);
+    return hitCount;
+}
+
+quint64 ExamCache::misses() const
+{
+    QMutexLocker locker(&mutex);
+    return missCount;
+}
+
+QVariantMap ExamCache::stats() const
+{
+    QMutexLocker locker(&mutex);
+
+    QVariantMap map;
+    map["hits"] = hitCount;
+    map["misses"] = missCount;
+    map["evictions"] = evictionCount;
+    map["entries"] = entries.size();
+    map["pinned"] = pins.size();
+    map["bytes"] = usedBytes;
+    map["budget"] = budgetBytes;
+    return map;
+}
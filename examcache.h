@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVariantMap>
+#include <list>
+#include "examdata.h"
+
+// LRU cache of decoded exams keyed by t_exams.ID, bounded by a byte budget.
+// Pinned exams (the one on screen) are never evicted. Entries are shared
+// pointers, so a reader keeps its data even if the exam is evicted meanwhile.
+// Thread safe.
+class ExamCache
+{
+public:
+    typedef QSharedPointer<const ExamSamples> Entry;
+
+    explicit ExamCache(qint64 budgetBytes = 0);
+
+    void setBudget(qint64 budgetBytes);
+    qint64 budget() const;
+
+    Entry get(int examID);      // null on miss
+    void insert(int examID, const Entry &samples);
+    void remove(int examID);
+
+    void pin(int examID);
+    void unpin(int examID);
+
+    quint64 hits() const;
+    quint64 misses() const;
+    QVariantMap stats() const;
+
+private:
+    struct Node
+    {
+        Entry samples;
+        qint64 cost = 0;
+        std::list<int>::iterator position;
+    };
+
+    void evict();
+
+    mutable QMutex mutex;
+    QHash<int, Node> entries;
+    QHash<int, int> pins;           // pin count, also for exams not loaded yet
+    std::list<int> lru;             // most recently used first
+    qint64 budgetBytes;
+    qint64 usedBytes = 0;
+    quint64 hitCount = 0;
+    quint64 missCount = 0;
+    quint64 evictionCount = 0;
+};
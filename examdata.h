@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QVector>
+#include <QByteArray>
+#include <QtEndian>
+#include <bitset>
+
+// Decoded force plate sample, one per received T_Frame.
+// Channels are kept in raw ADC units as sent by the pads.
+
+#define EXAM_CHANNELS       6
+#define EXAM_SAMPLE_BYTES   18      // serialised size, see appendSample()
+#define PADS_PER_CONTROLLER 16
+
+enum EExamChannel
+{
+    CH_FX,
+    CH_FY,
+    CH_FZ,
+    CH_MX,
+    CH_MY,
+    CH_MZ
+};
+
+static const char *const examChannelNames[EXAM_CHANNELS] = { "fx", "fy", "fz", "mx", "my", "mz" };
+
+struct ExamSample
+{
+    quint32 timestamp = 0;                  // ms, as in T_Frame (common time base with several controllers)
+    quint8  padAddress = 0;                 // 1..16 on the first controller, see globalPad()
+    quint8  controller = 0;                 // index in the ControllerPool
+    qint16  channel[EXAM_CHANNELS] = {};
+};
+
+// With several controllers, pads are numbered across all of them so that
+// everything keyed by pad address keeps working: controller n pad p is
+// n * PADS_PER_CONTROLLER + p (the first controller keeps 1..16).
+inline quint8 globalPad(int controller, quint8 pad)
+{
+    return static_cast<quint8>(controller * PADS_PER_CONTROLLER + pad);
+}
+
+inline quint8 controllerOfPad(quint8 globalPadAddress)
+{
+    return globalPadAddress ? static_cast<quint8>((globalPadAddress - 1) / PADS_PER_CONTROLLER) : 0;
+}
+
+// A set of global pad addresses, every one globalPad() can give
+typedef std::bitset<256> PadSet;
+
+typedef QVector<ExamSample> ExamSamples;
+
+// Storage encoding of a sample: little endian, no padding
+inline void appendSample(QByteArray &out, const ExamSample &s)
+{
+    char buf[EXAM_SAMPLE_BYTES];
+    qToLittleEndian<quint32>(s.timestamp, buf);
+    buf[4] = static_cast<char>(s.padAddress);
+    buf[5] = static_cast<char>(s.controller);
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        qToLittleEndian<qint16>(s.channel[c], buf + 6 + 2 * c);
+    }
+    out.append(buf, EXAM_SAMPLE_BYTES);
+}
+
+inline ExamSample readSample(const char *buf)
+{
+    ExamSample s;
+    s.timestamp = qFromLittleEndian<quint32>(buf);
+    s.padAddress = static_cast<quint8>(buf[4]);
+    s.controller = static_cast<quint8>(buf[5]);
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        s.channel[c] = qFromLittleEndian<qint16>(buf + 6 + 2 * c);
+    }
+    return s;
+}
@@ -0,0 +1,357 @@
+#include "examfile.h"
+#include "settings.h"
+#include <QJsonDocument>
+#include <cstring>
+
+static qint64 alignUp(qint64 value)
+{
+    return (value + EXAMFILE_ALIGN - 1) / EXAMFILE_ALIGN * EXAMFILE_ALIGN;
+}
+
+// ---------------------------------------------------------------------------
+// ExamFileWriter
+
+bool ExamFileWriter::open(const QString &path, const QJsonObject &metadata, quint32 sampleRate, quint32 channelMask)
+{
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        MYWARNING << "Cannot create" << path << ":" << file.errorString();
+        return false;
+    }
+
+    const QByteArray json = QJsonDocument(metadata).toJson(QJsonDocument::Compact);
+
+    header = {};
+    memcpy(header.magic, EXAMFILE_MAGIC, sizeof(header.magic));
+    header.version = EXAMFILE_VERSION;
+    header.metadataSize = quint32(json.size());
+    header.headerSize = quint32(alignUp(sizeof(ExamFileHeader) + json.size()));
+    header.sampleRate = sampleRate;
+    header.channelMask = channelMask;
+    header.channelCount = EXAM_CHANNELS;
+    index.clear();
+
+    // the header is rewritten by close() with counts and index offset
+    if (file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header)
+        || file.write(json) != json.size()
+        || !alignTo(header.headerSize))
+    {
+        abort();
+        return false;
+    }
+
+    return true;
+}
+
+bool ExamFileWriter::alignTo(qint64 boundary)
+{
+    const qint64 padding = boundary - file.pos();
+    if (padding <= 0)
+    {
+        return true;
+    }
+    return file.write(QByteArray(int(padding), '\0')) == padding;
+}
+
+bool ExamFileWriter::writeBlock(const ExamSamples &samples)
+{
+    if (!file.isOpen() || samples.isEmpty())
+    {
+        return file.isOpen();
+    }
+
+    const int n = samples.size();
+    const qint64 blockStart = alignUp(file.pos());
+    if (!alignTo(blockStart))
+    {
+        return false;
+    }
+
+    ExamFileBlockHeader block = {};
+    memcpy(block.magic, EXAMFILE_BLOCK_MAGIC, sizeof(block.magic));
+    block.sampleCount = quint32(n);
+    block.tStart = samples.first().timestamp;
+    block.tEnd = samples.last().timestamp;
+
+    // column layout
+    qint64 offset = alignUp(sizeof(ExamFileBlockHeader));
+    block.columnOffset[0] = quint32(offset);
+    offset = alignUp(offset + qint64(n) * 4);
+    block.columnOffset[1] = quint32(offset);
+    offset = alignUp(offset + n);
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        block.columnOffset[2 + c] = quint32(offset);
+        offset = alignUp(offset + qint64(n) * 2);
+    }
+    block.blockSize = quint32(offset);
+
+    // the whole block is built in one buffer, it is at most one storage chunk
+    QByteArray buffer(int(block.blockSize), '\0');
+    char *base = buffer.data();
+    memcpy(base, &block, sizeof(block));
+    quint32 *ts = reinterpret_cast<quint32 *>(base + block.columnOffset[0]);
+    quint8 *pads = reinterpret_cast<quint8 *>(base + block.columnOffset[1]);
+    qint16 *ch[EXAM_CHANNELS];
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        ch[c] = reinterpret_cast<qint16 *>(base + block.columnOffset[2 + c]);
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        const ExamSample &s = samples.at(i);
+        ts[i] = s.timestamp;
+        pads[i] = s.padAddress;
+        for (int c = 0; c < EXAM_CHANNELS; ++c)
+        {
+            ch[c][i] = s.channel[c];
+        }
+    }
+
+    if (file.write(buffer) != buffer.size())
+    {
+        return false;
+    }
+
+    ExamFileIndexEntry entry;
+    entry.offset = quint64(blockStart);
+    entry.firstSample = quint32(header.sampleCount);
+    entry.sampleCount = quint32(n);
+    entry.tStart = block.tStart;
+    entry.tEnd = block.tEnd;
+    index.append(entry);
+
+    header.sampleCount += quint64(n);
+    ++header.blockCount;
+    return true;
+}
+
+bool ExamFileWriter::close()
+{
+    if (!file.isOpen())
+    {
+        return false;
+    }
+
+    if (!alignTo(alignUp(file.pos())))
+    {
+        abort();
+        return false;
+    }
+
+    header.indexOffset = quint64(file.pos());
+
+    ExamFileTrailer trailer = {};
+    trailer.indexOffset = header.indexOffset;
+    trailer.blockCount = header.blockCount;
+    memcpy(trailer.magic, EXAMFILE_END_MAGIC, sizeof(trailer.magic));
+
+    const qint64 indexBytes = qint64(index.size()) * qint64(sizeof(ExamFileIndexEntry));
+    bool ok = file.write(reinterpret_cast<const char *>(index.constData()), indexBytes) == indexBytes
+              && file.write(reinterpret_cast<const char *>(&trailer), sizeof(trailer)) == sizeof(trailer)
+              && file.seek(0)
+              && file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header);
+
+    if (!ok)
+    {
+        MYWARNING << "Error writing" << file.fileName() << ":" << file.errorString();
+        abort();
+        return false;
+    }
+
+    file.close();
+    return true;
+}
+
+void ExamFileWriter::abort()
+{
+    if (file.isOpen())
+    {
+        file.close();
+    }
+    file.remove();
+}
+
+// ---------------------------------------------------------------------------
+// ExamFileReader
+
+ExamFileReader::~ExamFileReader()
+{
+    close();
+}
+
+bool ExamFileReader::open(const QString &path)
+{
+    close();
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        MYWARNING << "Cannot open" << path << ":" << file.errorString();
+        return false;
+    }
+
+    mapSize = file.size();
+    if (mapSize < qint64(sizeof(ExamFileHeader) + sizeof(ExamFileTrailer)))
+    {
+        MYWARNING << path << "is not an exam file";
+        close();
+        return false;
+    }
+
+    map = file.map(0, mapSize);
+    if (!map)
+    {
+        MYWARNING << "Cannot map" << path << ":" << file.errorString();
+        close();
+        return false;
+    }
+
+    hdr = reinterpret_cast<const ExamFileHeader *>(map);
+    const ExamFileTrailer *trailer = reinterpret_cast<const ExamFileTrailer *>(map + mapSize - sizeof(ExamFileTrailer));
+
+    // Offsets come from the file: every check is written so that it cannot wrap,
+    // and no pointer is formed before the offset it uses has been checked
+    const quint64 indexEnd = quint64(mapSize) - sizeof(ExamFileTrailer);
+    bool valid = memcmp(hdr->magic, EXAMFILE_MAGIC, sizeof(hdr->magic)) == 0
+                 && memcmp(trailer->magic, EXAMFILE_END_MAGIC, sizeof(trailer->magic)) == 0
+                 && hdr->version == EXAMFILE_VERSION
+                 && hdr->channelCount == EXAM_CHANNELS
+                 && hdr->indexOffset == trailer->indexOffset
+                 && hdr->blockCount == trailer->blockCount
+                 && qint64(sizeof(ExamFileHeader)) + hdr->metadataSize <= hdr->headerSize
+                 && hdr->headerSize <= hdr->indexOffset
+                 && hdr->indexOffset % EXAMFILE_ALIGN == 0
+                 && hdr->indexOffset <= indexEnd
+                 && hdr->blockCount <= (indexEnd - hdr->indexOffset) / sizeof(ExamFileIndexEntry)
+                 && quint64(hdr->blockCount) * sizeof(ExamFileIndexEntry) == indexEnd - hdr->indexOffset
+                 && (hdr->blockCount == 0 || hdr->indexOffset >= sizeof(ExamFileBlockHeader));
+
+    if (!valid)
+    {
+        MYWARNING << path << "is not a valid exam file";
+        close();
+        return false;
+    }
+
+    index = reinterpret_cast<const ExamFileIndexEntry *>(map + hdr->indexOffset);
+    for (quint32 i = 0; i < hdr->blockCount; ++i)
+    {
+        const ExamFileIndexEntry &e = index[i];
+        if (e.offset < hdr->headerSize || e.offset % EXAMFILE_ALIGN != 0
+            || e.offset > hdr->indexOffset - sizeof(ExamFileBlockHeader))
+        {
+            MYWARNING << path << ": corrupted block" << i;
+            close();
+            return false;
+        }
+
+        const ExamFileBlockHeader *b = reinterpret_cast<const ExamFileBlockHeader *>(map + e.offset);
+        bool blockValid = memcmp(b->magic, EXAMFILE_BLOCK_MAGIC, sizeof(b->magic)) == 0
+                          && b->sampleCount == e.sampleCount
+                          && b->blockSize <= hdr->indexOffset - e.offset
+                          && b->columnOffset[0] + quint64(b->sampleCount) * 4 <= b->blockSize
+                          && b->columnOffset[1] + quint64(b->sampleCount) <= b->blockSize;
+        for (int c = 0; blockValid && c < EXAM_CHANNELS; ++c)
+        {
+            blockValid = b->columnOffset[2 + c] % 2 == 0
+                         && b->columnOffset[2 + c] + quint64(b->sampleCount) * 2 <= b->blockSize;
+        }
+        if (!blockValid || b->columnOffset[0] % 4 != 0)
+        {
+            MYWARNING << path << ": corrupted block" << i;
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ExamFileReader::close()
+{
+    if (map)
+    {
+        file.unmap(const_cast<uchar *>(map));
+    }
+    map = nullptr;
+    hdr = nullptr;
+    index = nullptr;
+    mapSize = 0;
+    if (file.isOpen())
+    {
+        file.close();
+    }
+}
+
+QJsonObject ExamFileReader::metadata() const
+{
+    if (!hdr)
+    {
+        return {};
+    }
+
+    const QByteArray json = QByteArray::fromRawData(reinterpret_cast<const char *>(map) + sizeof(ExamFileHeader),
+                                                    int(hdr->metadataSize));
+    return QJsonDocument::fromJson(json).object();
+}
+
+ExamFileReader::Block ExamFileReader::block(int i) const
+{
+    Block block;
+    if (!hdr || i < 0 || i >= blockCount())
+    {
+        return block;
+    }
+
+    const uchar *base = map + index[i].offset;
+    const ExamFileBlockHeader *b = reinterpret_cast<const ExamFileBlockHeader *>(base);
+    block.count = int(b->sampleCount);
+    block.tStart = b->tStart;
+    block.tEnd = b->tEnd;
+    block.timestamps = reinterpret_cast<const quint32 *>(base + b->columnOffset[0]);
+    block.pads = base + b->columnOffset[1];
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        block.channel[c] = reinterpret_cast<const qint16 *>(base + b->columnOffset[2 + c]);
+    }
+    return block;
+}
+
+ExamSamples ExamFileReader::samples(int i) const
+{
+    const Block b = block(i);
+    ExamSamples samples(b.count);
+    for (int k = 0; k < b.count; ++k)
+    {
+        ExamSample &s = samples[k];
+        s.timestamp = b.timestamps[k];
+        s.padAddress = b.pads[k];
+        s.controller = controllerOfPad(s.padAddress);
+        for (int c = 0; c < EXAM_CHANNELS; ++c)
+        {
+            s.channel[c] = b.channel[c][k];
+        }
+    }
+    return samples;
+}
+
+int ExamFileReader::findBlock(quint32 t) const
+{
+    int lo = 0;
+    int hi = blockCount();
+    while (lo < hi)
+    {
+        const int mid = (lo + hi) / 2;
+        if (index[mid].tEnd < t)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <QFile>
+#include <QJsonObject>
+#include <QVector>
+#include "examdata.h"
+
+// Native exam file (.humx), all values little endian:
+//
+//   ExamFileHeader          64 bytes
+//   metadata                UTF-8 JSON, metadataSize bytes (patient, exam, pads,
+//                           calibration, column descriptors)
+//   blocks                  each one starts on an EXAMFILE_ALIGN boundary:
+//                             ExamFileBlockHeader
+//                             timestamps  quint32[sampleCount]
+//                             pads        quint8[sampleCount]
+//                             fx..mz      qint16[sampleCount] each
+//                           every column starts on an EXAMFILE_ALIGN boundary too,
+//                           so a mapped file can be read in place as typed arrays
+//   index                   ExamFileIndexEntry[blockCount]
+//   ExamFileTrailer         24 bytes, last in the file
+//
+// The structs below are the on-disk layout, read directly from the mapped file.
+
+#define EXAMFILE_MAGIC          "HUMEXAM1"
+#define EXAMFILE_BLOCK_MAGIC    "BLK1"
+#define EXAMFILE_END_MAGIC      "HUMEXEND"
+#define EXAMFILE_VERSION        1
+#define EXAMFILE_ALIGN          64
+
+static_assert(Q_BYTE_ORDER == Q_LITTLE_ENDIAN, "exam files are mapped in place, little endian hosts only");
+
+struct ExamFileHeader
+{
+    char    magic[8];
+    quint32 version;
+    quint32 headerSize;             // header + metadata, aligned: offset of the first block
+    quint32 metadataSize;
+    quint32 sampleRate;
+    quint32 channelMask;
+    quint32 channelCount;
+    quint64 sampleCount;
+    quint64 indexOffset;
+    quint32 blockCount;
+    quint32 reserved[3];
+};
+
+struct ExamFileBlockHeader
+{
+    char    magic[4];
+    quint32 sampleCount;
+    quint32 tStart;
+    quint32 tEnd;
+    quint32 columnOffset[2 + EXAM_CHANNELS];   // from block start: timestamps, pads, channels
+    quint32 blockSize;
+    quint32 reserved[3];
+};
+
+struct ExamFileIndexEntry
+{
+    quint64 offset;                 // block offset in the file
+    quint32 firstSample;
+    quint32 sampleCount;
+    quint32 tStart;
+    quint32 tEnd;
+};
+
+struct ExamFileTrailer
+{
+    quint64 indexOffset;
+    quint32 blockCount;
+    quint32 reserved;
+    char    magic[8];
+};
+
+static_assert(sizeof(ExamFileHeader) == 64, "ExamFileHeader layout");
+static_assert(sizeof(ExamFileBlockHeader) == 64, "ExamFileBlockHeader layout");
+static_assert(sizeof(ExamFileIndexEntry) == 24, "ExamFileIndexEntry layout");
+static_assert(sizeof(ExamFileTrailer) == 24, "ExamFileTrailer layout");
+
+// Sequential writer: blocks are appended one at a time, nothing else is kept
+// in memory but the index
+class ExamFileWriter
+{
+public:
+    bool open(const QString &path, const QJsonObject &metadata, quint32 sampleRate, quint32 channelMask);
+    bool writeBlock(const ExamSamples &samples);
+    bool close();
+    void abort();
+
+    QString errorString() const { return file.errorString(); }
+
+private:
+    bool alignTo(qint64 boundary);
+
+    QFile file;
+    ExamFileHeader header = {};
+    QVector<ExamFileIndexEntry> index;
+};
+
+// Maps the file and gives direct pointers to the column blocks
+class ExamFileReader
+{
+public:
+    struct Block
+    {
+        int count = 0;
+        quint32 tStart = 0;
+        quint32 tEnd = 0;
+        const quint32 *timestamps = nullptr;
+        const quint8 *pads = nullptr;
+        const qint16 *channel[EXAM_CHANNELS] = {};
+    };
+
+    ~ExamFileReader();
+
+    bool open(const QString &path);
+    void close();
+
+    const ExamFileHeader &header() const { return *hdr; }
+    QJsonObject metadata() const;
+    int blockCount() const { return hdr ? int(hdr->blockCount) : 0; }
+    Block block(int i) const;
+    ExamSamples samples(int i) const;
+
+    // First block whose time span ends at or after t
+    int findBlock(quint32 t) const;
+
+private:
+    QFile file;
+    const uchar *map = nullptr;
+    qint64 mapSize = 0;
+    const ExamFileHeader *hdr = nullptr;
+    const ExamFileIndexEntry *index = nullptr;
+};
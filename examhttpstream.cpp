@@ -0,0 +1,330 @@
+#include "examhttpstream.h"
+#include "settings.h"
+#include <QHttpServerRequest>
+#include <QAbstractHttpServer>
+#include <QTcpServer>
+#include <QHttpHeaders>
+#include <QUrlQuery>
+#include <QtEndian>
+#include <limits>
+
+ExamHttpStream::ExamHttpStream(MariaDBInterface *dbIf, int exam, QHttpServerResponder &&r)
+    : QObject(nullptr),
+      db(dbIf),
+      examID(exam),
+      responder(std::move(r))
+{
+}
+
+// The responder does not expose its connection: it is the socket of one of the
+// server listeners with the peer of the request
+static QAbstractSocket *findConnection(QAbstractHttpServer *server, const QHttpServerRequest &request)
+{
+    if (!server)
+    {
+        return nullptr;
+    }
+    QList<QObject *> roots = { server };
+    const QList<QTcpServer *> listeners = server->servers();
+    for (QTcpServer *listener : listeners)
+    {
+        roots << listener;
+    }
+    for (QObject *root : roots)
+    {
+        const QList<QAbstractSocket *> sockets = root->findChildren<QAbstractSocket *>();
+        for (QAbstractSocket *s : sockets)
+        {
+            if (s->peerPort() == request.remotePort() && s->peerAddress() == request.remoteAddress()
+                && s->localPort() == request.localPort())
+            {
+                return s;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void ExamHttpStream::start(MariaDBInterface *db, int examID, const QHttpServerRequest &request,
+                           QHttpServerResponder &&responder, QAbstractHttpServer *server)
+{
+    if (!db)
+    {
+        responder.write(QHttpServerResponder::StatusCode::ServiceUnavailable);
+        return;
+    }
+
+    ExamHttpStream *stream = new ExamHttpStream(db, examID, std::move(responder));
+
+    stream->socket = findConnection(server, request);
+    if (stream->socket)
+    {
+        connect(stream->socket, &QIODevice::bytesWritten, stream, &ExamHttpStream::onBytesWritten);
+        connect(stream->socket, &QAbstractSocket::disconnected, stream, &ExamHttpStream::onDisconnected);
+        connect(stream->socket, &QObject::destroyed, stream, &ExamHttpStream::onDisconnected);
+    }
+    else
+    {
+        MYWARNING << "Exam" << examID << "stream: connection not found, the response is not throttled";
+    }
+
+    const QUrlQuery query = request.query();
+    if (query.hasQueryItem("from") || query.hasQueryItem("to"))
+    {
+        bool okFrom = true, okTo = true;
+        stream->timeRange = true;
+        stream->fromMs = query.hasQueryItem("from") ? query.queryItemValue("from").toUInt(&okFrom) : 0;
+        stream->toMs = query.hasQueryItem("to") ? query.queryItemValue("to").toUInt(&okTo)
+                                                : std::numeric_limits<quint32>::max();
+        if (!okFrom || !okTo || stream->fromMs > stream->toMs)
+        {
+            stream->fail(QHttpServerResponder::StatusCode::BadRequest);
+            return;
+        }
+    }
+    else
+    {
+        stream->rangeHeader = request.headers().value(QHttpHeaders::WellKnownHeader::Range).toByteArray().trimmed();
+    }
+
+    // the chunk list comes from the database thread, the rest goes on in this one
+    stream->reading = true;
+    QMetaObject::invokeMethod(db, [db, examID, stream]() {
+        const QVector<ExamChunkInfo> chunks = db->examChunks(examID);
+        QMetaObject::invokeMethod(stream, [stream, chunks]() {
+            stream->onChunks(chunks);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+// "bytes=a-b", "bytes=a-" or "bytes=-n" on a body of 'total' bytes, inclusive bounds
+static bool parseRange(const QByteArray &header, qint64 total, qint64 &first, qint64 &last)
+{
+    if (!header.startsWith("bytes=") || header.contains(','))
+    {
+        return false;
+    }
+    const QByteArray spec = header.mid(6).trimmed();
+    const int dash = spec.indexOf('-');
+    if (dash < 0)
+    {
+        return false;
+    }
+
+    bool ok = true;
+    const QByteArray a = spec.left(dash).trimmed();
+    const QByteArray b = spec.mid(dash + 1).trimmed();
+    if (a.isEmpty())
+    {
+        const qint64 suffix = b.toLongLong(&ok);
+        if (!ok || suffix <= 0)
+        {
+            return false;
+        }
+        first = qMax<qint64>(0, total - suffix);
+        last = total - 1;
+    }
+    else
+    {
+        first = a.toLongLong(&ok);
+        if (!ok)
+        {
+            return false;
+        }
+        last = total - 1;
+        if (!b.isEmpty())
+        {
+            last = qMin(b.toLongLong(&ok), total - 1);
+            if (!ok)
+            {
+                return false;
+            }
+        }
+    }
+    return first <= last;
+}
+
+void ExamHttpStream::onChunks(const QVector<ExamChunkInfo> &chunks)
+{
+    reading = false;
+    if (disconnected)
+    {
+        deleteLater();
+        return;
+    }
+
+    if (chunks.isEmpty())
+    {
+        fail(QHttpServerResponder::StatusCode::NotFound);
+        return;
+    }
+
+    qint64 totalBytes = 0;
+    for (const ExamChunkInfo &c : chunks)
+    {
+        totalBytes += qint64(c.sampleCount) * EXAM_SAMPLE_BYTES;
+    }
+
+    QHttpHeaders headers;
+    headers.append(QHttpHeaders::WellKnownHeader::ContentType, "application/octet-stream");
+    headers.append(QHttpHeaders::WellKnownHeader::AcceptRanges, "bytes");
+    headers.append("X-Sample-Bytes", QByteArray::number(EXAM_SAMPLE_BYTES));
+    QHttpServerResponder::StatusCode status = QHttpServerResponder::StatusCode::Ok;
+
+    if (timeRange)
+    {
+        // whole chunks overlapping the range, samples are filtered when they arrive
+        for (const ExamChunkInfo &c : chunks)
+        {
+            if (c.tEnd >= fromMs && c.tStart <= toMs)
+            {
+                pieces.append({ c.seq, 0, c.sampleCount * EXAM_SAMPLE_BYTES });
+            }
+        }
+    }
+    else
+    {
+        qint64 first = 0;
+        qint64 last = totalBytes - 1;
+        if (!rangeHeader.isEmpty())
+        {
+            if (!parseRange(rangeHeader, totalBytes, first, last))
+            {
+                fail(QHttpServerResponder::StatusCode::RequestRangeNotSatisfiable,
+                     "bytes */" + QByteArray::number(totalBytes));
+                return;
+            }
+            status = QHttpServerResponder::StatusCode::PartialContent;
+            headers.append(QHttpHeaders::WellKnownHeader::ContentRange,
+                           "bytes " + QByteArray::number(first) + '-' + QByteArray::number(last)
+                           + '/' + QByteArray::number(totalBytes));
+        }
+
+        qint64 chunkStart = 0;
+        for (const ExamChunkInfo &c : chunks)
+        {
+            const qint64 chunkEnd = chunkStart + qint64(c.sampleCount) * EXAM_SAMPLE_BYTES;
+            const qint64 from = qMax(first, chunkStart);
+            const qint64 to = qMin(last + 1, chunkEnd);
+            if (from < to)
+            {
+                pieces.append({ c.seq, int(from - chunkStart), int(to - from) });
+            }
+            chunkStart = chunkEnd;
+        }
+    }
+
+    MYDEBUG << "Streaming exam" << examID << ":" << pieces.size() << "chunks";
+    responder.writeBeginChunked(headers, status);
+    requestNext();
+}
+
+void ExamHttpStream::requestNext()
+{
+    if (disconnected)
+    {
+        deleteLater();
+        return;
+    }
+    if (socket && socket->bytesToWrite() >= MAX_PENDING_BYTES)
+    {
+        waitingForClient = true;        // onBytesWritten() goes on
+        return;
+    }
+
+    if (next >= pieces.size())
+    {
+        responder.writeEndChunked(QByteArray());
+        deleteLater();
+        return;
+    }
+
+    MariaDBInterface *dbIf = db;
+    const int exam = examID;
+    const int seq = pieces.at(next).seq;
+    reading = true;
+    QMetaObject::invokeMethod(dbIf, [dbIf, exam, seq, this]() {
+        const QByteArray data = dbIf->readChunkData(exam, seq);
+        QMetaObject::invokeMethod(this, [this, data]() {
+            onData(data);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+void ExamHttpStream::onData(const QByteArray &data)
+{
+    reading = false;
+    if (disconnected)
+    {
+        deleteLater();
+        return;
+    }
+
+    const Piece piece = pieces.at(next++);
+
+    QByteArray out;
+    if (timeRange)
+    {
+        out.reserve(data.size());
+        for (int offset = 0; offset + EXAM_SAMPLE_BYTES <= data.size(); offset += EXAM_SAMPLE_BYTES)
+        {
+            const quint32 t = qFromLittleEndian<quint32>(data.constData() + offset);
+            if (t >= fromMs && t <= toMs)
+            {
+                out.append(data.constData() + offset, EXAM_SAMPLE_BYTES);
+            }
+        }
+    }
+    else
+    {
+        // the declared length is kept even if the stored chunk is short, so the
+        // byte offsets of the following pieces stay right
+        out = data.mid(piece.offset, piece.length);
+        if (out.size() < piece.length)
+        {
+            MYWARNING << "Chunk" << piece.seq << "of exam" << examID << "shorter than its sample count";
+            out.append(piece.length - out.size(), '\0');
+        }
+    }
+
+    if (!out.isEmpty())
+    {
+        responder.writeChunk(out);
+    }
+    requestNext();
+}
+
+void ExamHttpStream::onBytesWritten()
+{
+    if (waitingForClient && socket && socket->bytesToWrite() < MAX_PENDING_BYTES)
+    {
+        waitingForClient = false;
+        requestNext();
+    }
+}
+
+void ExamHttpStream::onDisconnected()
+{
+    if (disconnected)
+    {
+        return;
+    }
+    disconnected = true;
+    MYDEBUG << "Exam" << examID << "stream: client gone after" << next << "of" << pieces.size() << "chunks";
+    // a queued read still refers to this object, onData() deletes it
+    if (!reading)
+    {
+        deleteLater();
+    }
+}
+
+void ExamHttpStream::fail(QHttpServerResponder::StatusCode status, const QByteArray &contentRange)
+{
+    QHttpHeaders headers;
+    if (!contentRange.isEmpty())
+    {
+        headers.append(QHttpHeaders::WellKnownHeader::ContentRange, contentRange);
+    }
+    responder.write(headers, status);
+    deleteLater();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+#include <QAbstractSocket>
+#include <QHttpServerResponder>
+#include "MariaDBInterface.h"
+
+class QHttpServerRequest;
+class QAbstractHttpServer;
+
+// GET /exams/<id>/frames: the exam samples in the storage encoding (examdata.h,
+// EXAM_SAMPLE_BYTES each, timestamp order) with chunked transfer encoding.
+//
+//   ?from=<ms>&to=<ms>     only the samples in the time range
+//   Range: bytes=a-b       206 with that slice of the whole exam (single range,
+//                          ignored together with from/to)
+//
+// The body is produced one storage chunk at a time. QHttpServerResponder only
+// appends to the socket write buffer, so the next chunk is read from the
+// database thread only once the connection has less than MAX_PENDING_BYTES
+// still to send: a slow client never gets the whole exam buffered in memory,
+// and one that disconnects stops the reads (if the connection cannot be found
+// the reads are not throttled, with a warning). The object deletes itself when done.
+class ExamHttpStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const qint64 MAX_PENDING_BYTES = 64 * 1024;    // about two storage chunks
+
+    // 'server' is the one that received the request: its connection is looked up
+    // to follow how much of the response is still unsent
+    static void start(MariaDBInterface *db, int examID, const QHttpServerRequest &request,
+                      QHttpServerResponder &&responder, QAbstractHttpServer *server);
+
+private:
+    // one piece of the body: bytes [offset, offset + length) of chunk 'seq'
+    struct Piece
+    {
+        int seq = 0;
+        int offset = 0;
+        int length = 0;
+    };
+
+    ExamHttpStream(MariaDBInterface *db, int examID, QHttpServerResponder &&responder);
+
+    void onChunks(const QVector<ExamChunkInfo> &chunks);
+    void requestNext();
+    void onData(const QByteArray &data);
+    void onBytesWritten();
+    void onDisconnected();
+    void fail(QHttpServerResponder::StatusCode status, const QByteArray &contentRange = QByteArray());
+
+    MariaDBInterface *db;
+    int examID;
+    QHttpServerResponder responder;
+
+    bool timeRange = false;
+    quint32 fromMs = 0;
+    quint32 toMs = 0;
+    QByteArray rangeHeader;
+
+    QVector<Piece> pieces;
+    int next = 0;
+
+    QPointer<QAbstractSocket> socket;   // null if the connection could not be found
+    bool reading = false;               // a chunk read is queued in the database thread
+    bool waitingForClient = false;
+    bool disconnected = false;
+};
@@ -0,0 +1,129 @@
+#include "examindex.h"
+#include "settings.h"
+#include <QtEndian>
+#include <limits>
+
+ExamIndexBuilder::ExamIndexBuilder()
+    : t0(0), sampleCount(0)
+{
+}
+
+void ExamIndexBuilder::addSample(const ExamSample &sample)
+{
+    if (sampleCount == 0)
+    {
+        t0 = sample.timestamp;
+    }
+
+    // Chunk
+    if (current.count == 0)
+    {
+        current.firstSample = sampleCount;
+        current.tStart = sample.timestamp;
+        current.data.reserve(CHUNK_SAMPLES * EXAM_SAMPLE_BYTES);
+    }
+    appendSample(current.data, sample);
+    current.tEnd = sample.timestamp;
+    ++current.count;
+    ++sampleCount;
+
+    if (current.count == CHUNK_SAMPLES)
+    {
+        closeChunk();
+    }
+
+    // Pyramid level 0
+    if (sample.timestamp < t0)
+    {
+        return;     // timestamps are expected non decreasing
+    }
+
+    const quint32 bucket = (sample.timestamp - t0) / PYRAMID_BASE_MS;
+    if (bucket >= quint32(PYRAMID_MAX_BUCKETS))
+    {
+        return;
+    }
+
+    QVector<qint16> &padLevel0 = level0[sample.padAddress];
+    const int needed = int(bucket + 1) * EXAM_CHANNELS * 2;
+    if (padLevel0.size() < needed)
+    {
+        int from = padLevel0.size();
+        padLevel0.resize(needed);
+        for (int i = from; i < needed; i += 2)
+        {
+            padLevel0[i] = std::numeric_limits<qint16>::max();
+            padLevel0[i + 1] = std::numeric_limits<qint16>::min();
+        }
+    }
+
+    qint16 *b = padLevel0.data() + bucket * EXAM_CHANNELS * 2;
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        const qint16 v = sample.channel[c];
+        if (v < b[2 * c]) b[2 * c] = v;
+        if (v > b[2 * c + 1]) b[2 * c + 1] = v;
+    }
+}
+
+void ExamIndexBuilder::closeChunk()
+{
+    ready.enqueue(current);
+    const int seq = current.seq + 1;
+    current = Chunk();
+    current.seq = seq;
+}
+
+void ExamIndexBuilder::finish()
+{
+    if (current.count > 0)
+    {
+        closeChunk();
+    }
+
+    pyramid.clear();
+    for (auto it = level0.cbegin(); it != level0.cend(); ++it)
+    {
+        pyramid.insert(it.key(), buildPyramid(it.value()));
+    }
+
+    MYDEBUG << "Exam index:" << sampleCount << "samples," << current.seq << "chunks,"
+            << pyramid.size() << "pad pyramids";
+}
+
+QVector<QByteArray> ExamIndexBuilder::buildPyramid(QVector<qint16> level)
+{
+    QVector<QByteArray> levels;
+    int buckets = level.size() / (EXAM_CHANNELS * 2);
+
+    while (buckets > 0)
+    {
+        QByteArray bytes(level.size() * 2, Qt::Uninitialized);
+        qToLittleEndian<qint16>(level.constData(), level.size(), bytes.data());
+        levels.append(bytes);
+
+        if (buckets <= PYRAMID_MIN_BUCKETS)
+        {
+            break;
+        }
+
+        // next level: adjacent buckets merged pairwise
+        const int upper = (buckets + 1) / 2;
+        QVector<qint16> next(upper * EXAM_CHANNELS * 2);
+        for (int i = 0; i < upper; ++i)
+        {
+            const qint16 *a = level.constData() + 2 * i * EXAM_CHANNELS * 2;
+            const bool hasB = 2 * i + 1 < buckets;
+            const qint16 *b = a + EXAM_CHANNELS * 2;
+            qint16 *o = next.data() + i * EXAM_CHANNELS * 2;
+            for (int k = 0; k < EXAM_CHANNELS; ++k)
+            {
+                o[2 * k] = hasB ? qMin(a[2 * k], b[2 * k]) : a[2 * k];
+                o[2 * k + 1] = hasB ? qMax(a[2 * k + 1], b[2 * k + 1]) : a[2 * k + 1];
+            }
+        }
+        level.swap(next);
+        buckets = upper;
+    }
+    return levels;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+#include <QQueue>
+#include <QMap>
+#include "examdata.h"
+
+// Splits the exam being stored into time-ordered chunks and builds the min/max
+// pyramids used for zoomed-out plots, one per pad: an envelope mixing pads
+// would not be the signal of any of them. Chunk rows are the sparse time index:
+// each one carries the time span it covers, so a seek only reads the chunks it needs.
+//
+// Pyramid level 0 has one bucket every PYRAMID_BASE_MS starting from the first
+// sample of the exam (the same t0 for every pad), each upper level halves the
+// resolution. A bucket is EXAM_CHANNELS little endian int16 (min, max) pairs;
+// empty buckets have min > max.
+class ExamIndexBuilder
+{
+public:
+    static const int CHUNK_SAMPLES = 2048;
+    static const int PYRAMID_BASE_MS = 10;
+    static const int PYRAMID_MIN_BUCKETS = 64;          // top level size
+    static const int PYRAMID_MAX_BUCKETS = 1 << 20;     // about 3 hours at level 0
+    static const int PYRAMID_BUCKET_BYTES = EXAM_CHANNELS * 2 * 2;
+    static const quint8 ALL_PADS = 255;                 // stored pad of the pyramids of older exams, all pads merged
+
+    struct Chunk
+    {
+        int seq = 0;
+        quint32 firstSample = 0;    // index of the first sample in the exam
+        quint32 tStart = 0;
+        quint32 tEnd = 0;
+        int count = 0;
+        QByteArray data;            // appendSample() encoding
+    };
+
+    ExamIndexBuilder();
+
+    void addSample(const ExamSample &sample);
+
+    // Complete chunks are available as soon as they are full
+    bool hasChunk() const { return !ready.isEmpty(); }
+    Chunk takeChunk() { return ready.dequeue(); }
+
+    // Flushes the last partial chunk and computes the upper pyramid levels
+    void finish();
+
+    quint32 startTimestamp() const { return t0; }
+    QList<quint8> pyramidPads() const { return pyramid.keys(); }
+    int pyramidLevels(quint8 pad) const { return pyramid.value(pad).size(); }
+    QByteArray pyramidLevel(quint8 pad, int level) const { return pyramid.value(pad).at(level); }
+    static quint32 bucketMs(int level) { return quint32(PYRAMID_BASE_MS) << level; }
+
+private:
+    void closeChunk();
+    static QVector<QByteArray> buildPyramid(QVector<qint16> level0);
+
+    quint32 t0;
+    quint32 sampleCount;
+    Chunk current;
+    QQueue<Chunk> ready;
+    QMap<quint8, QVector<qint16>> level0;           // by pad: min, max per channel per bucket
+    QMap<quint8, QVector<QByteArray>> pyramid;      // by pad
+};
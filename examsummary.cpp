@@ -0,0 +1,177 @@
+#include "examsummary.h"
+#include <QStringList>
+#include <QtEndian>
+
+ExamSummary::ExamSummary()
+{
+    reset();
+}
+
+void ExamSummary::reset()
+{
+    count = 0;
+    firstTimestamp = 0;
+    lastTimestamp = 0;
+    pads.reset();
+    firstPad = 0;
+    multiPad = false;
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        minValue[c] = 0;
+        maxValue[c] = 0;
+        sum[c] = 0;
+    }
+    previewUsed = 0;
+    bucketWidth = 1;
+    bucketFill = 0;
+}
+
+void ExamSummary::addSample(const ExamSample &sample)
+{
+    if (count == 0)
+    {
+        firstTimestamp = sample.timestamp;
+        firstPad = sample.padAddress;
+        for (int c = 0; c < EXAM_CHANNELS; ++c)
+        {
+            minValue[c] = sample.channel[c];
+            maxValue[c] = sample.channel[c];
+        }
+    }
+
+    lastTimestamp = sample.timestamp;
+    pads.set(sample.padAddress);
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        const qint16 v = sample.channel[c];
+        if (v < minValue[c]) minValue[c] = v;
+        if (v > maxValue[c]) maxValue[c] = v;
+        sum[c] += v;
+    }
+    ++count;
+
+    // Preview, single pad exams only
+    if (sample.padAddress != firstPad)
+    {
+        multiPad = true;
+    }
+    if (multiPad)
+    {
+        return;
+    }
+    const qint16 fz = sample.channel[CH_FZ];
+    if (bucketFill == 0)
+    {
+        if (previewUsed == PREVIEW_POINTS)
+        {
+            foldPreview();
+        }
+        previewMin[previewUsed] = fz;
+        previewMax[previewUsed] = fz;
+        ++previewUsed;
+    }
+    else
+    {
+        qint16 &lo = previewMin[previewUsed - 1];
+        qint16 &hi = previewMax[previewUsed - 1];
+        if (fz < lo) lo = fz;
+        if (fz > hi) hi = fz;
+    }
+
+    if (++bucketFill == bucketWidth)
+    {
+        bucketFill = 0;
+    }
+}
+
+void ExamSummary::addSamples(const ExamSamples &samples)
+{
+    for (const ExamSample &s : samples)
+    {
+        addSample(s);
+    }
+}
+
+void ExamSummary::foldPreview()
+{
+    // merge adjacent buckets pairwise, the width doubles
+    for (int i = 0; i < PREVIEW_POINTS / 2; ++i)
+    {
+        previewMin[i] = qMin(previewMin[2 * i], previewMin[2 * i + 1]);
+        previewMax[i] = qMax(previewMax[2 * i], previewMax[2 * i + 1]);
+    }
+    previewUsed = PREVIEW_POINTS / 2;
+    bucketWidth *= 2;
+}
+
+QByteArray ExamSummary::preview() const
+{
+    if (multiPad)
+    {
+        return QByteArray();
+    }
+    QByteArray out(previewUsed * 4, Qt::Uninitialized);
+    char *p = out.data();
+    for (int i = 0; i < previewUsed; ++i)
+    {
+        qToLittleEndian<qint16>(previewMin[i], p);
+        qToLittleEndian<qint16>(previewMax[i], p + 2);
+        p += 4;
+    }
+    return out;
+}
+
+QVariantMap ExamSummary::toVariantMap() const
+{
+    QVariantMap map;
+    map["frame_count"] = count;
+    map["duration_ms"] = durationMs();
+    map["peak_fz"] = peakFz();
+    QVariantList padList;
+    for (size_t pad = 0; pad < pads.size(); ++pad)
+    {
+        if (pads.test(pad))
+        {
+            padList << int(pad);
+        }
+    }
+    map["pads"] = padList;
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        const QString name = QString::fromLatin1(examChannelNames[c]);
+        map[name + "_min"] = minValue[c];
+        map[name + "_max"] = maxValue[c];
+        map[name + "_mean"] = channelMean(c);
+    }
+    map["preview"] = QString::fromLatin1(preview().toBase64());
+    return map;
+}
+
+QString ExamSummary::padsToText(const PadSet &pads)
+{
+    QStringList list;
+    for (size_t pad = 0; pad < pads.size(); ++pad)
+    {
+        if (pads.test(pad))
+        {
+            list << QString::number(pad);
+        }
+    }
+    return list.join(',');
+}
+
+PadSet ExamSummary::padsFromText(const QString &text)
+{
+    PadSet pads;
+    const QStringList items = text.split(',', Qt::SkipEmptyParts);
+    for (const QString &item : items)
+    {
+        bool ok = false;
+        const uint pad = item.trimmed().toUInt(&ok);
+        if (ok && pad < pads.size())
+        {
+            pads.set(pad);
+        }
+    }
+    return pads;
+}
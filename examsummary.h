@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVariantMap>
+#include <QString>
+#include "examdata.h"
+
+// Exam summary accumulated sample by sample while acquiring, so that saving an
+// exam also stores everything the GUI needs to list it without decoding frames.
+// Minimum, maximum, mean and peak Fz are over all the pads of the exam together.
+class ExamSummary
+{
+public:
+    static const int PREVIEW_POINTS = 256;     // Fz min/max envelope buckets
+
+    ExamSummary();
+
+    void reset();
+    void addSample(const ExamSample &sample);
+    void addSamples(const ExamSamples &samples);
+
+    quint32 frameCount() const { return count; }
+    quint32 durationMs() const { return count ? lastTimestamp - firstTimestamp : 0; }
+    qint16 channelMin(int ch) const { return minValue[ch]; }
+    qint16 channelMax(int ch) const { return maxValue[ch]; }
+    double channelMean(int ch) const { return count ? double(sum[ch]) / count : 0.0; }
+    qint16 peakFz() const { return maxValue[CH_FZ]; }
+    // global pads that sent frames
+    const PadSet &padSet() const { return pads; }
+
+    // "1,2,17": how the pad set is stored (t_exam_summaries.pads)
+    static QString padsToText(const PadSet &pads);
+    static PadSet padsFromText(const QString &text);
+
+    // PREVIEW_POINTS (or less) pairs of little endian int16 (min, max) of Fz.
+    // Only for single pad exams, empty otherwise: an envelope mixing pads is not
+    // the signal of any of them (the per pad ones are in the exam pyramid).
+    QByteArray preview() const;
+    bool isMultiPad() const { return multiPad; }
+
+    QVariantMap toVariantMap() const;
+
+private:
+    void foldPreview();
+
+    quint32 count;
+    quint32 firstTimestamp;
+    quint32 lastTimestamp;
+    PadSet pads;
+    quint8 firstPad;
+    bool multiPad;
+    qint16 minValue[EXAM_CHANNELS];
+    qint16 maxValue[EXAM_CHANNELS];
+    qint64 sum[EXAM_CHANNELS];
+
+    // The preview bucket width doubles every time the buckets are full,
+    // so the preview covers the whole exam whatever its length
+    qint16 previewMin[PREVIEW_POINTS];
+    qint16 previewMax[PREVIEW_POINTS];
+    int previewUsed;
+    quint32 bucketWidth;
+    quint32 bucketFill;
+};
@@ -0,0 +1,156 @@
+#include "framedecoder.h"
+#include "humlog.h"
+#include "metrics.h"
+#include "trace.h"
+#include <QtEndian>
+#include <cstring>
+
+static const uint8_t RSP_MARKER_HI = RSP_HEADER_MARKER >> 8;
+static const uint8_t RSP_MARKER_LO = RSP_HEADER_MARKER & 0xFF;
+static const uint8_t ACK_CODE = 0x06;     // T_AckResponse::ackCode
+static const uint8_t NAK_CODE = 0x15;     // T_NackResponse::nakCode
+
+ExamSample sampleFromFrame(const uint8_t *raw)
+{
+    ExamSample s;
+    s.padAddress = raw[offsetof(T_Frame, padAddress)];
+    s.timestamp = qFromLittleEndian<quint32>(raw + offsetof(T_Frame, timestamp));
+    const uint8_t *ch = raw + offsetof(T_Frame, forceX);
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        s.channel[c] = qFromLittleEndian<qint16>(ch + 2 * c);
+    }
+    return s;
+}
+
+// header marker, CRC (little endian, over the bytes between marker and CRC) and EOT
+static bool validMessage(const uint8_t *raw, int length)
+{
+    if (raw[length - 2] != PROTOCOL_EOT || raw[length - 1] != PROTOCOL_EOT)
+    {
+        return false;
+    }
+    const uint16_t received = static_cast<uint16_t>(raw[length - 4] | (raw[length - 3] << 8));
+    return received == crc16(raw + 2, static_cast<size_t>(length - 6));
+}
+
+void FrameDecoder::feed(const char *data, int length, ExamSamples &out)
+{
+    HUM_TRACE("decode", "feed");
+    buffer.append(data, length);
+
+    const uint8_t *raw = reinterpret_cast<const uint8_t *>(buffer.constData());
+    const int size = buffer.size();
+    int pos = 0;
+
+    while (size - pos >= 4)
+    {
+        if (raw[pos] != RSP_MARKER_HI || raw[pos + 1] != RSP_MARKER_LO)
+        {
+            // look for the next marker
+            const void *next = memchr(raw + pos + 1, RSP_MARKER_HI, static_cast<size_t>(size - pos - 1));
+            pos = next ? int(static_cast<const uint8_t *>(next) - raw) : size;
+            ++resyncs;
+            metrics().resyncs.add();
+            continue;
+        }
+
+        const uint8_t command = raw[pos + 3];
+
+        // the reply to CMD_START_STREAM echoes the command code: told apart from a
+        // frame by its length and shape, and skipped without counting it as bad
+        if (command == CMD_START_STREAM && size - pos >= 5 && (raw[pos + 4] == ACK_CODE || raw[pos + 4] == NAK_CODE))
+        {
+            const int replyLength = raw[pos + 4] == ACK_CODE ? int(sizeof(T_AckResponse)) : int(sizeof(T_NackResponse));
+            if (size - pos < replyLength)
+            {
+                break;      // wait for the rest
+            }
+            if (validMessage(raw + pos, replyLength))
+            {
+                if (raw[pos + 4] == NAK_CODE)
+                {
+                    MYWARNING << "Controller refused to stream, error" << (raw[pos + 5] | (raw[pos + 6] << 8));
+                }
+                pos += replyLength;
+                continue;
+            }
+        }
+
+        int messageLength;
+        if (command == CMD_START_STREAM || command == CMD_GET_FRAME)
+        {
+            messageLength = sizeof(T_Frame);
+        }
+        else if (command == 0)
+        {
+            messageLength = sizeof(T_NotifyMessage);
+        }
+        else
+        {
+            // command responses are read synchronously, not while streaming
+            pos += 1;
+            ++resyncs;
+            metrics().resyncs.add();
+            continue;
+        }
+
+        if (size - pos < messageLength)
+        {
+            break;      // wait for the rest
+        }
+
+        if (!validMessage(raw + pos, messageLength))
+        {
+            ++crcErrors;
+            metrics().crcErrors.add();
+            if (command != 0)
+            {
+                const uint8_t pad = raw[pos + 2];
+                if (pad >= 1 && pad <= PADS_PER_CONTROLLER)
+                {
+                    metrics().framesDropped[globalPad(controller, pad)].add();
+                }
+            }
+            pos += 1;
+            continue;
+        }
+
+        if (command == 0)
+        {
+            ++notifies;
+            metrics().notifies.add();
+        }
+        else
+        {
+            ExamSample s = sampleFromFrame(raw + pos);
+            if (s.padAddress < 1 || s.padAddress > PADS_PER_CONTROLLER)
+            {
+                // would be renumbered as a pad of the next controller
+                ++badPads;
+                metrics().badPadFrames.add();
+                pos += messageLength;
+                continue;
+            }
+            if (controller > 0)
+            {
+                s.padAddress = globalPad(controller, s.padAddress);
+                s.controller = quint8(controller);
+            }
+            out.append(s);
+            ++frames;
+            if (s.padAddress >= 1 && s.padAddress <= ServerMetrics::MAX_PAD)
+            {
+                metrics().framesReceived[s.padAddress].add();
+            }
+        }
+        pos += messageLength;
+    }
+
+    buffer.remove(0, pos);
+}
+
+void FrameDecoder::reset()
+{
+    buffer.resize(0);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QByteArray>
+#include "examdata.h"
+#include "humatric_protocol.h"
+
+// Incremental decoder of the controller stream: bytes arrive in arbitrary
+// pieces, complete T_Frame are turned into samples. On a bad header, CRC or
+// EOT the decoder drops one byte and looks for the next 0xBEEF marker.
+class FrameDecoder
+{
+public:
+    void feed(const char *data, int length, ExamSamples &out);
+    void reset();
+    // Controller 'index' of a ControllerPool: pads come out as globalPad(index, pad)
+    void setController(int index) { controller = index; }
+    void reserve(int bytes) { buffer.reserve(bytes); }   // kept across feed() and reset()
+
+    quint64 frameCount() const { return frames; }
+    quint64 crcErrorCount() const { return crcErrors; }
+    quint64 resyncCount() const { return resyncs; }
+    quint64 notifyCount() const { return notifies; }
+    quint64 badPadCount() const { return badPads; }     // frames dropped for a pad address outside 1..16
+
+private:
+    QByteArray buffer;
+    int controller = 0;
+    quint64 frames = 0;
+    quint64 crcErrors = 0;
+    quint64 resyncs = 0;
+    quint64 notifies = 0;
+    quint64 badPads = 0;
+};
+
+// Frame fields after the header are little endian, as sent by the pads
+ExamSample sampleFromFrame(const uint8_t *raw);
@@ -0,0 +1,446 @@
+#include "framestreamserver.h"
+#include "settings.h"
+#include "metrics.h"
+#include "trace.h"
+#include <QWebSocketServer>
+#include <QWebSocket>
+#include <QtEndian>
+#include <QRandomGenerator>
+#include <QtAlgorithms>
+#include <cstring>
+#include <limits>
+
+static const float FILTER_ALPHA = 0.125f;     // exponential moving average, per pad and channel
+
+bool StreamSubscription::fromVariant(const QVariantMap &map, StreamSubscription &out)
+{
+    StreamSubscription sub;
+
+    const QVariantList pads = map.value("pads").toList();
+    if (!pads.isEmpty())
+    {
+        sub.pads.reset();
+        for (const QVariant &p : pads)
+        {
+            bool ok = false;
+            const int pad = p.toInt(&ok);
+            if (!ok || pad < 0 || pad >= int(sub.pads.size()))
+            {
+                MYWARNING << "Invalid pad in subscription:" << p;
+                return false;
+            }
+            sub.pads.set(size_t(pad));
+        }
+    }
+
+    quint32 channels = (1u << EXAM_CHANNELS) - 1;
+    const QStringList channelNames = map.value("channels").toStringList();
+    if (!channelNames.isEmpty())
+    {
+        channels = 0;
+        for (const QString &name : channelNames)
+        {
+            int c = 0;
+            while (c < EXAM_CHANNELS && name != QLatin1String(examChannelNames[c]))
+            {
+                ++c;
+            }
+            if (c == EXAM_CHANNELS)
+            {
+                MYWARNING << "Invalid channel in subscription:" << name;
+                return false;
+            }
+            channels |= 1u << c;
+        }
+    }
+
+    QStringList streams = map.value("streams").toStringList();
+    if (streams.isEmpty())
+    {
+        streams << "raw";
+    }
+    sub.columns = 0;
+    for (const QString &stream : streams)
+    {
+        if (stream == "raw")
+        {
+            sub.columns |= channels << COL_RAW;
+        }
+        else if (stream == "filtered")
+        {
+            sub.columns |= channels << COL_FILTERED;
+        }
+        else if (stream == "cop")
+        {
+            sub.columns |= (1u << COL_COPX) | (1u << COL_COPY);
+        }
+        else
+        {
+            MYWARNING << "Invalid stream in subscription:" << stream;
+            return false;
+        }
+    }
+
+    out = sub;
+    return true;
+}
+
+QVariantMap StreamSubscription::toVariant() const
+{
+    QVariantList padList;       // empty: all
+    for (size_t pad = 0; pad < pads.size() && !pads.all(); ++pad)
+    {
+        if (pads.test(pad))
+        {
+            padList << int(pad);
+        }
+    }
+
+    QStringList channels;
+    for (int c = 0; c < EXAM_CHANNELS; ++c)
+    {
+        if (columns & ((1u << (COL_RAW + c)) | (1u << (COL_FILTERED + c))))
+        {
+            channels << examChannelNames[c];
+        }
+    }
+
+    QStringList streams;
+    if (columns & (((1u << EXAM_CHANNELS) - 1) << COL_RAW))
+    {
+        streams << "raw";
+    }
+    if (columns & (((1u << EXAM_CHANNELS) - 1) << COL_FILTERED))
+    {
+        streams << "filtered";
+    }
+    if (columns & (1u << COL_COPX))
+    {
+        streams << "cop";
+    }
+
+    return { { "pads", padList }, { "channels", channels }, { "streams", streams } };
+}
+
+FrameStreamServer::FrameStreamServer(QObject *parent)
+    : QObject(parent),
+      server(new QWebSocketServer(QStringLiteral("HumServer data stream"), QWebSocketServer::NonSecureMode, this))
+{
+    connect(server, &QWebSocketServer::newConnection, this, &FrameStreamServer::onNewConnection);
+
+    batchTimer.setInterval(BATCH_MS);
+    batchTimer.setTimerType(Qt::PreciseTimer);
+    connect(&batchTimer, &QTimer::timeout, this, &FrameStreamServer::flush);
+
+    variants << StreamSubscription();       // variant 0: everything, raw
+    variantUsers << 0;
+}
+
+FrameStreamServer::~FrameStreamServer()
+{
+    server->close();
+}
+
+bool FrameStreamServer::listen(quint16 port)
+{
+    if (!server->listen(QHostAddress::Any, port))
+    {
+        MYCRITICAL << "Failed to start data stream server on port" << port << ":" << server->errorString();
+        return false;
+    }
+
+    MYDEBUG << "Data stream server listening on ws://<host>:" << port;
+    return true;
+}
+
+void FrameStreamServer::onNewConnection()
+{
+    while (QWebSocket *socket = server->nextPendingConnection())
+    {
+        quint32 random[4];
+        QRandomGenerator::system()->fillRange(random);
+        const QString clientID = QString::fromLatin1(QByteArray(reinterpret_cast<const char *>(random), sizeof(random)).toHex());
+        MYDEBUG << "New data stream client" << socket->peerAddress().toString();
+        broadcaster.subscribe(socket);
+        clients.insert(clientID, socket);
+        clientVariant.insert(socket, 0);
+        metrics().streamClients.set(broadcaster.subscriberCount());
+
+        // the only text message on this socket
+        socket->sendTextMessage(QStringLiteral("{\"client\":\"%1\"}").arg(clientID));
+
+        connect(socket, &QWebSocket::disconnected, this, [this, socket, clientID]() {
+            broadcaster.unsubscribe(socket);
+            clients.remove(clientID);
+            releaseVariant(clientVariant.take(socket));
+            socket->deleteLater();
+            metrics().streamClients.set(broadcaster.subscriberCount());
+            if (broadcaster.subscriberCount() == 0)
+            {
+                batchTimer.stop();
+                pending.clear();
+                metrics().streamPendingSamples.set(0);
+            }
+        });
+
+        if (!batchTimer.isActive())
+        {
+            batchTimer.start();
+        }
+    }
+}
+
+bool FrameStreamServer::setSubscription(const QString &clientID, const StreamSubscription &subscription)
+{
+    QWebSocket *socket = clients.value(clientID);
+    if (!socket)
+    {
+        MYWARNING << "Unknown data stream client";
+        return false;
+    }
+
+    const int variant = acquireVariant(subscription);
+    releaseVariant(clientVariant.value(socket));
+    clientVariant.insert(socket, variant);
+    broadcaster.setVariant(socket, variant);
+
+    MYDEBUG << "Data stream client" << socket->peerAddress().toString() << "subscribed to" << subscription.toVariant();
+    return true;
+}
+
+// Clients with the same subscription share the variant, and so the encoded batch
+int FrameStreamServer::acquireVariant(const StreamSubscription &subscription)
+{
+    if (subscription == variants.at(0))
+    {
+        return 0;
+    }
+    int unused = -1;
+    for (int i = 1; i < variants.size(); ++i)
+    {
+        if (variantUsers.at(i) > 0 && variants.at(i) == subscription)
+        {
+            ++variantUsers[i];
+            return i;
+        }
+        if (variantUsers.at(i) == 0 && unused < 0)
+        {
+            unused = i;
+        }
+    }
+    if (unused < 0)
+    {
+        unused = variants.size();
+        variants << subscription;
+        variantUsers << 0;
+    }
+    variants[unused] = subscription;
+    variantUsers[unused] = 1;
+    return unused;
+}
+
+void FrameStreamServer::releaseVariant(int variant)
+{
+    if (variant > 0 && variant < variantUsers.size() && variantUsers.at(variant) > 0)
+    {
+        --variantUsers[variant];
+    }
+}
+
+bool FrameStreamServer::subscription(const QString &clientID, StreamSubscription &out) const
+{
+    QWebSocket *socket = clients.value(clientID);
+    if (!socket)
+    {
+        return false;
+    }
+    out = variants.at(clientVariant.value(socket));
+    return true;
+}
+
+void FrameStreamServer::addSamples(const ExamSamples &samples)
+{
+    if (broadcaster.subscriberCount() == 0)
+    {
+        return;
+    }
+    if (pending.isEmpty())
+    {
+        batchAge.start();
+    }
+    pending.append(samples);
+    metrics().streamPendingSamples.set(pending.size());
+}
+
+void FrameStreamServer::flush()
+{
+    if (pending.isEmpty())
+    {
+        return;
+    }
+
+    HUM_TRACE("process", "stream.flush");
+    metrics().batchWaitLatency.recordSince(batchAge);
+    QElapsedTimer timer;
+    timer.start();
+
+    const ExamSamples batch = pending;
+    const quint32 seq = sequence++;
+    pending.clear();
+
+    // the filter runs on every sample, before decimation, and only while someone wants it
+    FilteredSamples filtered;
+    bool wantsFiltered = false;
+    for (int variant : std::as_const(clientVariant))
+    {
+        wantsFiltered |= (variants.at(variant).columns & (((1u << EXAM_CHANNELS) - 1) << StreamSubscription::COL_FILTERED)) != 0;
+    }
+    if (wantsFiltered)
+    {
+        filter.run(batch, filtered);
+    }
+    else
+    {
+        filter.reset();     // restart from the next sample
+    }
+
+    padIndex.resize(batch.size());
+    for (int i = 0; i < batch.size(); ++i)
+    {
+        padIndex[i] = padSamples[batch.at(i).padAddress]++;
+    }
+
+    broadcaster.broadcast([this, &batch, &filtered, wantsFiltered, seq](int variant, int decimation) {
+        return encodeBatch(batch, seq, decimation, variants.at(variant), wantsFiltered ? &filtered : nullptr,
+                           padIndex.constData());
+    });
+
+    metrics().fanOutLatency.recordSince(timer);
+    metrics().streamPendingSamples.set(0);
+    metrics().streamQueuedBytes.set(broadcaster.bytesQueued());
+}
+
+void StreamFilter::run(const ExamSamples &batch, FilteredSamples &out)
+{
+    HUM_TRACE("process", "stream.filter");
+    out.resize(batch.size());
+    for (int i = 0; i < batch.size(); ++i)
+    {
+        const ExamSample &s = batch.at(i);
+        float *padState = state[s.padAddress];
+        if (!primed[s.padAddress])
+        {
+            for (int c = 0; c < EXAM_CHANNELS; ++c)
+            {
+                padState[c] = s.channel[c];
+            }
+            primed[s.padAddress] = true;
+        }
+        for (int c = 0; c < EXAM_CHANNELS; ++c)
+        {
+            padState[c] += FILTER_ALPHA * (float(s.channel[c]) - padState[c]);
+            out[i].channel[c] = padState[c];
+        }
+    }
+}
+
+void StreamFilter::reset()
+{
+    memset(primed, 0, sizeof(primed));
+}
+
+QByteArray FrameStreamServer::encodeBatch(const ExamSamples &all, quint32 sequence, int decimation,
+                                          const StreamSubscription &subscription, const FilteredSamples *filtered,
+                                          const quint32 *padIndex)
+{
+    HUM_TRACE("process", "stream.encode");
+    // pad filter and decimation first: only the selected samples are ever encoded
+    QVector<int> selected;
+    selected.reserve(all.size() / qMax(decimation, 1) + 1);
+    quint32 counter[256] = {};
+    for (int i = 0; i < all.size(); ++i)
+    {
+        const quint8 pad = all.at(i).padAddress;
+        const quint32 n = padIndex ? padIndex[i] : counter[pad]++;
+        if (subscription.wantsPad(pad) && n % quint32(qMax(decimation, 1)) == 0)
+        {
+            selected.append(i);
+        }
+    }
+
+    quint32 columns = subscription.columns;
+    if (!filtered)
+    {
+        columns &= ~(((1u << EXAM_CHANNELS) - 1) << StreamSubscription::COL_FILTERED);
+    }
+    const int columnCount = qPopulationCount(columns);
+
+    const int n = selected.size();
+    const int padBytes = (n + 3) & ~3;
+    QByteArray out(HEADER_BYTES + n * 4 + padBytes + columnCount * n * 4, '\0');
+    char *p = out.data();
+
+    memcpy(p, "HUMF", 4);
+    qToLittleEndian<quint16>(3, p + 4);
+    qToLittleEndian<quint16>(quint16(columnCount), p + 6);
+    qToLittleEndian<quint32>(quint32(n), p + 8);
+    qToLittleEndian<quint32>(sequence, p + 12);
+    qToLittleEndian<quint16>(quint16(decimation), p + 16);
+    qToLittleEndian<quint32>(columns, p + 20);
+    p += HEADER_BYTES;
+
+    for (int i = 0; i < n; ++i)
+    {
+        qToLittleEndian<quint32>(all.at(selected.at(i)).timestamp, p + 4 * i);
+    }
+    p += n * 4;
+
+    for (int i = 0; i < n; ++i)
+    {
+        p[i] = char(all.at(selected.at(i)).padAddress);
+    }
+    p += padBytes;
+
+    for (int bit = 0; bit < 32; ++bit)
+    {
+        if (!(columns & (1u << bit)))
+        {
+            continue;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            const ExamSample &s = all.at(selected.at(i));
+            float v;
+            if (bit >= StreamSubscription::COL_COPX)
+            {
+                // COP on the plate surface: x = -My / Fz, y = Mx / Fz
+                const int fz = s.channel[CH_FZ];
+                if (qAbs(fz) < MIN_COP_FZ)
+                {
+                    v = std::numeric_limits<float>::quiet_NaN();
+                }
+                else if (bit == StreamSubscription::COL_COPX)
+                {
+                    v = -float(s.channel[CH_MY]) / fz;
+                }
+                else
+                {
+                    v = float(s.channel[CH_MX]) / fz;
+                }
+            }
+            else if (bit >= StreamSubscription::COL_FILTERED)
+            {
+                v = filtered->at(selected.at(i)).channel[bit - StreamSubscription::COL_FILTERED];
+            }
+            else
+            {
+                v = float(s.channel[bit - StreamSubscription::COL_RAW]);
+            }
+            qToLittleEndian<float>(v, p + 4 * i);
+        }
+        p += n * 4;
+    }
+
+    return out;
+}
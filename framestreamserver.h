@@ -0,0 +1,139 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVariantMap>
+#include "examdata.h"
+#include "broadcaster.h"
+
+class QWebSocketServer;
+class QWebSocket;
+
+// What a data stream client wants to receive. Columns are bits of 'columns':
+// COL_RAW + channel for the raw channels, COL_FILTERED + channel for the
+// low-pass filtered ones, COL_COPX/COL_COPY for the centre of pressure.
+struct StreamSubscription
+{
+    enum EColumn
+    {
+        COL_RAW = 0,
+        COL_FILTERED = 8,
+        COL_COPX = 16,
+        COL_COPY = 17
+    };
+
+    PadSet pads = PadSet().set();           // global pad addresses, all by default
+    quint32 columns = (1u << EXAM_CHANNELS) - 1;
+
+    bool operator==(const StreamSubscription &other) const
+    {
+        return pads == other.pads && columns == other.columns;
+    }
+    bool wantsPad(quint8 pad) const { return pads.test(pad); }
+
+    // { pads: [1, 2], channels: ["fz"], streams: ["raw", "filtered", "cop"] },
+    // a missing or empty list means everything (streams: raw only)
+    static bool fromVariant(const QVariantMap &map, StreamSubscription &out);
+    QVariantMap toVariant() const;
+};
+
+// Low-pass filtered channels, parallel to the samples of a batch
+struct FilteredSample
+{
+    float channel[EXAM_CHANNELS];
+};
+typedef QVector<FilteredSample> FilteredSamples;
+
+// Exponential moving average per pad and channel, started from the first
+// sample a pad sends after reset()
+class StreamFilter
+{
+public:
+    void run(const ExamSamples &batch, FilteredSamples &out);
+    void reset();
+
+private:
+    float state[256][EXAM_CHANNELS];
+    bool primed[256] = {};
+};
+
+// Binary WebSocket endpoint for the sample stream, next to the QWebChannel one.
+// On connection the client gets a text message {"client": "<token>"}, the token
+// to pass to DataBridge::subscribe(): random, so that a web channel client can
+// only change the subscription of a data socket it holds. Samples are collected and pushed every BATCH_MS
+// as one binary message:
+//
+//   offset 0   char[4]   "HUMF"
+//          4   uint16    version (3)
+//          6   uint16    column count k
+//          8   uint32    sample count n
+//         12   uint32    batch sequence number (gaps = batches dropped for this client)
+//         16   uint16    decimation: one sample every 'decimation' per pad
+//         18   uint16    reserved
+//         20   uint32    column mask (StreamSubscription::columns), columns in bit order
+//         24   uint32    timestamps[n] (ms)
+//              uint8     pads[n], zero padded to a multiple of 4
+//              float32   column[k][n]
+//
+// all little endian, every array 4-byte aligned so the browser can wrap it
+// in typed arrays without copying. Only the subscribed pads and columns are
+// encoded; clients with the same subscription and decimation share the
+// message. Decimation is set per client by the Broadcaster flow control and
+// keeps its phase across batches: the n-th sample of a pad since startup is
+// sent at decimation d when n % d == 0.
+class FrameStreamServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int BATCH_MS = 20;
+    static const int HEADER_BYTES = 24;
+    static const int MIN_COP_FZ = 20;       // below this the COP is NaN (raw units)
+
+    explicit FrameStreamServer(QObject *parent = nullptr);
+    ~FrameStreamServer();
+
+    bool listen(quint16 port);
+    int clientCount() const { return broadcaster.subscriberCount(); }
+    const Broadcaster &fanOut() const { return broadcaster; }
+
+    bool setSubscription(const QString &client, const StreamSubscription &subscription);
+    bool subscription(const QString &client, StreamSubscription &out) const;
+
+    // padIndex[i]: how many samples of the pad of samples[i] came before it, for
+    // the decimation phase. Without it the count starts from this batch.
+    static QByteArray encodeBatch(const ExamSamples &samples, quint32 sequence, int decimation = 1,
+                                  const StreamSubscription &subscription = StreamSubscription(),
+                                  const FilteredSamples *filtered = nullptr,
+                                  const quint32 *padIndex = nullptr);
+
+public slots:
+    void addSamples(const ExamSamples &samples);
+
+private slots:
+    void onNewConnection();
+    void flush();
+
+private:
+    QWebSocketServer *server;
+    Broadcaster broadcaster;
+    ExamSamples pending;
+    QTimer batchTimer;
+    QElapsedTimer batchAge;         // since the first sample of the pending batch
+    quint32 sequence = 0;
+    quint32 padSamples[256] = {};   // per pad, since startup
+    QVector<quint32> padIndex;      // of the batch being flushed, see encodeBatch()
+
+    int acquireVariant(const StreamSubscription &subscription);
+    void releaseVariant(int variant);
+
+    QHash<QString, QWebSocket *> clients;   // by token
+    // distinct subscriptions in use, index = Broadcaster variant. Variant 0 is the
+    // default one and always there, the others are reused once no client has them.
+    QList<StreamSubscription> variants;
+    QList<int> variantUsers;
+    QHash<QWebSocket *, int> clientVariant;
+    StreamFilter filter;
+};
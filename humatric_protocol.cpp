@@ -0,0 +1,27 @@
+/*
+ * humatric_protocol.cpp
+ * * CRC used by the Humatric controller protocol.
+ * * Copyright (c) 2025 Giuseppe Massimo Bertani
+ * All rights reserved.
+ * * Unauthorized copying of this file, via any medium is strictly prohibited.
+ * Proprietary and confidential.
+ */
+
+#include "humatric_protocol.h"
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), computed over everything
+// between the header marker and the CRC field
+uint16_t crc16(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; ++i)
+    {
+        crc ^= static_cast<uint16_t>(data[i]) << 8;
+        for (uint8_t bit = 0; bit < 8; ++bit)
+        {
+            if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+            else crc <<= 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,613 @@
+#include "humlog.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <chrono>
+#include <charconv>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+// Bounded MPSC ring (Vyukov): producers claim a slot with one CAS on the enqueue
+// position, the slot sequence number tells the writer when the record is complete.
+struct LogRing
+{
+    struct Slot
+    {
+        std::atomic<size_t> seq;
+        HumLogRecord record;
+    };
+
+    LogRing()
+        : slots(new Slot[HumLog::RING_SLOTS])
+    {
+        for (size_t i = 0; i < size_t(HumLog::RING_SLOTS); i++)
+        {
+            slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~LogRing()
+    {
+        delete[] slots;
+    }
+
+    bool push(const HumLogRecord &record)
+    {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot &slot = slots[pos & MASK];
+            const size_t seq = slot.seq.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    // header plus the used part of the payload only
+                    memcpy(&slot.record, &record, offsetof(HumLogRecord, payload) + record.used);
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;       // full
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // writer thread only
+    const HumLogRecord *peek()
+    {
+        Slot &slot = slots[dequeuePos & MASK];
+        if (slot.seq.load(std::memory_order_acquire) != dequeuePos + 1)
+        {
+            return nullptr;
+        }
+        return &slot.record;
+    }
+
+    void release()
+    {
+        slots[dequeuePos & MASK].seq.store(dequeuePos + HumLog::RING_SLOTS, std::memory_order_release);
+        dequeuePos++;
+    }
+
+    static const size_t MASK = HumLog::RING_SLOTS - 1;
+    static_assert((HumLog::RING_SLOTS & (HumLog::RING_SLOTS - 1)) == 0, "RING_SLOTS must be a power of two");
+
+    Slot *slots;
+    alignas(64) std::atomic<size_t> enqueuePos {0};
+    alignas(64) size_t dequeuePos = 0;
+};
+
+class RotatingFile
+{
+public:
+    ~RotatingFile()
+    {
+        close();
+    }
+
+    bool open(const QString &filePath, qint64 maxFileBytes, int keepFiles)
+    {
+        path = filePath;
+        maxBytes = maxFileBytes;
+        keep = keepFiles;
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        return reopen();
+    }
+
+    void write(const std::string &text)
+    {
+        if (!file)
+        {
+            return;
+        }
+        if (size > 0 && size + qint64(text.size()) > maxBytes)
+        {
+            rotate();
+            if (!file)
+            {
+                return;
+            }
+        }
+        size += qint64(fwrite(text.data(), 1, text.size(), file));
+    }
+
+    void flush()
+    {
+        if (file)
+        {
+            fflush(file);
+        }
+    }
+
+    void close()
+    {
+        if (file)
+        {
+            fclose(file);
+            file = nullptr;
+        }
+    }
+
+private:
+    bool reopen()
+    {
+        file = fopen(QFile::encodeName(path).constData(), "ab");
+        if (!file)
+        {
+            fprintf(stderr, "Cannot open log file %s\n", QFile::encodeName(path).constData());
+            return false;
+        }
+        fseek(file, 0, SEEK_END);
+        size = ftell(file);
+        return true;
+    }
+
+    void rotate()
+    {
+        close();
+        QFile::remove(path + "." + QString::number(keep));
+        for (int i = keep - 1; i >= 1; i--)
+        {
+            QFile::rename(path + "." + QString::number(i), path + "." + QString::number(i + 1));
+        }
+        if (keep > 0)
+        {
+            QFile::rename(path, path + ".1");
+        }
+        else
+        {
+            QFile::remove(path);
+        }
+        reopen();
+    }
+
+    QString path;
+    qint64 maxBytes = 0;
+    int keep = 0;
+    FILE *file = nullptr;
+    qint64 size = 0;
+};
+
+struct LogState
+{
+    ~LogState()
+    {
+        HumLog::stop();
+    }
+
+    LogRing ring;
+    std::atomic<quint64> dropped {0};
+    std::atomic<quint64> written {0};
+
+    std::mutex control;                 // start/stop
+    std::thread writer;
+    std::atomic<bool> running {false};
+    std::atomic<bool> sleeping {false};     // the writer found the ring empty, see wake()
+    std::mutex wakeLock;
+    std::condition_variable wakeUp;
+    bool console = true;
+    RotatingFile file;
+
+    // writer thread only
+    std::string line;
+    std::string batch;
+    qint64 prefixSecond = -1;
+    quint64 droppedReported = 0;
+    char prefix[32] = "";
+};
+
+LogState &state()
+{
+    static LogState logState;
+    return logState;
+}
+
+const int MAX_BATCH = 256;
+const int IDLE_WAIT_MS = 1000;       // only a safety net, pushes wake the writer
+
+const char LEVEL_CHARS[] = { '-', 'F', 'C', 'W', 'I', 'D' };
+
+qint64 nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+quintptr currentThread()
+{
+    return quintptr(QThread::currentThreadId());
+}
+
+const char *baseName(const char *file)
+{
+    const char *base = file;
+    for (const char *c = file; *c; c++)
+    {
+        if (*c == '/' || *c == '\\')
+        {
+            base = c + 1;
+        }
+    }
+    return base;
+}
+
+template <typename V>
+void appendNumber(std::string &out, V value, int base = 10)
+{
+    char buffer[32];
+    std::to_chars_result res;
+    if constexpr (std::is_floating_point_v<V>)
+    {
+        res = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    }
+    else
+    {
+        res = std::to_chars(buffer, buffer + sizeof(buffer), value, base);
+    }
+    out.append(buffer, res.ptr);
+}
+
+void formatRecord(LogState &s, const HumLogRecord &record)
+{
+    std::string &out = s.line;
+    out.clear();
+
+    // "yyyy-MM-dd hh:mm:ss" is formatted once per second
+    const qint64 second = record.timeUs / 1000000;
+    if (second != s.prefixSecond)
+    {
+        const QByteArray text = QDateTime::fromSecsSinceEpoch(second).toString("yyyy-MM-dd hh:mm:ss").toLatin1();
+        qstrncpy(s.prefix, text.constData(), sizeof(s.prefix));
+        s.prefixSecond = second;
+    }
+    out.append(s.prefix);
+    char millis[8];
+    snprintf(millis, sizeof(millis), ".%03d ", int(record.timeUs / 1000 % 1000));
+    out.append(millis);
+    out.push_back(record.level < sizeof(LEVEL_CHARS) ? LEVEL_CHARS[record.level] : '?');
+    out.append(" [");
+    appendNumber(out, quint64(record.thread), 16);
+    out.append("] ");
+    if (record.file)
+    {
+        out.append(baseName(record.file));
+        out.push_back(':');
+        appendNumber(out, record.line);
+        out.push_back(' ');
+    }
+
+    // arguments separated by a space, as QDebug does
+    int pos = 0;
+    bool first = true;
+    while (pos < record.used)
+    {
+        if (!first)
+        {
+            out.push_back(' ');
+        }
+        first = false;
+
+        const quint8 tag = quint8(record.payload[pos++]);
+        switch (tag)
+        {
+        case HumLogRecord::TAG_TEXT:
+        {
+            quint16 length;
+            memcpy(&length, record.payload + pos, sizeof(length));
+            pos += sizeof(length);
+            out.append(record.payload + pos, length);
+            pos += length;
+            break;
+        }
+        case HumLogRecord::TAG_INT:
+        {
+            qint64 value;
+            memcpy(&value, record.payload + pos, sizeof(value));
+            pos += sizeof(value);
+            appendNumber(out, value);
+            break;
+        }
+        case HumLogRecord::TAG_UINT:
+        case HumLogRecord::TAG_HEX:
+        {
+            quint64 value;
+            memcpy(&value, record.payload + pos, sizeof(value));
+            pos += sizeof(value);
+            appendNumber(out, value, tag == HumLogRecord::TAG_HEX ? 16 : 10);
+            break;
+        }
+        case HumLogRecord::TAG_DOUBLE:
+        {
+            double value;
+            memcpy(&value, record.payload + pos, sizeof(value));
+            pos += sizeof(value);
+            appendNumber(out, value);
+            break;
+        }
+        case HumLogRecord::TAG_BOOL:
+            out.append(record.payload[pos++] ? "true" : "false");
+            break;
+        case HumLogRecord::TAG_CHAR:
+            out.push_back(record.payload[pos++]);
+            break;
+        default:
+            pos = record.used;      // cannot happen, do not loop on garbage
+            break;
+        }
+    }
+    if (record.truncated)
+    {
+        out.append(" [...]");
+    }
+    out.push_back('\n');
+}
+
+// Writes what is in the ring now, returns the number of records
+int drain(LogState &s)
+{
+    int count = 0;
+    for (;;)
+    {
+        s.batch.clear();
+        int inBatch = 0;
+        while (inBatch < MAX_BATCH)
+        {
+            const HumLogRecord *record = s.ring.peek();
+            if (!record)
+            {
+                break;
+            }
+            formatRecord(s, *record);
+            s.ring.release();
+            s.batch += s.line;
+            inBatch++;
+        }
+        if (inBatch == 0)
+        {
+            break;
+        }
+
+        if (s.console)
+        {
+            fwrite(s.batch.data(), 1, s.batch.size(), stderr);
+        }
+        s.file.write(s.batch);
+        s.written.fetch_add(quint64(inBatch), std::memory_order_relaxed);
+        count += inBatch;
+    }
+
+    const quint64 droppedTotal = s.dropped.load(std::memory_order_relaxed);
+    const quint64 dropped = droppedTotal - s.droppedReported;
+    s.droppedReported = droppedTotal;
+    if (dropped)
+    {
+        char text[96];
+        snprintf(text, sizeof(text), "%s --- %llu log messages dropped (queue full)\n", s.prefix, (unsigned long long)dropped);
+        if (s.console)
+        {
+            fputs(text, stderr);
+        }
+        s.file.write(text);
+    }
+
+    // once the ring is empty, not per batch
+    if (count > 0 || dropped)
+    {
+        if (s.console)
+        {
+            fflush(stderr);
+        }
+        s.file.flush();
+    }
+    return count;
+}
+
+// 'sleeping' and the ring are checked in opposite order by the writer and by
+// wake(), with a full fence in between: either the writer sees the new record
+// or the pushing thread sees it sleeping
+void wake(LogState &s)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (s.sleeping.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(s.wakeLock);
+        s.sleeping.store(false, std::memory_order_relaxed);
+        s.wakeUp.notify_one();
+    }
+}
+
+void writerLoop()
+{
+    LogState &s = state();
+    while (s.running.load(std::memory_order_acquire))
+    {
+        if (drain(s) > 0)
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(s.wakeLock);
+        s.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (s.ring.peek() == nullptr && s.running.load(std::memory_order_acquire))
+        {
+            s.wakeUp.wait_for(lock, std::chrono::milliseconds(IDLE_WAIT_MS), [&s]() {
+                return !s.sleeping.load(std::memory_order_relaxed) || !s.running.load(std::memory_order_acquire);
+            });
+        }
+        s.sleeping.store(false, std::memory_order_relaxed);
+    }
+    drain(s);
+}
+
+void qtMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    int level = HUM_LOG_ALL;
+    switch (type)
+    {
+    case QtDebugMsg:    level = HUM_LOG_ALL; break;
+    case QtInfoMsg:     level = HUM_LOG_INFO; break;
+    case QtWarningMsg:  level = HUM_LOG_WARNINGS; break;
+    case QtCriticalMsg: level = HUM_LOG_CRITICAL; break;
+    case QtFatalMsg:    level = HUM_LOG_FATAL; break;
+    }
+
+    if (type == QtFatalMsg || level <= logLevel)
+    {
+        // context.file is a __FILE__ literal when present
+        HumLogLine(level, context.file, context.line) << message;
+    }
+
+    if (type == QtFatalMsg)
+    {
+        HumLog::stop();
+        abort();
+    }
+}
+
+} // namespace
+
+void HumLog::start(const QString &filePath, qint64 maxFileBytes, int keepFiles, bool console)
+{
+    LogState &s = state();
+    std::lock_guard<std::mutex> lock(s.control);
+    if (s.running.load())
+    {
+        return;
+    }
+    s.console = console;
+    if (!filePath.isEmpty())
+    {
+        s.file.open(filePath, maxFileBytes, keepFiles);
+    }
+    s.running.store(true, std::memory_order_release);
+    s.writer = std::thread(writerLoop);
+}
+
+void HumLog::stop()
+{
+    LogState &s = state();
+    std::lock_guard<std::mutex> lock(s.control);
+    if (!s.writer.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> wakeLock(s.wakeLock);
+        s.running.store(false, std::memory_order_release);
+        s.wakeUp.notify_one();
+    }
+    s.writer.join();
+    s.file.close();
+}
+
+void HumLog::flush()
+{
+    LogState &s = state();
+    if (!s.running.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    // everything claimed before this point has a position below 'target'
+    const size_t target = s.ring.enqueuePos.load(std::memory_order_acquire);
+    while (s.running.load(std::memory_order_acquire))
+    {
+        const LogRing::Slot &slot = s.ring.slots[(target - 1) & LogRing::MASK];
+        if (target == 0 || slot.seq.load(std::memory_order_acquire) >= target - 1 + RING_SLOTS)
+        {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void HumLog::installQtHandler()
+{
+    qInstallMessageHandler(qtMessageHandler);
+}
+
+bool HumLog::push(const HumLogRecord &record)
+{
+    LogState &s = state();
+    if (!s.ring.push(record))
+    {
+        s.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    wake(s);
+    return true;
+}
+
+quint64 HumLog::droppedCount()
+{
+    return state().dropped.load(std::memory_order_relaxed);
+}
+
+quint64 HumLog::writtenCount()
+{
+    return state().written.load(std::memory_order_relaxed);
+}
+
+HumLogLine::HumLogLine(int level, const char *file, int line)
+{
+    record.timeUs = nowUs();
+    record.thread = currentThread();
+    record.file = file;
+    record.line = quint16(line);
+    record.level = quint8(level);
+}
+
+HumLogLine::~HumLogLine()
+{
+    HumLog::push(record);
+}
+
+void HumLogLine::putText(const char *text, int length)
+{
+    const int room = HumLogRecord::PAYLOAD_BYTES - record.used - 1 - int(sizeof(quint16));
+    if (room <= 0)
+    {
+        record.truncated = true;
+        return;
+    }
+    if (length > room)
+    {
+        length = room;
+        record.truncated = true;
+    }
+    const quint16 length16 = quint16(length);
+    record.payload[record.used] = char(HumLogRecord::TAG_TEXT);
+    memcpy(record.payload + record.used + 1, &length16, sizeof(length16));
+    memcpy(record.payload + record.used + 1 + sizeof(length16), text, size_t(length));
+    record.used += quint16(1 + sizeof(length16) + length);
+}
+
+void HumLogLine::putString(const QString &text)
+{
+    // no more characters than the payload could hold anyway
+    const qsizetype length = qMin<qsizetype>(text.size(), HumLogRecord::PAYLOAD_BYTES);
+    const QByteArray utf8 = QStringView(text).left(length).toUtf8();
+    putText(utf8.constData(), int(utf8.size()));
+    if (length < text.size())
+    {
+        record.truncated = true;
+    }
+}
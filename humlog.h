@@ -0,0 +1,180 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QDebug>
+#include <QTextStream>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+// Asynchronous logging behind the MYDEBUG/MYINFO/MYWARNING/MYCRITICAL macros.
+//
+// A log call fills a HumLogRecord on the stack with its arguments in a compact
+// binary form (numbers as numbers, strings as UTF-8) and pushes it to a bounded
+// lock-free ring. Formatting, timestamps text and I/O happen in the writer thread,
+// which drains the ring into the console and a size-rotated log file. When the
+// ring is full the record is dropped and counted: a log call never blocks. An
+// idle writer sleeps until a log call wakes it, it does not poll.
+//
+// Levels above HUM_LOG_COMPILE_LEVEL are compiled out (the condition is a
+// constant), the others are filtered at run time by logLevel.
+
+enum LogLevels_t
+{
+    HUM_LOG_NONE,               // do not create a program log
+    HUM_LOG_FATAL,              // only fatal messages (crashes) are logged
+    HUM_LOG_CRITICAL,           // logs fatal and critical messages (alerts about possible crashes)
+    HUM_LOG_WARNINGS,           // logs warnings too (the program does not behave as expected)
+    HUM_LOG_INFO,               // logs info messages too
+
+    HUM_LOG_ALL                 // logs everything including debug messages (huge logs)
+};
+
+extern LogLevels_t logLevel;    //from main.cpp
+
+#ifndef HUM_LOG_COMPILE_LEVEL
+#define HUM_LOG_COMPILE_LEVEL HUM_LOG_ALL
+#endif
+
+#define HUM_LOG(level)      if ((level) > HUM_LOG_COMPILE_LEVEL || (level) > logLevel) {} else HumLogLine(level, __FILE__, __LINE__)
+
+#define MYDEBUG             HUM_LOG(HUM_LOG_ALL)
+#define MYINFO              HUM_LOG(HUM_LOG_INFO)
+#define MYWARNING           HUM_LOG(HUM_LOG_WARNINGS)
+#define MYCRITICAL          HUM_LOG(HUM_LOG_CRITICAL)
+#define MYFATAL(str,arg)    if(logLevel >= HUM_LOG_FATAL) qFatal(str,arg)
+
+struct HumLogRecord
+{
+    static const int PAYLOAD_BYTES = 200;
+
+    enum ETag : quint8
+    {
+        TAG_TEXT,           // quint16 length + UTF-8
+        TAG_INT,            // qint64
+        TAG_UINT,           // quint64
+        TAG_HEX,            // quint64
+        TAG_DOUBLE,
+        TAG_BOOL,           // quint8
+        TAG_CHAR
+    };
+
+    qint64 timeUs = 0;              // since the epoch
+    quintptr thread = 0;
+    const char *file = nullptr;     // __FILE__, static storage
+    quint16 line = 0;
+    quint8 level = 0;
+    bool truncated = false;
+    quint16 used = 0;
+    char payload[PAYLOAD_BYTES];
+};
+
+class HumLog
+{
+public:
+    static const int RING_SLOTS = 8192;
+
+    // filePath empty: console only. The file is renamed to .1 (.1 to .2, ...) when
+    // it reaches maxFileBytes, keepFiles old files are kept.
+    static void start(const QString &filePath = QString(), qint64 maxFileBytes = 10 * 1024 * 1024,
+                      int keepFiles = 5, bool console = true);
+    static void stop();             // writes what is queued and joins the writer, also done at exit
+    static void flush();            // returns when everything queued so far is written
+
+    // Qt's own messages (qDebug & co. from Qt or from code not using the macros)
+    static void installQtHandler();
+
+    static bool push(const HumLogRecord &record);
+    static quint64 droppedCount();
+    static quint64 writtenCount();
+};
+
+// One log call: collects the arguments, pushed to the ring when destroyed
+class HumLogLine
+{
+public:
+    HumLogLine(int level, const char *file, int line);
+    ~HumLogLine();
+
+    template <typename T>
+    HumLogLine &operator<<(const T &value)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            putScalar(HumLogRecord::TAG_BOOL, quint8(value));
+        }
+        else if constexpr (std::is_same_v<T, char>)
+        {
+            putScalar(HumLogRecord::TAG_CHAR, value);
+        }
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+        {
+            putScalar(hex && value >= 0 ? HumLogRecord::TAG_HEX : HumLogRecord::TAG_INT, qint64(value));
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            putScalar(hex ? HumLogRecord::TAG_HEX : HumLogRecord::TAG_UINT, quint64(value));
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            putScalar(HumLogRecord::TAG_DOUBLE, double(value));
+        }
+        else if constexpr (std::is_same_v<T, QByteArray>)
+        {
+            putText(value.constData(), value.size());
+        }
+        else if constexpr (std::is_convertible_v<const T &, const char *>)
+        {
+            const char *text = value;
+            putText(text, text ? int(strlen(text)) : 0);
+        }
+        else if constexpr (std::is_same_v<T, QString>)
+        {
+            putString(value);
+        }
+        else if constexpr (std::is_same_v<T, QTextStream &(QTextStream &)>)
+        {
+            // Qt::hex / Qt::dec, other manipulators are ignored
+            if (&value == &Qt::hex)
+            {
+                hex = true;
+            }
+            else if (&value == &Qt::dec)
+            {
+                hex = false;
+            }
+        }
+        else if constexpr (std::is_function_v<T>)
+        {
+        }
+        else
+        {
+            // anything QDebug knows how to print, formatted here: not for hot paths
+            QString text;
+            QDebug(&text).noquote().nospace() << value;
+            putString(text);
+        }
+        return *this;
+    }
+
+private:
+    template <typename V>
+    void putScalar(HumLogRecord::ETag tag, V value)
+    {
+        if (record.used + 1 + int(sizeof(V)) > HumLogRecord::PAYLOAD_BYTES)
+        {
+            record.truncated = true;
+            return;
+        }
+        record.payload[record.used] = char(tag);
+        memcpy(record.payload + record.used + 1, &value, sizeof(V));
+        record.used += quint16(1 + sizeof(V));
+    }
+
+    void putText(const char *text, int length);
+    void putString(const QString &text);
+
+    HumLogRecord record;
+    bool hex = false;
+};
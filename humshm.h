@@ -0,0 +1,189 @@
+/*
+ * HumServer frame ring in POSIX shared memory: the decoded samples of every
+ * controller, in timestamp order, for analysis processes on the same machine.
+ * Plain C, no dependencies: copy this header next to the consumer.
+ *
+ *     HumShmReader reader;
+ *     HumShmSample batch[1024];
+ *     if (hum_shm_open(&reader, HUM_SHM_DEFAULT_NAME) != 0)
+ *         return 1;                                   // server not running or ring disabled
+ *     while (!hum_shm_closed(&reader)) {
+ *         int n = hum_shm_read(&reader, batch, 1024);
+ *         if (n == 0)
+ *             usleep(1000);                           // nothing new
+ *         ...                                         // batch[0..n), reader.lost so far
+ *     }
+ *     hum_shm_close(&reader);
+ *
+ * Layout, host byte order:
+ *
+ *     offset  size  field
+ *          0   128  HumShmHeader
+ *        128    32  HumShmSlot[capacity], capacity a power of two
+ *
+ * The server is the only writer. Sample n (counting from 0 since the server
+ * started) goes to slot n % capacity:
+ *
+ *     slot.seq = 2n + 1           odd: being written
+ *     slot.sample = ...
+ *     slot.seq = 2n + 2           release: sample n complete
+ *     header.writeSeq = n + 1     release, once per batch
+ *
+ * A reader waiting for sample n loads slot.seq (acquire), copies the sample,
+ * and loads slot.seq again: if both read 2n + 2 the copy is sample n, whole.
+ * Anything else means the writer has gone round the ring since, and sample n
+ * is lost. Readers never write to the segment, any number of them can attach.
+ *
+ * Channels are in raw ADC units (header.units), as stored in the database.
+ * When the server exits it sets HUM_SHM_CLOSED and removes the name: a new
+ * server creates a new segment, reopen to follow it.
+ */
+#ifndef HUMSHM_H
+#define HUMSHM_H
+
+#include <stdint.h>
+
+#define HUM_SHM_MAGIC           "HUMSHM01"
+#define HUM_SHM_VERSION         1
+#define HUM_SHM_DEFAULT_NAME    "/humserver-frames"
+#define HUM_SHM_CHANNELS        6           /* fx, fy, fz, mx, my, mz */
+#define HUM_SHM_UNITS_ADC       0
+#define HUM_SHM_CLOSED          0x1u        /* header.flags */
+
+typedef struct HumShmHeader
+{
+    char     magic[8];              /*   0  HUM_SHM_MAGIC, no terminator */
+    uint32_t version;               /*   8  HUM_SHM_VERSION */
+    uint32_t headerBytes;           /*  12  offset of the first slot */
+    uint32_t slotBytes;             /*  16  sizeof(HumShmSlot) */
+    uint32_t capacity;              /*  20  slots, a power of two */
+    uint32_t channels;              /*  24  HUM_SHM_CHANNELS */
+    uint32_t units;                 /*  28  HUM_SHM_UNITS_ADC */
+    int64_t  startEpochMs;          /*  32  server start, ms since the epoch */
+    int32_t  serverPid;             /*  40 */
+    uint32_t flags;                 /*  44  HUM_SHM_CLOSED */
+    uint8_t  reserved0[16];         /*  48 */
+    uint64_t writeSeq;              /*  64  samples written so far, own cache line */
+    uint8_t  reserved1[56];         /*  72 */
+} HumShmHeader;
+
+typedef struct HumShmSample
+{
+    uint32_t timestamp;             /*   0  ms, common time base of all controllers */
+    uint8_t  pad;                   /*   4  global pad address: controller * 16 + pad */
+    uint8_t  controller;            /*   5 */
+    int16_t  channel[HUM_SHM_CHANNELS]; /* 6 */
+} HumShmSample;                     /*  20 with padding */
+
+typedef struct HumShmSlot
+{
+    uint64_t     seq;               /*   0  see above */
+    HumShmSample sample;            /*   8 */
+    uint8_t      reserved[4];       /*  28 */
+} HumShmSlot;
+
+#ifdef __cplusplus
+static_assert(sizeof(HumShmHeader) == 128, "HumShmHeader layout");
+static_assert(sizeof(HumShmSlot) == 32, "HumShmSlot layout");
+#else
+_Static_assert(sizeof(HumShmHeader) == 128, "HumShmHeader layout");
+_Static_assert(sizeof(HumShmSlot) == 32, "HumShmSlot layout");
+#endif
+
+/* The server only needs the layout */
+#ifndef HUM_SHM_NO_READER
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct HumShmReader
+{
+    const HumShmHeader *header;
+    const HumShmSlot   *slots;
+    size_t   mapBytes;
+    uint64_t next;                  /* sequence number of the next sample to read */
+    uint64_t lost;                  /* samples overwritten before they were read */
+} HumShmReader;
+
+/* Maps the ring read-only and starts from the next sample written. 0 or -1. */
+static inline int hum_shm_open(HumShmReader *r, const char *name)
+{
+    struct stat st;
+    void *map;
+    int fd = shm_open(name, O_RDONLY, 0);
+    memset(r, 0, sizeof(*r));
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(HumShmHeader)) {
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    r->header = (const HumShmHeader *)map;
+    r->mapBytes = (size_t)st.st_size;
+    if (memcmp(r->header->magic, HUM_SHM_MAGIC, 8) != 0 || r->header->version != HUM_SHM_VERSION
+        || r->header->slotBytes != sizeof(HumShmSlot) || r->header->capacity == 0
+        || (r->header->capacity & (r->header->capacity - 1)) != 0
+        || r->mapBytes < r->header->headerBytes + (size_t)r->header->capacity * sizeof(HumShmSlot)) {
+        munmap(map, r->mapBytes);
+        memset(r, 0, sizeof(*r));
+        return -1;
+    }
+    r->slots = (const HumShmSlot *)((const char *)map + r->header->headerBytes);
+    r->next = __atomic_load_n(&r->header->writeSeq, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
+/* Copies up to 'max' samples in order, returns how many. Samples the writer
+ * overwrote before they could be read are skipped and counted in r->lost. */
+static inline int hum_shm_read(HumShmReader *r, HumShmSample *out, int max)
+{
+    const uint64_t capacity = r->header->capacity;
+    const uint64_t written = __atomic_load_n(&r->header->writeSeq, __ATOMIC_ACQUIRE);
+    int n = 0;
+
+    if (written - r->next > capacity) {
+        r->lost += written - capacity - r->next;
+        r->next = written - capacity;
+    }
+    while (n < max && r->next < written) {
+        const HumShmSlot *slot = &r->slots[r->next & (capacity - 1)];
+        const uint64_t expected = 2 * r->next + 2;
+        const uint64_t before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (before == expected) {
+            memcpy(&out[n], (const void *)&slot->sample, sizeof(HumShmSample));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == expected) {
+                ++n;
+                ++r->next;
+                continue;
+            }
+        }
+        ++r->lost;                  /* overwritten: the writer went round the ring */
+        ++r->next;
+    }
+    return n;
+}
+
+static inline int hum_shm_closed(const HumShmReader *r)
+{
+    return (__atomic_load_n(&r->header->flags, __ATOMIC_ACQUIRE) & HUM_SHM_CLOSED) != 0;
+}
+
+static inline void hum_shm_close(HumShmReader *r)
+{
+    if (r->header)
+        munmap((void *)r->header, r->mapBytes);
+    memset(r, 0, sizeof(*r));
+}
+
+#endif /* HUM_SHM_NO_READER */
+
+#endif /* HUMSHM_H */
@@ -0,0 +1,117 @@
+#include "licenserenewal.h"
+#include "SystemKeyStore.h"
+#include "LicenseServerInterface.h"
+#include "humtoken.h"
+#include <QThread>
+#include <QRandomGenerator>
+#include <memory>
+
+static const qint64 DAY_MS = 24LL * 3600 * 1000;
+
+LicenseRenewal::LicenseRenewal(Settings &settingsRef, SystemKeyStore &storeRef, QObject *parent)
+    : QObject(parent),
+      settings(settingsRef),
+      store(storeRef)
+{
+    timer.setSingleShot(true);
+    timer.setTimerType(Qt::VeryCoarseTimer);
+    connect(&timer, &QTimer::timeout, this, &LicenseRenewal::schedule);
+}
+
+void LicenseRenewal::start()
+{
+    retrySeconds = FIRST_RETRY_S;
+    schedule();
+}
+
+void LicenseRenewal::schedule()
+{
+    if (renewing)
+    {
+        return;
+    }
+
+    const QDate renewFrom = store.checkDate().addDays(-RENEW_AHEAD_DAYS);
+    const qint64 wait = QDateTime::currentDateTime().msecsTo(renewFrom.startOfDay());
+    if (wait <= 0)
+    {
+        renewNow();
+        return;
+    }
+
+    // QTimer intervals are int: wake up at least once a day and look again
+    MYDEBUG << "License renewal scheduled from" << renewFrom.toString(Qt::ISODate);
+    timer.start(int(qMin(wait, DAY_MS)));
+    emit stateChanged("scheduled", store.checkDate());
+}
+
+void LicenseRenewal::renewNow()
+{
+    if (renewing)
+    {
+        return;
+    }
+    renewing = true;
+    timer.stop();
+    MYINFO << "Renewing license, check date" << store.checkDate().toString(Qt::ISODate);
+    emit stateChanged("renewing", store.checkDate());
+
+    // Only the network round trip runs in the worker, the token is stored in this
+    // thread. The worker never touches this object: the reply comes back through
+    // its finished() signal, which is disconnected if we are destroyed first
+    // (the round trip can outlive the application by up to ~30 s)
+    Settings *settingsPtr = &settings;
+    const QByteArray activationKey = settings.activationKeyBytes;
+    const QByteArray tempToken = store.getTempToken();
+    auto token = std::make_shared<QByteArray>();
+    QThread *worker = QThread::create([settingsPtr, activationKey, tempToken, token]() {
+        LicenseServerInterface license(*settingsPtr);
+        *token = license.requestValidatedToken(activationKey, tempToken);
+    });
+    connect(worker, &QThread::finished, this, [this, token]() {
+        onReply(*token);
+    });
+    connect(worker, &QThread::finished, worker, &QObject::deleteLater);
+    worker->start();
+}
+
+void LicenseRenewal::onReply(const QByteArray &token)
+{
+    renewing = false;
+
+    if (token.isEmpty())
+    {
+        MYWARNING << "License renewal failed";
+        retry();
+        return;
+    }
+
+    // checked before storing: a token that does not extend the check date must
+    // not replace the one we have (it would be renewed again right away)
+    const QDate previous = store.checkDate();
+    const QDate offered = HumToken::fromByteArray(token).getCheckTime();
+    if (!offered.isValid() || offered <= previous)
+    {
+        MYWARNING << "License server returned a token not extending" << previous.toString(Qt::ISODate);
+        retry();
+        return;
+    }
+    store.setToken(token);
+
+    MYINFO << "License renewed, new check date" << store.checkDate().toString(Qt::ISODate);
+    retrySeconds = FIRST_RETRY_S;
+    emit stateChanged("renewed", store.checkDate());
+    schedule();
+}
+
+void LicenseRenewal::retry()
+{
+    // +-20% so that many installations do not retry in step
+    const int jitter = int(QRandomGenerator::global()->bounded(retrySeconds * 2 / 5 + 1)) - retrySeconds / 5;
+    const int seconds = retrySeconds + jitter;
+    retrySeconds = qMin(retrySeconds * 2, MAX_RETRY_S);
+
+    MYINFO << "License renewal retry in" << seconds << "s";
+    emit stateChanged("retrying", store.checkDate());
+    timer.start(seconds * 1000);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QDate>
+#include "settings.h"
+
+class SystemKeyStore;
+
+// Renews the license token in the background, RENEW_AHEAD_DAYS before its check
+// date, so the system never reaches an expired token while running. The round
+// trip to the license server runs in a worker thread; a failure is retried with
+// exponential backoff (FIRST_RETRY_S doubling up to MAX_RETRY_S, with jitter)
+// until the check date. Nothing on the acquisition path waits for it.
+class LicenseRenewal : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int RENEW_AHEAD_DAYS = 7;
+    static const int FIRST_RETRY_S = 60;
+    static const int MAX_RETRY_S = 6 * 3600;
+
+    LicenseRenewal(Settings &settings, SystemKeyStore &store, QObject *parent = nullptr);
+
+    void start();                       // once the license has been validated
+    void renewNow();
+    bool isRenewing() const { return renewing; }
+
+signals:
+    // scheduled, renewing, retrying, renewed; checkDate is the current token's
+    void stateChanged(const QString &state, const QDate &checkDate);
+
+private:
+    void schedule();
+    void onReply(const QByteArray &token);
+    void retry();
+
+    Settings &settings;
+    SystemKeyStore &store;
+    QTimer timer;
+    bool renewing = false;
+    int retrySeconds = FIRST_RETRY_S;
+};
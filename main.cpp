@@ -12,12 +12,28 @@
 #include <QFile>
 #include <QDir>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QUrlQuery>
+#include <QHttpHeaders>
 #include "databridge.h"
+#include "MariaDBInterface.h"
 #include "websockettransport.h"
 #include "settings.h"
 #include "SystemKeyStore.h"
 #include "ControllerInterface.h"
+#include "controllerpool.h"
 #include "LicenseServerInterface.h"
+#include "framestreamserver.h"
+#include "staticassets.h"
+#include "metrics.h"
+#include "trace.h"
+#include "examhttpstream.h"
+#include "replaysource.h"
+#include "startupsequence.h"
+#include "licenserenewal.h"
+#include "realtime.h"
+#include "shmframering.h"
 
 #ifdef Q_OS_WIN
  #include <windows.h>
@@ -31,6 +47,9 @@
 LogLevels_t logLevel = HUM_LOG_ALL;
 
 int main(int argc, char *argv[]) {
+    QElapsedTimer coldStart;
+    coldStart.start();
+
     QCoreApplication app(argc, argv);
 
  #ifdef Q_OS_WIN
@@ -44,14 +63,21 @@ int main(int argc, char *argv[]) {
     freopen_s(&pCout, "CONOUT$", "w", stdout);
     freopen_s(&pCin, "CONIN$", "r", stdin);
     freopen_s(&pCerr, "CONOUT$", "w", stderr);
-
-    // Sincronizza Qt debug con console
-    qInstallMessageHandler([](QtMsgType type, const QMessageLogContext&, const QString& msg) {
-        printf("%s\n", msg.toLocal8Bit().constData());
-        fflush(stdout);
-    });
 #endif //Q_OS_WIN
 
+    // Log writer thread: console plus ~/.humserver/logs/humserver.log, rotated.
+    // Qt's own messages go through the same queue.
+    HumLog::start(QDir::homePath() + "/.humserver/logs/humserver.log");
+    HumLog::installQtHandler();
+
+    // Trace spans (trace.h) are recorded from the start with --trace, or from
+    // when /trace?enable=1 is requested
+    QThread::currentThread()->setObjectName("main");
+    if (app.arguments().contains("--trace")) {
+        HumTrace::setEnabled(true);
+        MYINFO << "Tracing enabled";
+    }
+
 
 
     // Qt translations (unchanged)
@@ -72,173 +98,52 @@ int main(int argc, char *argv[]) {
     // ===  Load humToken ===
     SystemKeyStore systemStore;
     bool newDevice = true;
-    bool unregistered = true;
     QByteArray humToken = systemStore.getToken();
     MYDEBUG << "humToken =" << humToken;
     if (humToken.isEmpty())
     {
         MYWARNING << "Product registration in progress, internet connection required";
-        humToken = systemStore.getTempToken();
     }
     else
     {
         newDevice = false;
-        unregistered = false;
     }
 
-    // === Create controller interface ===
-    ControllerInterface* ctrlIf = new ControllerInterface(settings, &app);
-    if (ctrlIf)
-    {
-        QThread::msleep(10);
-        QString serialID = ctrlIf->getSerialNumber();
-        if (serialID.isNull())
-        {
-            MYCRITICAL << "Unable to get a valid serial number from controller, aborting.";
-            return 1;
-        }
-
-        if(newDevice)
-        {
-            //Registering new controller device
-            systemStore.createTempToken(serialID);
-
-            // Request activation key from CLI
-            QByteArray activationKeyBytes;
-            bool validKey = false;
-
-            while (!validKey)
-            {
-                MYINFO << "Enter activation key (64 hex characters): ";
-                //out.flush();
-
-                // Usa input C standard invece di QTextStream
-                char buffer[128];
-                if (!fgets(buffer, sizeof(buffer), stdin))
-                {
-                    MYWARNING << "Error reading input.";
-                    continue;
-                }
-
-                // Converti a QString e pulisci
-                QString hexString = QString::fromLocal8Bit(buffer).trimmed();
-
-                if (hexString.length() != 64)
-                {
-                    MYWARNING << "Error: activation key must be exactly 64 hex characters.";
-                    continue;
-                }
-
-                // Verify only hex characters
-                bool isValidHex = true;
-                for (const QChar &c : hexString)
-                {
-                    if (!c.isDigit() && (c.toLower() < 'a' || c.toLower() > 'f'))
-                    {
-                        isValidHex = false;
-                        break;
-                    }
-                }
-
-                if (!isValidHex)
-                {
-                    MYWARNING << "Error: activation key contains invalid characters. Use only 0-9 and A-F.\n";
-                    continue;
-                }
-
-                // Convert from hex to bytes
-                activationKeyBytes = QByteArray::fromHex(hexString.toUtf8());
-
-                if (activationKeyBytes.size() == 32)
-                {
-                    validKey = true;
-                    MYINFO << "Activation key accepted.\n";
-                }
-                else
-                {
-                    MYWARNING << "Error in activation key conversion.\n";
-                }
-            }
-
-            LicenseServerInterface license(settings);
-            humToken = license.requestValidatedToken(activationKeyBytes, systemStore.getTempToken());
-
-            if (humToken.isEmpty())
-            {
-                MYCRITICAL << "License validation error. System in test mode.";
-                unregistered = true;
-            }
-            else
-            {
-                systemStore.setToken(humToken);
-                settings.activationKeyBytes = activationKeyBytes;
-                MYINFO << "New license valid, renewal date: " << systemStore.renewalDate() << ", system fully operational";
-                newDevice = false;
-                unregistered = false;
-            }
-        }
-        else
-        {
-            //Current token offline validity check
-            if(!systemStore.isTokenStillValid(serialID))
-            {
-                LicenseServerInterface license(settings);
-
-                //invalid token
-                if(!systemStore.isTokenExpired(serialID))
-                {
-                    MYWARNING << "Token validity expired, internet connection required for renewal";
-
-                    humToken = license.requestValidatedToken(settings.activationKeyBytes, systemStore.getTempToken());
-                    if (humToken.isEmpty())
-                    {
-                        MYCRITICAL << "License validation error. System in test mode.";
-                        unregistered = true;
-                    }
-
-                    MYINFO << "License renewed";
-                    systemStore.setToken(humToken.toHex());
-                    unregistered = false;
-                }
-                else
-                {
-                    MYWARNING << "This license is invalid. System in test mode.";
-
-                    //I casi sono due:
-                    //1-questo PC è stato associato ad un altro controller, cosa che non deve accadere.
-                    //2-è stato alterato l'hardware del PC associato, la pedana è la stessa. Contattare
-                    // via mail per richiedere una nuova activation key
-                    unregistered = true;
-                }
-            }
-            else
-            {
-                MYINFO << "License valid, renewal date: " << systemStore.renewalDate() << ", system fully operational";
-                unregistered = false;
-            }
+    // === Real-time mode (realtime.h) ===
+    // Memory is locked before the acquisition threads exist, their stacks included
+    if (settings.realTimeEnabled && settings.realTimeLockMemory) {
+        QString error;
+        if (RealTime::lockMemory(error)) {
+            metrics().memoryLocked.set(1);
+            MYINFO << "Process memory locked";
+        } else {
+            MYWARNING << "Memory not locked:" << error;
         }
     }
-    else
-    {
-        MYCRITICAL << "Unable to open serial port, aborting.";
-        return 1;
-    }
-
 
-    // === Database connection
-    MYDEBUG << "Available SQL drivers:" << QSqlDatabase::drivers();
-
-    if (!QSqlDatabase::isDriverAvailable("QMARIADB" /* "QMYSQL" */))
-    {
-        MYCRITICAL << "QMYSQL driver is not available, System in test mode.!";
-        unregistered = true;
+    // === Shared memory frame ring for local analysis processes (humshm.h) ===
+    // Declared before the controllers, which publish into it
+    ShmFrameRing shmRing;
+    if (settings.shmEnabled) {
+        shmRing.open(settings.shmName, settings.shmSlots);
     }
 
-    if(!unregistered)
-    {
-
-
+    // === Create controller interfaces ===
+    // One acquisition thread per controller, their samples merged (controllerpool.h).
+    // Only opens the ports: probing, license and database come after the servers
+    // are up, see StartupSequence, which works on the first controller
+    ControllerPool controllers(settings);
+    ControllerInterface* ctrlIf = controllers.controller(0);
+    if (shmRing.isOpen()) {
+        QObject::connect(&controllers, &ControllerPool::samplesReceived, &controllers, [&shmRing](const ExamSamples &samples) {
+            shmRing.publish(samples);
+        });
+    }
 
+    // --capture <file>: raw serial traffic for capreplay
+    const int captureArg = app.arguments().indexOf("--capture");
+    if (captureArg > 0 && captureArg + 1 < app.arguments().size()) {
+        controllers.startCapture(app.arguments().at(captureArg + 1));
     }
 
     // ===  Start QWebSocketServer for QWebChannel ===
@@ -252,6 +157,11 @@ int main(int argc, char *argv[]) {
 
     QWebChannel *channel = new QWebChannel();
     DataBridge *bridge = new DataBridge();
+    bridge->setControllers(&controllers);
+    bridge->setDisplayRate(settings.displayRateHz);
+    bridge->setSampleRate(settings.sampleRate);
+    bridge->setExportDirectory(settings.exportPath);
+    QObject::connect(&controllers, &ControllerPool::samplesReceived, bridge, &DataBridge::onSamples);
     channel->registerObject(QStringLiteral("humBridge"), bridge);
 
     QObject::connect(&server, &QWebSocketServer::newConnection, [&]() {
@@ -259,34 +169,80 @@ int main(int argc, char *argv[]) {
         MYDEBUG << "New WebSocket connection";
 
         auto *transport = new WebSocketTransport(socket);
+        metrics().channelClients.add(1);
         QObject::connect(socket, &QWebSocket::disconnected, transport, &QObject::deleteLater);
+        QObject::connect(socket, &QWebSocket::disconnected, []() {
+            metrics().channelClients.add(-1);
+        });
         channel->connectTo(transport);
     });
 
-    // ===  Start QHttpServer to serve index.html, qwebchannel.js, and script.js ===
+    // ===  Start binary data stream server, QWebChannel carries only control traffic ===
+    FrameStreamServer frameServer;
+    if (!frameServer.listen(12346)) {
+        return 1;
+    }
+    QObject::connect(&controllers, &ControllerPool::samplesReceived, &frameServer, &FrameStreamServer::addSamples);
+    bridge->setFrameStream(&frameServer);
+
+    // Recorded exams enter the pipeline exactly where the controller samples do
+    ReplaySource replay;
+    QObject::connect(&replay, &ReplaySource::samplesReceived, &frameServer, &FrameStreamServer::addSamples);
+    QObject::connect(&replay, &ReplaySource::samplesReceived, bridge, &DataBridge::onSamples);
+    bridge->setReplay(&replay);
+
+    // ===  Start QHttpServer to serve the web GUI (index.html, qwebchannel.js, script.js, ...) from memory ===
     QHttpServer httpServer;
 
-    const QString wwwRoot = QDir::currentPath();
+    StaticAssetService staticAssets(QDir::currentPath());
+    if (staticAssets.load() == 0) {
+        MYWARNING << "No web GUI files found in" << QDir::currentPath();
+    }
 
-    httpServer.route("/", [wwwRoot]() {
-        QFile file(wwwRoot + "/index.html");
-        if (file.open(QIODevice::ReadOnly))
-            return QHttpServerResponse("text/html", file.readAll());
-        return QHttpServerResponse(QHttpServerResponder::StatusCode::NotFound);
+    // Prometheus scrape target: only reads atomics, never touches the acquisition path
+    httpServer.route("/metrics", []() {
+        return QHttpServerResponse("text/plain; version=0.0.4; charset=utf-8", renderMetrics());
     });
 
-    httpServer.route("/qwebchannel.js", [wwwRoot]() {
-        QFile file(wwwRoot + "/qwebchannel.js");
-        if (file.open(QIODevice::ReadOnly))
-            return QHttpServerResponse("application/javascript", file.readAll());
-        return QHttpServerResponse(QHttpServerResponder::StatusCode::NotFound);
+    // Chrome trace JSON of the last 'seconds' (default 10), to open in Perfetto.
+    // enable=1/0 switches recording on and off.
+    httpServer.route("/trace", [](const QHttpServerRequest &request) {
+        const QUrlQuery query = request.query();
+        if (query.hasQueryItem("enable")) {
+            const bool on = query.queryItemValue("enable") == "1";
+            HumTrace::setEnabled(on);
+            MYINFO << "Tracing" << (on ? "enabled" : "disabled");
+            return QHttpServerResponse("text/plain", on ? "tracing on\n" : "tracing off\n");
+        }
+        bool ok = false;
+        int seconds = query.queryItemValue("seconds").toInt(&ok);
+        if (!ok || seconds <= 0) {
+            seconds = 10;
+        }
+        QHttpServerResponse response("application/json", HumTrace::chromeTrace(seconds));
+        QHttpHeaders headers = response.headers();
+        headers.append(QHttpHeaders::WellKnownHeader::ContentDisposition, "attachment; filename=\"humserver-trace.json\"");
+        response.setHeaders(std::move(headers));
+        return response;
     });
 
-    httpServer.route("/script.js", [wwwRoot]() {
-        QFile file(wwwRoot + "/script.js");
-        if (file.open(QIODevice::ReadOnly))
-            return QHttpServerResponse("application/javascript", file.readAll());
-        return QHttpServerResponse(QHttpServerResponder::StatusCode::NotFound);
+    // Stored exams in binary, chunked and seekable (examhttpstream.h)
+    StartupSequence startup(settings, systemStore, ctrlIf);
+    httpServer.route("/exams/<arg>/frames", QHttpServerRequest::Method::Get,
+                     [&startup, &httpServer](int examID, const QHttpServerRequest &request, QHttpServerResponder &responder) {
+        ExamHttpStream::start(startup.database(), examID, request, std::move(responder), &httpServer);
+    });
+
+    httpServer.route("/", [&staticAssets, &coldStart](const QHttpServerRequest &request) {
+        if (metrics().startupFirstPageMs.get() == 0) {
+            metrics().startupFirstPageMs.set(qMax<qint64>(1, coldStart.elapsed()));
+            MYINFO << "First page served" << coldStart.elapsed() << "ms after start";
+        }
+        return staticAssets.serve(QString(), request);
+    });
+
+    httpServer.route("/<arg>", [&staticAssets](const QUrl &path, const QHttpServerRequest &request) {
+        return staticAssets.serve(path.path(), request);
     });
 
     // Listen on port 8080 for HTTP requests
@@ -302,6 +258,28 @@ int main(int argc, char *argv[]) {
     }
 
     MYDEBUG << "HTTP server listening at http://<host>:8080/";
+    metrics().startupServersMs.set(coldStart.elapsed());
+    MYINFO << "Servers up" << coldStart.elapsed() << "ms after start";
+
+    // ===  Controller probing and license check run concurrently, the GUI follows them
+    //      through the "startup.*" live fields
+    QObject::connect(&startup, &StartupSequence::stageChanged, bridge, &DataBridge::setStartupStage);
+    QObject::connect(&startup, &StartupSequence::ready, bridge, &DataBridge::setStartupReady);
+    QObject::connect(&startup, &StartupSequence::ready, [&coldStart]() {
+        metrics().startupReadyMs.set(coldStart.elapsed());
+    });
+    QObject::connect(&startup, &StartupSequence::databaseReady, bridge, &DataBridge::setDatabase);
+
+    // The token is renewed ahead of its check date while the system runs
+    LicenseRenewal renewal(settings, systemStore);
+    QObject::connect(&renewal, &LicenseRenewal::stateChanged, bridge, &DataBridge::setLicenseState);
+    QObject::connect(&startup, &StartupSequence::ready, &renewal, [&renewal](bool registered) {
+        if (registered) {
+            renewal.start();
+        }
+    });
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, &startup, &StartupSequence::shutdown);
+    startup.start(newDevice);
 
 #ifdef Q_OS_WIN
     ShellExecuteA(nullptr, "open", settings.indexPath.toStdString().c_str(), nullptr, nullptr, SW_SHOWNORMAL);
@@ -0,0 +1,189 @@
+#include "metrics.h"
+#include <QtAlgorithms>
+
+ServerMetrics &metrics()
+{
+    static ServerMetrics instance;
+    return instance;
+}
+
+// 0..3 are exact, then 4 sub-buckets for each power of two
+static int bucketOf(quint64 us)
+{
+    if (us < 4)
+    {
+        return int(us);
+    }
+    const int msb = 63 - qCountLeadingZeroBits(us);
+    const int sub = int((us >> (msb - 2)) & 3);
+    return qMin(LatencyHistogram::BUCKETS - 1, (msb - 1) * 4 + sub);
+}
+
+static void bucketRange(int bucket, double &low, double &high)
+{
+    if (bucket < 4)
+    {
+        low = bucket;
+        high = bucket + 1;
+        return;
+    }
+    const int msb = bucket / 4 + 1;
+    const double width = double(quint64(1) << (msb - 2));
+    low = (4 + bucket % 4) * width;
+    high = low + width;
+}
+
+void LatencyHistogram::record(qint64 us)
+{
+    const quint64 v = us > 0 ? quint64(us) : 0;
+    buckets[bucketOf(v)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(v, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::percentileUs(double q) const
+{
+    quint64 counts[BUCKETS];
+    quint64 n = 0;
+    for (int i = 0; i < BUCKETS; ++i)
+    {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        n += counts[i];
+    }
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    // linear interpolation inside the bucket holding the rank
+    const double rank = q * double(n);
+    quint64 seen = 0;
+    for (int i = 0; i < BUCKETS; ++i)
+    {
+        if (counts[i] == 0)
+        {
+            continue;
+        }
+        if (double(seen + counts[i]) >= rank)
+        {
+            double low, high;
+            bucketRange(i, low, high);
+            return low + (high - low) * (rank - double(seen)) / double(counts[i]);
+        }
+        seen += counts[i];
+    }
+
+    double low, high;
+    bucketRange(BUCKETS - 1, low, high);
+    return high;
+}
+
+static void header(QByteArray &out, const char *name, const char *type, const char *help)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+static void sample(QByteArray &out, const char *name, const QByteArray &labels, double value)
+{
+    out += name;
+    if (!labels.isEmpty())
+    {
+        out += '{' + labels + '}';
+    }
+    out += ' ';
+    out += QByteArray::number(value, 'g', 12);
+    out += '\n';
+}
+
+static void scalar(QByteArray &out, const char *name, const char *type, const char *help, double value)
+{
+    header(out, name, type, help);
+    sample(out, name, QByteArray(), value);
+}
+
+static void latency(QByteArray &out, const char *stage, const LatencyHistogram &h)
+{
+    static const double quantiles[] = { 0.5, 0.9, 0.99 };
+    const QByteArray stageLabel = QByteArray("stage=\"") + stage + '"';
+    for (double q : quantiles)
+    {
+        sample(out, "hum_stage_latency_seconds", stageLabel + ",quantile=\"" + QByteArray::number(q) + '"',
+               h.percentileUs(q) / 1e6);
+    }
+    sample(out, "hum_stage_latency_seconds_sum", stageLabel, double(h.sumUs()) / 1e6);
+    sample(out, "hum_stage_latency_seconds_count", stageLabel, double(h.count()));
+}
+
+QByteArray renderMetrics()
+{
+    const ServerMetrics &m = metrics();
+    QByteArray out;
+    out.reserve(8192);
+
+    // the first controller's pads always, the others' once they have sent something
+    header(out, "hum_frames_received_total", "counter", "Frames decoded from the controllers, by global pad.");
+    for (int pad = 1; pad <= ServerMetrics::MAX_PAD; ++pad)
+    {
+        if (pad <= 16 || m.framesReceived[pad].get() > 0)
+        {
+            sample(out, "hum_frames_received_total", "pad=\"" + QByteArray::number(pad) + '"', double(m.framesReceived[pad].get()));
+        }
+    }
+    header(out, "hum_frames_dropped_total", "counter", "Frames rejected for bad CRC or EOT, by global pad.");
+    for (int pad = 1; pad <= ServerMetrics::MAX_PAD; ++pad)
+    {
+        if (pad <= 16 || m.framesDropped[pad].get() > 0)
+        {
+            sample(out, "hum_frames_dropped_total", "pad=\"" + QByteArray::number(pad) + '"', double(m.framesDropped[pad].get()));
+        }
+    }
+    scalar(out, "hum_crc_errors_total", "counter", "Messages with bad CRC or EOT.", double(m.crcErrors.get()));
+    scalar(out, "hum_decoder_resyncs_total", "counter", "Times the decoder skipped bytes to find a frame marker.", double(m.resyncs.get()));
+    scalar(out, "hum_frames_bad_pad_total", "counter", "Frames with a valid CRC and a pad address outside 1..16, dropped.", double(m.badPadFrames.get()));
+    scalar(out, "hum_notifies_total", "counter", "Notify messages received from the controller.", double(m.notifies.get()));
+    scalar(out, "hum_serial_bytes_total", "counter", "Bytes read from the controller while streaming.", double(m.serialBytes.get()));
+
+    scalar(out, "hum_stream_pending_samples", "gauge", "Samples waiting for the next data stream batch.", double(m.streamPendingSamples.get()));
+    scalar(out, "hum_live_pending_fields", "gauge", "Live fields waiting for the next display tick.", double(m.livePendingFields.get()));
+    scalar(out, "hum_db_pending_jobs", "gauge", "Jobs queued to the database thread.", double(m.dbPendingJobs.get()));
+    scalar(out, "hum_stream_queued_bytes", "gauge", "Bytes queued on data stream sockets, not yet written.", double(m.streamQueuedBytes.get()));
+
+    header(out, "hum_websocket_clients", "gauge", "Connected WebSocket clients, by endpoint.");
+    sample(out, "hum_websocket_clients", "endpoint=\"channel\"", double(m.channelClients.get()));
+    sample(out, "hum_websocket_clients", "endpoint=\"stream\"", double(m.streamClients.get()));
+    header(out, "hum_websocket_bytes_sent_total", "counter", "Bytes sent to WebSocket clients, by endpoint.");
+    sample(out, "hum_websocket_bytes_sent_total", "endpoint=\"channel\"", double(m.channelBytesSent.get()));
+    sample(out, "hum_websocket_bytes_sent_total", "endpoint=\"stream\"", double(m.streamBytesSent.get()));
+    header(out, "hum_websocket_messages_sent_total", "counter", "Messages sent to WebSocket clients, by endpoint.");
+    sample(out, "hum_websocket_messages_sent_total", "endpoint=\"channel\"", double(m.channelMessagesSent.get()));
+    sample(out, "hum_websocket_messages_sent_total", "endpoint=\"stream\"", double(m.streamMessagesSent.get()));
+    scalar(out, "hum_stream_messages_dropped_total", "counter", "Data stream batches dropped for slow clients.", double(m.streamMessagesDropped.get()));
+    scalar(out, "hum_shm_samples_published_total", "counter", "Samples written to the shared memory frame ring.", double(m.shmSamplesPublished.get()));
+
+    header(out, "hum_startup_milliseconds", "gauge", "Time from process start to each startup milestone, 0 if not reached.");
+    sample(out, "hum_startup_milliseconds", "milestone=\"servers\"", double(m.startupServersMs.get()));
+    sample(out, "hum_startup_milliseconds", "milestone=\"first_page\"", double(m.startupFirstPageMs.get()));
+    sample(out, "hum_startup_milliseconds", "milestone=\"ready\"", double(m.startupReadyMs.get()));
+
+    scalar(out, "hum_realtime_threads", "gauge", "Acquisition threads running with real-time scheduling.", double(m.realTimeThreads.get()));
+    scalar(out, "hum_memory_locked", "gauge", "1 if the process memory is locked in RAM.", double(m.memoryLocked.get()));
+
+    header(out, "hum_stage_latency_seconds", "summary", "Processing latency by pipeline stage.");
+    latency(out, "decode", m.decodeLatency);
+    latency(out, "batch_wait", m.batchWaitLatency);
+    latency(out, "fan_out", m.fanOutLatency);
+    latency(out, "db_queue", m.dbQueueLatency);
+    latency(out, "db_job", m.dbJobLatency);
+    latency(out, "db_write", m.dbWriteLatency);
+    latency(out, "acquisition_wakeup", m.wakeupLatency);
+
+    return out;
+}
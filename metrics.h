@@ -0,0 +1,103 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <atomic>
+
+// Process-wide counters for the /metrics endpoint. Everything is a relaxed
+// atomic: the acquisition path only pays an uncontended add, a scrape reads
+// the values without locking anything and may see them a few updates apart.
+
+class MetricCounter
+{
+public:
+    void add(quint64 n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    quint64 get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> value{0};
+};
+
+class MetricGauge
+{
+public:
+    void set(qint64 v) { value.store(v, std::memory_order_relaxed); }
+    void add(qint64 n) { value.fetch_add(n, std::memory_order_relaxed); }
+    qint64 get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> value{0};
+};
+
+// Latency distribution in microseconds, 4 buckets per power of two (about 19%
+// resolution) from 1 us to over an hour. Percentiles are computed at scrape time.
+class LatencyHistogram
+{
+public:
+    static const int BUCKETS = 128;
+
+    void record(qint64 us);
+    void recordSince(const QElapsedTimer &timer) { record(timer.nsecsElapsed() / 1000); }
+
+    quint64 count() const { return total.load(std::memory_order_relaxed); }
+    quint64 sumUs() const { return sum.load(std::memory_order_relaxed); }
+    double percentileUs(double q) const;
+
+private:
+    std::atomic<quint64> buckets[BUCKETS] = {};
+    std::atomic<quint64> total{0};
+    std::atomic<quint64> sum{0};
+};
+
+struct ServerMetrics
+{
+    static const int MAX_PAD = 240;         // global pad addresses, 15 controllers of 16 pads (examdata.h)
+
+    // controller stream
+    MetricCounter framesReceived[MAX_PAD + 1];
+    MetricCounter framesDropped[MAX_PAD + 1];   // CRC/EOT failures, by the pad byte of the rejected frame
+    MetricCounter crcErrors;
+    MetricCounter resyncs;
+    MetricCounter badPadFrames;             // valid CRC, pad byte outside 1..PADS_PER_CONTROLLER
+    MetricCounter notifies;
+    MetricCounter serialBytes;
+
+    // queues
+    MetricGauge streamPendingSamples;       // waiting for the next data stream batch
+    MetricGauge livePendingFields;          // waiting for the next display tick
+    MetricGauge dbPendingJobs;              // queued to the database thread
+    MetricGauge streamQueuedBytes;          // sent to data stream sockets, not yet written
+
+    // clients
+    MetricGauge channelClients;
+    MetricGauge streamClients;
+    MetricCounter channelBytesSent;
+    MetricCounter channelMessagesSent;
+    MetricCounter streamBytesSent;
+    MetricCounter streamMessagesSent;
+    MetricCounter streamMessagesDropped;
+    MetricCounter shmSamplesPublished;      // into the shared memory frame ring (humshm.h)
+
+    // stage latencies
+    LatencyHistogram decodeLatency;         // one serial read decoded
+    LatencyHistogram batchWaitLatency;      // first sample of a batch to its broadcast
+    LatencyHistogram fanOutLatency;         // encoding and queueing a batch
+    LatencyHistogram dbQueueLatency;        // database job waiting for the thread
+    LatencyHistogram dbJobLatency;          // database job run time
+    LatencyHistogram dbWriteLatency;        // exam saved or imported, commit included
+    LatencyHistogram wakeupLatency;         // acquisition thread timers, lateness (realtime.h)
+
+    // real-time mode (realtime.h)
+    MetricGauge realTimeThreads;            // acquisition threads with the requested scheduling
+    MetricGauge memoryLocked;               // 1 if mlockall() succeeded
+
+    // startup, ms from process start (0 = not reached yet)
+    MetricGauge startupServersMs;           // HTTP and WebSocket servers listening
+    MetricGauge startupFirstPageMs;         // first GUI page served
+    MetricGauge startupReadyMs;             // controller and license known
+};
+
+ServerMetrics &metrics();
+
+// Prometheus text exposition format (version 0.0.4)
+QByteArray renderMetrics();
@@ -0,0 +1,142 @@
+#include "realtime.h"
+#include "metrics.h"
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTimer>
+#include <cerrno>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+ #include <pthread.h>
+ #include <sched.h>
+ #include <sys/mman.h>
+ #include <sys/resource.h>
+ #include <unistd.h>
+#endif //Q_OS_LINUX
+
+#ifdef Q_OS_WIN
+ #include <windows.h>
+#endif //Q_OS_WIN
+
+bool RealTime::lockMemory(QString &error)
+{
+#ifdef Q_OS_LINUX
+    rlimit limit;
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && geteuid() != 0)
+    {
+        error = QString("memlock limit is %1 KB, it must be unlimited (LimitMEMLOCK=infinity or ulimit -l unlimited)")
+                    .arg(quint64(limit.rlim_cur) / 1024);
+        return false;
+    }
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        const int code = errno;
+        error = "mlockall: " + QString::fromLocal8Bit(strerror(code));
+        if (code == EPERM)
+        {
+            error += " (needs CAP_IPC_LOCK)";
+        }
+        return false;
+    }
+    return true;
+#else
+    error = "memory locking is only supported on Linux";
+    return false;
+#endif
+}
+
+bool RealTime::applyToCurrentThread(int priority, int cpu, QString &error)
+{
+    QStringList failures;
+
+#ifdef Q_OS_LINUX
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    param.sched_priority = qBound(sched_get_priority_min(SCHED_FIFO), priority, sched_get_priority_max(SCHED_FIFO));
+    int code = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (code != 0)
+    {
+        QString failure = QString("SCHED_FIFO priority %1: ").arg(param.sched_priority) + QString::fromLocal8Bit(strerror(code));
+        if (code == EPERM)
+        {
+            failure += " (needs CAP_SYS_NICE or LimitRTPRIO)";
+        }
+        failures << failure;
+    }
+
+    if (cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        code = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (code != 0)
+        {
+            failures << QString("affinity to CPU %1: ").arg(cpu) + QString::fromLocal8Bit(strerror(code));
+        }
+    }
+#elif defined(Q_OS_WIN)
+    Q_UNUSED(priority);
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+    {
+        failures << QString("THREAD_PRIORITY_TIME_CRITICAL: error %1").arg(GetLastError());
+    }
+    if (cpu >= 0 && SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) == 0)
+    {
+        failures << QString("affinity to CPU %1: error %2").arg(cpu).arg(GetLastError());
+    }
+#else
+    Q_UNUSED(priority);
+    Q_UNUSED(cpu);
+    failures << "real-time scheduling is not supported on this system";
+#endif
+
+    error = failures.join(", ");
+    return failures.isEmpty();
+}
+
+void RealTime::prefaultStack(int bytes)
+{
+    // one store per page, volatile so that it is not optimised away
+    const int PAGE = 4096;
+    volatile char probe[STACK_PREFAULT_BYTES];
+    const int size = qMin(bytes, int(sizeof(probe)));
+    for (int i = 0; i < size; i += PAGE)
+    {
+        probe[i] = 0;
+    }
+}
+
+QList<int> RealTime::parseCpuList(const QString &text)
+{
+    QList<int> cpus;
+    const QStringList items = text.split(',', Qt::SkipEmptyParts);
+    for (const QString &item : items)
+    {
+        bool ok = false;
+        const int cpu = item.trimmed().toInt(&ok);
+        if (ok && cpu >= 0)
+        {
+            cpus.append(cpu);
+        }
+    }
+    return cpus;
+}
+
+QTimer *RealTime::startWakeupProbe(QObject *parent, int intervalMs)
+{
+    QTimer *timer = new QTimer(parent);
+    timer->setTimerType(Qt::PreciseTimer);
+    timer->setInterval(intervalMs);
+
+    QElapsedTimer clock;
+    clock.start();
+    const qint64 intervalNs = qint64(intervalMs) * 1000000;
+    QObject::connect(timer, &QTimer::timeout, timer, [clock, intervalNs]() mutable {
+        const qint64 elapsedNs = clock.nsecsElapsed();
+        clock.restart();
+        metrics().wakeupLatency.record(qMax<qint64>(0, elapsedNs - intervalNs) / 1000);
+    });
+    timer->start();
+    return timer;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QString>
+#include <QList>
+
+class QObject;
+class QTimer;
+
+// Opt-in real-time setup of the acquisition threads ([RealTime] in config.ini,
+// off by default). With it each ControllerPool thread runs under SCHED_FIFO at
+// Settings::realTimePriority, pinned to one of Settings::realTimeCpus, with its
+// stack and buffers touched in advance, and the whole process is locked in RAM
+// so that a page fault never delays a serial read.
+//
+// None of this is granted to an ordinary user on Linux: SCHED_FIFO needs
+// CAP_SYS_NICE or an rtprio limit, memory locking CAP_IPC_LOCK or an unlimited
+// memlock limit (e.g. LimitRTPRIO=95 and LimitMEMLOCK=infinity in the systemd
+// unit). Every step reports why it failed and the server goes on without it.
+// On Windows the thread gets THREAD_PRIORITY_TIME_CRITICAL and the affinity
+// mask, memory is not locked.
+//
+// The effect shows in hum_stage_latency_seconds{stage="acquisition_wakeup"}:
+// while a controller streams, a timer in its thread (startWakeupProbe) records
+// how late it is woken up, in both modes, so the tails can be compared before
+// and after. No timer runs in an idle acquisition thread.
+class RealTime
+{
+public:
+    static const int STACK_BYTES = 1024 * 1024;             // acquisition thread stack, in real-time mode
+    static const int STACK_PREFAULT_BYTES = 256 * 1024;
+    static const int WAKEUP_PROBE_MS = 10;
+
+    // mlockall(MCL_CURRENT | MCL_FUTURE). Refused, and not tried, when the memlock
+    // limit is finite and the process is not root: allocations past the limit
+    // would fail later instead of now.
+    static bool lockMemory(QString &error);
+
+    // Calling thread: SCHED_FIFO at 'priority' (1..99), pinned to 'cpu' if >= 0
+    static bool applyToCurrentThread(int priority, int cpu, QString &error);
+
+    // Touches the next 'bytes' of the calling thread's stack
+    static void prefaultStack(int bytes = STACK_PREFAULT_BYTES);
+
+    // "2,3" -> {2, 3}, invalid entries dropped
+    static QList<int> parseCpuList(const QString &text);
+
+    // Timer in the calling thread, owned by 'parent', recording its lateness
+    // into metrics().wakeupLatency until it is deleted
+    static QTimer *startWakeupProbe(QObject *parent, int intervalMs = WAKEUP_PROBE_MS);
+};
@@ -0,0 +1,141 @@
+#include "replaysource.h"
+#include "settings.h"
+#include <algorithm>
+
+ReplaySource::ReplaySource(QObject *parent)
+    : QObject(parent)
+{
+    timer.setInterval(TICK_MS);
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, &QTimer::timeout, this, &ReplaySource::tick);
+}
+
+void ReplaySource::setSamples(const ExamCache::Entry &entry, int examID)
+{
+    pause();
+    samples = entry;
+    exam = examID;
+    t0 = (samples && !samples->isEmpty()) ? samples->first().timestamp : 0;
+    next = 0;
+    basePosition = 0;
+}
+
+void ReplaySource::clear()
+{
+    setSamples(ExamCache::Entry());
+}
+
+void ReplaySource::play()
+{
+    if (!samples || samples->isEmpty() || timer.isActive())
+    {
+        return;
+    }
+    if (next >= samples->size())
+    {
+        seek(0);        // at the end: start over
+    }
+
+    rebase();
+    timer.start();
+    MYDEBUG << "Replay of exam" << exam << "from" << position() << "ms at" << rate << "x";
+    emit stateChanged(true);
+}
+
+void ReplaySource::pause()
+{
+    if (!timer.isActive())
+    {
+        return;
+    }
+    basePosition = position();
+    timer.stop();
+    emit stateChanged(false);
+}
+
+void ReplaySource::seek(quint32 ms)
+{
+    if (!samples)
+    {
+        return;
+    }
+
+    const quint32 target = t0 + qMin(ms, duration());
+    auto it = std::lower_bound(samples->cbegin(), samples->cend(), target,
+                               [](const ExamSample &s, quint32 t) { return s.timestamp < t; });
+    next = int(it - samples->cbegin());
+    basePosition = target - t0;
+    clock.restart();
+}
+
+void ReplaySource::setSpeed(double speed)
+{
+    speed = qBound(MIN_SPEED, speed, MAX_SPEED);
+    if (speed == rate)
+    {
+        return;
+    }
+
+    // the media time reached so far is kept, only the slope changes
+    if (timer.isActive())
+    {
+        rebase();
+    }
+    rate = speed;
+}
+
+void ReplaySource::rebase()
+{
+    basePosition = position();
+    clock.restart();
+}
+
+quint32 ReplaySource::position() const
+{
+    if (!timer.isActive() || !clock.isValid())
+    {
+        return quint32(basePosition);
+    }
+    const double pos = basePosition + clock.nsecsElapsed() / 1e6 * rate;
+    return quint32(qMin(pos, double(duration())));
+}
+
+quint32 ReplaySource::duration() const
+{
+    if (!samples || samples->isEmpty())
+    {
+        return 0;
+    }
+    return samples->last().timestamp - t0;
+}
+
+void ReplaySource::tick()
+{
+    const quint32 due = t0 + position();
+
+    int end = next;
+    const int size = samples->size();
+    while (end < size && samples->at(end).timestamp <= due)
+    {
+        ++end;
+    }
+
+    if (end > next)
+    {
+        emit samplesReceived(samples->mid(next, end - next));
+        next = end;
+    }
+
+    if (next >= size)
+    {
+        if (looping)
+        {
+            seek(0);
+            return;
+        }
+        timer.stop();
+        basePosition = duration();
+        emit stateChanged(false);
+        emit finished();
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "examdata.h"
+#include "examcache.h"
+
+// Plays a recorded exam back into the live pipeline: samplesReceived() has the
+// same meaning as in ControllerInterface and is connected to the same slots, so
+// decimation, live values and fan-out work as for a real acquisition.
+//
+// Samples are released on their original timestamps scaled by the speed. A
+// PreciseTimer ticks every TICK_MS and emits everything that became due since the
+// previous tick, the media time being derived from a monotonic clock, so timer
+// jitter never accumulates. With loop enabled it is a repeatable load generator.
+class ReplaySource : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int TICK_MS = 5;
+    static constexpr double MIN_SPEED = 0.25;
+    static constexpr double MAX_SPEED = 8.0;
+
+    explicit ReplaySource(QObject *parent = nullptr);
+
+    // samples in timestamp order, as stored
+    void setSamples(const ExamCache::Entry &samples, int examID = 0);
+    void clear();
+
+    void play();
+    void pause();
+    void seek(quint32 ms);              // relative to the first sample
+    void setSpeed(double speed);
+    void setLoop(bool loop) { looping = loop; }
+
+    bool isPlaying() const { return timer.isActive(); }
+    double speed() const { return rate; }
+    quint32 position() const;           // ms from the first sample
+    quint32 duration() const;
+    int examID() const { return exam; }
+
+signals:
+    void samplesReceived(const ExamSamples &samples);
+    void stateChanged(bool playing);
+    void finished();
+
+private slots:
+    void tick();
+
+private:
+    void rebase();
+
+    ExamCache::Entry samples;
+    int exam = 0;
+    int next = 0;                       // first sample not emitted yet
+    quint32 t0 = 0;                     // timestamp of the first sample
+
+    double rate = 1.0;
+    bool looping = false;
+    QTimer timer;
+    QElapsedTimer clock;
+    double basePosition = 0;            // media ms at the last rebase
+};
@@ -3,11 +3,27 @@ const wsHost = location.hostname;
 const wsPort = 12345;
 
 const socket = new WebSocket(`${wsProtocol}://${wsHost}:${wsPort}`);
+socket.binaryType = "arraybuffer";
 
+// The server sends QWebChannel JSON as UTF-8 in binary frames (and accepts it
+// the same way): this adapter gives QWebChannel the text it expects.
+const utf8Decoder = new TextDecoder();
+const utf8Encoder = new TextEncoder();
+const channelTransport = {
+    send: data => socket.send(utf8Encoder.encode(data)),
+    onmessage: null
+};
+socket.onmessage = event => {
+    const data = typeof event.data === "string" ? event.data : utf8Decoder.decode(event.data);
+    if (channelTransport.onmessage)
+        channelTransport.onmessage({ data: data });
+};
 
 socket.onopen = () => {
-    new QWebChannel(socket, function(channel) {
+    new QWebChannel(channelTransport, function(channel) {
         window.humBridge = channel.objects.humBridge;
+        if (dataSubscription)
+            window.humSubscribe(dataSubscription);
 
         function updateList() {
             const list = document.getElementById("dataList");
@@ -22,6 +38,16 @@ socket.onopen = () => {
         updateList();
         humBridge.dataListChanged.connect(updateList);
 
+        // live values: full snapshot once, then only the fields that changed
+        window.humLive = {};
+        humBridge.liveSnapshot(function(snapshot) {
+            Object.assign(window.humLive, snapshot);
+        });
+        humBridge.liveUpdate.connect(function(changes) {
+            Object.assign(window.humLive, changes);
+            window.dispatchEvent(new CustomEvent("humlive", { detail: changes }));
+        });
+
         humBridge.logSent.connect(function(msg) {
             alert("Risposta da Qt: " + msg);
         });
@@ -31,3 +57,86 @@ socket.onopen = () => {
 socket.onerror = err => {
     console.error("Errore WebSocket:", err);
 };
+
+// Binary data stream: sample batches as typed arrays, see framestreamserver.h
+const dataPort = 12346;
+const dataSocket = new WebSocket(`${wsProtocol}://${wsHost}:${dataPort}`);
+dataSocket.binaryType = "arraybuffer";
+
+const channelNames = ["fx", "fy", "fz", "mx", "my", "mz"];
+
+// Column bits of the batch header, see StreamSubscription in framestreamserver.h
+function columnName(bit) {
+    if (bit < 8)
+        return channelNames[bit];
+    if (bit < 16)
+        return channelNames[bit - 8] + "_filtered";
+    return bit === 16 ? "copx" : "copy";
+}
+
+function decodeFrameBatch(buffer) {
+    const view = new DataView(buffer);
+    if (view.getUint32(0, true) !== 0x464D5548) // "HUMF"
+        return null;
+
+    const n = view.getUint32(8, true);
+    const columns = view.getUint32(20, true);
+    let offset = 24;
+
+    const batch = {
+        sequence: view.getUint32(12, true),
+        decimation: view.getUint16(16, true),
+        count: n,
+        timestamps: new Uint32Array(buffer, offset, n),
+        pads: null,
+        channels: {}
+    };
+    offset += 4 * n;
+    batch.pads = new Uint8Array(buffer, offset, n);
+    offset += (n + 3) & ~3;
+    for (let bit = 0; bit < 32; ++bit) {
+        if (!(columns & (1 << bit)))
+            continue;
+        batch.channels[columnName(bit)] = new Float32Array(buffer, offset, n);
+        offset += 4 * n;
+    }
+    return batch;
+}
+
+// Subscription of this page on the data stream: applied once both the client token
+// (first message of the data socket) and the web channel are available.
+// Example: humSubscribe({ pads: [1], channels: ["fz"], streams: ["raw", "cop"] })
+let dataClientId = "";
+let dataSubscription = null;
+
+window.humSubscribe = function(subscription) {
+    dataSubscription = subscription;
+    if (dataClientId && window.humBridge)
+        humBridge.subscribe(dataClientId, subscription, ok => {
+            if (!ok)
+                console.warn("Sottoscrizione rifiutata:", subscription);
+        });
+};
+
+dataSocket.onmessage = event => {
+    if (typeof event.data === "string") {
+        dataClientId = JSON.parse(event.data).client;
+        if (dataSubscription)
+            window.humSubscribe(dataSubscription);
+        return;
+    }
+
+    const batch = decodeFrameBatch(event.data);
+    if (!batch)
+        return;
+    window.humFrames = batch;
+    window.dispatchEvent(new CustomEvent("humframes", { detail: batch }));
+
+    const info = document.getElementById("frameInfo");
+    if (info && batch.count > 0 && batch.channels.fz)
+        info.textContent = `#${batch.sequence}: ${batch.count} campioni (1/${batch.decimation}), Fz = ${batch.channels.fz[batch.count - 1]}`;
+};
+
+dataSocket.onerror = err => {
+    console.error("Errore data stream:", err);
+};
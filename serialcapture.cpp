@@ -0,0 +1,224 @@
+#include "serialcapture.h"
+#include "settings.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <QDir>
+#include <QtEndian>
+#include <cstring>
+
+static const char CAPTURE_MAGIC[8] = { 'H', 'U', 'M', 'C', 'A', 'P', '0', '1' };
+static const int RECORD_HEADER_BYTES = 12;
+static const quint32 SENT_FLAG = 0x80000000u;
+
+SerialCaptureWriter::~SerialCaptureWriter()
+{
+    close();
+}
+
+bool SerialCaptureWriter::open(const QString &filePath, const QString &portName)
+{
+    close();
+    path = filePath;
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        MYWARNING << "Cannot create capture file" << path << ":" << file.errorString();
+        return false;
+    }
+
+    char header[HEADER_BYTES] = {};
+    memcpy(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    qToLittleEndian<quint32>(HEADER_BYTES, header + 8);
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + 16);
+    const QByteArray name = portName.toUtf8().left(39);
+    memcpy(header + 24, name.constData(), size_t(name.size()));
+    file.write(header, HEADER_BYTES);
+
+    buffer.reserve(FLUSH_BYTES + 4096);
+    chunks = 0;
+    bytes = 0;
+    queue.clear();
+    spare.clear();
+    dropped = 0;
+    stopping = false;
+    clock.start();
+    writer = std::thread(&SerialCaptureWriter::writerLoop, this);
+    MYINFO << "Capturing serial traffic to" << path;
+    return true;
+}
+
+void SerialCaptureWriter::close()
+{
+    if (!writer.joinable())
+    {
+        return;
+    }
+    handOff();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        wakeUp.notify_one();
+    }
+    writer.join();
+    file.close();
+    if (dropped)
+    {
+        MYWARNING << "Capture" << path << ":" << dropped << "bytes dropped, the disk did not keep up";
+    }
+    MYINFO << "Capture closed:" << chunks << "chunks," << bytes << "bytes";
+}
+
+quint64 SerialCaptureWriter::droppedBytes() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return dropped;
+}
+
+void SerialCaptureWriter::record(bool sent, const char *data, int length)
+{
+    if (!writer.joinable() || length <= 0)
+    {
+        return;
+    }
+
+    char header[RECORD_HEADER_BYTES];
+    qToLittleEndian<quint64>(quint64(clock.nsecsElapsed() / 1000), header);
+    qToLittleEndian<quint32>(quint32(length) | (sent ? SENT_FLAG : 0), header + 8);
+    buffer.append(header, RECORD_HEADER_BYTES);
+    buffer.append(data, length);
+    chunks++;
+    bytes += quint64(length);
+
+    if (buffer.size() >= FLUSH_BYTES)
+    {
+        handOff();
+    }
+}
+
+void SerialCaptureWriter::flush()
+{
+    if (writer.joinable())
+    {
+        handOff();
+    }
+}
+
+// Acquisition thread: no I/O and, once the spare buffers are there, no
+// allocation, the lock only covers the list operations
+void SerialCaptureWriter::handOff()
+{
+    if (buffer.isEmpty())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    if (queue.size() >= MAX_QUEUED_BUFFERS)
+    {
+        dropped += quint64(buffer.size());
+        buffer.resize(0);
+        return;
+    }
+    queue.append(std::move(buffer));
+    buffer = spare.isEmpty() ? QByteArray() : spare.takeLast();
+    if (buffer.capacity() < FLUSH_BYTES + 4096)
+    {
+        buffer.reserve(FLUSH_BYTES + 4096);
+    }
+    wakeUp.notify_one();
+}
+
+void SerialCaptureWriter::writerLoop()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;)
+    {
+        wakeUp.wait(guard, [this]() { return !queue.isEmpty() || stopping; });
+        if (queue.isEmpty())
+        {
+            return;     // stopping, everything written
+        }
+
+        QList<QByteArray> batch;
+        batch.swap(queue);
+        guard.unlock();
+
+        for (const QByteArray &data : std::as_const(batch))
+        {
+            if (file.write(data) != data.size())
+            {
+                MYWARNING << "Capture write failed:" << file.errorString();
+            }
+        }
+        file.flush();
+
+        guard.lock();
+        for (QByteArray &data : batch)
+        {
+            if (spare.size() < MAX_QUEUED_BUFFERS)
+            {
+                data.resize(0);
+                spare.append(std::move(data));
+            }
+        }
+    }
+}
+
+bool SerialCaptureReader::open(const QString &path)
+{
+    file.close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        error = file.errorString();
+        return false;
+    }
+    return rewind();
+}
+
+bool SerialCaptureReader::rewind()
+{
+    char header[SerialCaptureWriter::HEADER_BYTES];
+    if (!file.seek(0) || file.read(header, sizeof(header)) != qint64(sizeof(header))
+        || memcmp(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0)
+    {
+        error = "not a capture file";
+        return false;
+    }
+    const quint32 headerBytes = qFromLittleEndian<quint32>(header + 8);
+    startMs = qFromLittleEndian<qint64>(header + 16);
+    port = QString::fromUtf8(header + 24, int(qstrnlen(header + 24, 40)));
+    return file.seek(headerBytes);
+}
+
+bool SerialCaptureReader::next(Chunk &out)
+{
+    char header[RECORD_HEADER_BYTES];
+    const qint64 got = file.read(header, RECORD_HEADER_BYTES);
+    if (got == 0)
+    {
+        return false;
+    }
+    if (got != RECORD_HEADER_BYTES)
+    {
+        error = "truncated record";
+        return false;
+    }
+
+    const quint32 lengthAndFlag = qFromLittleEndian<quint32>(header + 8);
+    const qint64 length = qint64(lengthAndFlag & ~SENT_FLAG);
+    if (length > file.size() - file.pos())
+    {
+        error = "truncated record";
+        return false;
+    }
+    out.timeUs = qFromLittleEndian<quint64>(header);
+    out.sent = (lengthAndFlag & SENT_FLAG) != 0;
+    out.data.resize(length);
+    if (file.read(out.data.data(), length) != length)
+    {
+        error = "truncated record";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Raw serial traffic capture, for reproducing field problems with the decoder.
+//
+// File layout, little endian:
+//
+//     offset  type      field
+//          0  char[8]   "HUMCAP01"
+//          8  uint32    header size (64)
+//         12  uint32    reserved
+//         16  int64     capture start, ms since the epoch
+//         24  char[40]  port name, zero padded
+//         64            records
+//
+// record: uint64 time in us since the capture start (monotonic clock),
+//         uint32 length, bit 31 set for bytes sent to the controller,
+//         then the bytes as read from / written to the port.
+
+// The file is written by a thread of its own, like the HumLog writer: record()
+// runs on the acquisition thread and only appends to a memory buffer, full
+// buffers are handed over and come back empty to be reused. If the disk falls
+// more than MAX_QUEUED_BUFFERS behind, whole buffers are dropped (the file stays
+// readable, records never span two buffers) and counted in droppedBytes().
+class SerialCaptureWriter
+{
+public:
+    static const int HEADER_BYTES = 64;
+    static const int FLUSH_BYTES = 64 * 1024;
+    static const int MAX_QUEUED_BUFFERS = 64;       // 4 MB
+
+    ~SerialCaptureWriter();
+
+    bool open(const QString &path, const QString &portName);
+    void close();
+    bool isOpen() const { return writer.joinable(); }
+    QString fileName() const { return path; }
+
+    // Appends to the memory buffer, handed to the writer every FLUSH_BYTES or on flush()
+    void record(bool sent, const char *data, int length);
+    void flush();
+
+    quint64 chunkCount() const { return chunks; }
+    quint64 byteCount() const { return bytes; }
+    quint64 droppedBytes() const;
+
+private:
+    void handOff();
+    void writerLoop();
+
+    QString path;
+    QByteArray buffer;                  // acquisition thread only
+    QElapsedTimer clock;
+    quint64 chunks = 0;
+    quint64 bytes = 0;
+
+    // shared with the writer thread, under 'lock'
+    mutable std::mutex lock;
+    std::condition_variable wakeUp;
+    QList<QByteArray> queue;            // full buffers, oldest first
+    QList<QByteArray> spare;            // written, ready for reuse
+    quint64 dropped = 0;
+    bool stopping = false;
+
+    QFile file;                         // writer thread only, once open() returned
+    std::thread writer;
+};
+
+class SerialCaptureReader
+{
+public:
+    struct Chunk
+    {
+        quint64 timeUs = 0;
+        bool sent = false;
+        QByteArray data;
+    };
+
+    bool open(const QString &path);
+    bool next(Chunk &out);      // false at the end of the file or on a truncated record
+    bool rewind();
+
+    qint64 startEpochMs() const { return startMs; }
+    QString portName() const { return port; }
+    QString errorString() const { return error; }
+
+private:
+    QFile file;
+    qint64 startMs = 0;
+    QString port;
+    QString error;
+};
@@ -0,0 +1,156 @@
+#include "serialdiscovery.h"
+#include "ControllerInterface.h"
+#include "settings.h"
+#include <QSerialPort>
+#include <QSerialPortInfo>
+#include <cstring>
+
+SerialPortDiscovery::SerialPortDiscovery(const QString &serialParams, QObject *parent)
+    : QObject(parent),
+      params(serialParams)
+{
+    timeout.setSingleShot(true);
+    connect(&timeout, &QTimer::timeout, this, &SerialPortDiscovery::finish);
+}
+
+SerialPortDiscovery::~SerialPortDiscovery()
+{
+    while (!probes.isEmpty())
+    {
+        closeProbe(probes.size() - 1);
+    }
+}
+
+void SerialPortDiscovery::start(int timeoutMs)
+{
+    if (isRunning())
+    {
+        return;
+    }
+
+    results.clear();
+    clock.start();
+
+    // the same command as ControllerInterface::getSerialNumber()
+    const QByteArray command = ControllerInterface::buildCommand(0x0001, CMD_GET_SERIAL_NUMBER);
+
+    const QList<QSerialPortInfo> ports = QSerialPortInfo::availablePorts();
+    for (const QSerialPortInfo &info : ports)
+    {
+        if (excluded.contains(info.portName()))
+        {
+            continue;
+        }
+        QSerialPort *port = new QSerialPort(info, this);
+        ControllerInterface::applySerialParams(port, params);
+        if (!port->open(QIODevice::ReadWrite))
+        {
+            MYDEBUG << "Discovery: cannot open" << info.portName() << ":" << port->errorString();
+            delete port;
+            continue;
+        }
+
+        connect(port, &QSerialPort::readyRead, this, [this, port]() {
+            onReadyRead(port);
+        });
+        port->clear(QSerialPort::Input);
+        port->write(command);
+
+        Probe probe;
+        probe.port = port;
+        probes.append(probe);
+    }
+
+    MYDEBUG << "Discovery: probing" << probes.size() << "of" << ports.size() << "serial ports";
+    if (probes.isEmpty())
+    {
+        QTimer::singleShot(0, this, &SerialPortDiscovery::finish);
+        return;
+    }
+    timeout.start(timeoutMs);
+}
+
+void SerialPortDiscovery::onReadyRead(QSerialPort *port)
+{
+    for (int i = 0; i < probes.size(); ++i)
+    {
+        if (probes.at(i).port != port)
+        {
+            continue;
+        }
+
+        Probe &probe = probes[i];
+        probe.buffer.append(port->readAll());
+
+        const QString serialID = parseSerialNumber(probe.buffer);
+        if (serialID.isEmpty())
+        {
+            if (probe.buffer.size() > 4 * int(sizeof(T_SerialNumberResponse)))
+            {
+                closeProbe(i);      // talks, but not our protocol
+            }
+        }
+        else
+        {
+            const QString portName = port->portName();
+            MYINFO << "Discovery: controller" << serialID << "on" << portName << "after" << clock.elapsed() << "ms";
+            results.append({ portName, serialID });
+            closeProbe(i);
+            emit found(portName, serialID);
+        }
+        break;
+    }
+
+    if (probes.isEmpty())
+    {
+        finish();
+    }
+}
+
+void SerialPortDiscovery::closeProbe(int index)
+{
+    QSerialPort *port = probes.at(index).port;
+    probes.removeAt(index);
+    disconnect(port, nullptr, this, nullptr);
+    port->close();
+    port->deleteLater();
+}
+
+void SerialPortDiscovery::finish()
+{
+    timeout.stop();
+    while (!probes.isEmpty())
+    {
+        closeProbe(probes.size() - 1);
+    }
+
+    MYDEBUG << "Discovery finished in" << clock.elapsed() << "ms," << results.size() << "controller(s)";
+    emit finished(results);
+}
+
+QString SerialPortDiscovery::parseSerialNumber(const QByteArray &data)
+{
+    const int length = int(sizeof(T_SerialNumberResponse));
+    const uint8_t *raw = reinterpret_cast<const uint8_t *>(data.constData());
+
+    for (int pos = 0; pos + length <= data.size(); ++pos)
+    {
+        const uint8_t *r = raw + pos;
+        if (r[0] != (RSP_HEADER_MARKER >> 8) || r[1] != (RSP_HEADER_MARKER & 0xFF)
+            || r[3] != CMD_GET_SERIAL_NUMBER
+            || r[length - 2] != PROTOCOL_EOT || r[length - 1] != PROTOCOL_EOT)
+        {
+            continue;
+        }
+
+        const uint16_t received = static_cast<uint16_t>(r[length - 4] | (r[length - 3] << 8));
+        if (received != crc16(r + 2, size_t(length - 6)))
+        {
+            continue;
+        }
+
+        const char *id = reinterpret_cast<const char *>(r + offsetof(T_SerialNumberResponse, serialID));
+        return QString::fromLatin1(id, int(strnlen(id, MAX_SERIAL_ID_LEN))).trimmed();
+    }
+    return QString();
+}
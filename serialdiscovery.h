@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QStringList>
+#include <QTimer>
+#include <QElapsedTimer>
+
+class QSerialPort;
+
+// Finds the controller among the serial ports: every available port is opened
+// and sent CMD_GET_SERIAL_NUMBER at the same time, the answers are read
+// asynchronously and the whole discovery lasts one probe timeout at most.
+// found() comes as soon as a port answers with a valid T_SerialNumberResponse,
+// finished() when every port has answered or timed out.
+class SerialPortDiscovery : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int PROBE_TIMEOUT_MS = 500;
+
+    struct Result
+    {
+        QString portName;
+        QString serialID;
+    };
+
+    explicit SerialPortDiscovery(const QString &serialParams, QObject *parent = nullptr);
+    ~SerialPortDiscovery();
+
+    void start(int timeoutMs = PROBE_TIMEOUT_MS);
+    // Ports held by other controllers (Settings::extraSerialPorts), never probed
+    void setExcludedPorts(const QStringList &ports) { excluded = ports; }
+    bool isRunning() const { return !probes.isEmpty(); }
+
+    // Serial number in a valid response found anywhere in 'data', empty if none
+    static QString parseSerialNumber(const QByteArray &data);
+
+signals:
+    void found(const QString &portName, const QString &serialID);
+    void finished(const QList<SerialPortDiscovery::Result> &results);
+
+private:
+    struct Probe
+    {
+        QSerialPort *port = nullptr;
+        QByteArray buffer;
+    };
+
+    void onReadyRead(QSerialPort *port);
+    void finish();
+    void closeProbe(int index);
+
+    QString params;
+    QStringList excluded;
+    QList<Probe> probes;
+    QList<Result> results;
+    QTimer timeout;
+    QElapsedTimer clock;
+};
@@ -1,4 +1,5 @@
 #include "settings.h"
+#include "shmframering.h"
 #include <QDebug>
 #include <QFileInfo>
 
@@ -31,11 +32,14 @@ void Settings::load()
         dbUser = value("MariaDBUser").toString();
         dbPassword = value("MariaDBPassword").toString();
         indexPath = value("IndexPath").toString();
+        displayRateHz = value("DisplayRateHz", displayRateHz).toInt();
         endGroup();
 
         // Controller
         beginGroup("Controller");
         serialPort = value("SerialPort").toString();
+        serialAutoDiscovery = value("SerialAutoDiscovery", serialAutoDiscovery).toBool();
+        extraSerialPorts = value("ExtraSerialPorts").toStringList();
         serialParams = value("SerialParams").toString();
         controllerIP = value("ControllerIP").toString();
         wifiSSID = value("SSID").toString();
@@ -45,12 +49,29 @@ void Settings::load()
         channelMask = value("ChannelMask").toUInt();
         endGroup();
 
+        // RealTime
+        beginGroup("RealTime");
+        realTimeEnabled = value("Enabled", realTimeEnabled).toBool();
+        realTimePriority = value("Priority", realTimePriority).toInt();
+        realTimeCpus = value("Cpus", realTimeCpus).toStringList().join(',');   // 2,3 unquoted is read as a list
+        realTimeLockMemory = value("LockMemory", realTimeLockMemory).toBool();
+        endGroup();
+
+        // SharedMemory
+        beginGroup("SharedMemory");
+        shmEnabled = value("Enabled", shmEnabled).toBool();
+        shmName = value("Name", shmName).toString();
+        shmSlots = value("Slots", shmSlots).toInt();
+        endGroup();
+
         // Database
         beginGroup("Database");
         dbType = value("Type").toString();
         dbAccountUser = value("User").toString();
         dbAccountPassword = value("Password").toString();
         dbAccountUrl = value("Url").toString();
+        examCacheMB = value("ExamCacheMB", examCacheMB).toInt();
+        exportPath = value("ExportPath", exportPath).toString();
         endGroup();
 
         MYDEBUG << "[Settings] Configuration loaded";
@@ -76,11 +97,14 @@ void Settings::save()
     setValue("MariaDBUser", dbUser);
     setValue("MariaDBPassword", dbPassword);
     setValue("IndexPath", indexPath);
+    setValue("DisplayRateHz", displayRateHz);
     endGroup();
 
     // Controller
     beginGroup("Controller");
     setValue("SerialPort", serialPort);
+    setValue("SerialAutoDiscovery", serialAutoDiscovery);
+    setValue("ExtraSerialPorts", extraSerialPorts);
     setValue("SerialParams", serialParams);
     setValue("ControllerIP", controllerIP);
     setValue("SSID", wifiSSID);
@@ -90,18 +114,43 @@ void Settings::save()
     setValue("ChannelMask", channelMask);
     endGroup();
 
+    // RealTime
+    beginGroup("RealTime");
+    setValue("Enabled", realTimeEnabled);
+    setValue("Priority", realTimePriority);
+    setValue("Cpus", realTimeCpus);
+    setValue("LockMemory", realTimeLockMemory);
+    endGroup();
+
+    // SharedMemory
+    beginGroup("SharedMemory");
+    setValue("Enabled", shmEnabled);
+    setValue("Name", shmName);
+    setValue("Slots", shmSlots);
+    endGroup();
+
     // Database
     beginGroup("Database");
     setValue("Type", dbType);
     setValue("User", dbAccountUser);
     setValue("Password", dbAccountPassword);
     setValue("Url", dbAccountUrl);
+    setValue("ExamCacheMB", examCacheMB);
+    setValue("ExportPath", exportPath);
     endGroup();
 
     sync();
     MYDEBUG << "[Settings] Configurazione salvata";
 }
 
+void Settings::saveSerialPort()
+{
+    beginGroup("Controller");
+    setValue("SerialPort", serialPort);
+    endGroup();
+    sync();
+}
+
 void Settings::reset()
 {
     //reset to factory settings
@@ -121,9 +170,11 @@ void Settings::reset()
     dbUser = "humserver";
     dbPassword = "p@Ran2aXtutti";
     indexPath = QDir::toNativeSeparators("c:/Users/zot/Documents/Hum/Software/HumGUI/index.html");
+    displayRateHz = 30;
 
     // Controller
     serialPort = "COM1";
+    serialAutoDiscovery = false;
     serialParams = "115200,8,n,1";
     controllerIP = "0.0.0.0";            //TODO: letto con GET_STATUS
     controllerPort = 2025;               //UDP port
@@ -132,11 +183,24 @@ void Settings::reset()
     sampleRate = 100;
     channelMask = 0x3f;
 
+    // RealTime
+    realTimeEnabled = false;
+    realTimePriority = 80;
+    realTimeCpus = "";
+    realTimeLockMemory = true;
+
+    // SharedMemory
+    shmEnabled = false;
+    shmName = HUM_SHM_DEFAULT_NAME;
+    shmSlots = ShmFrameRing::DEFAULT_SLOTS;
+
     // Database
     dbType = "MariaDB";
     dbAccountUser = "humserver";
     dbAccountPassword = "p@Ran2aXtutti";
     dbAccountUrl = "localhost:3306";
+    examCacheMB = 256;
+    exportPath = QDir::homePath() + "/.humserver/exports";
 
     MYDEBUG << "[Settings] Configuration reset";
 }
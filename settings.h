@@ -3,28 +3,10 @@
 #include <QSettings>
 #include <QDir>
 #include <QString>
+#include <QStringList>
 #include <QStandardPaths>
 
-
-
-enum LogLevels_t
-{
-    HUM_LOG_NONE,               // do not create a program log
-    HUM_LOG_FATAL,              // only fatal messages (crashes) are logged
-    HUM_LOG_CRITICAL,           // logs fatal and critical messages (alerts about possible crashes)
-    HUM_LOG_WARNINGS,           // logs warnings too (the program does not behave as expected)
-    HUM_LOG_INFO,               // logs info messages too
-
-    HUM_LOG_ALL                 // logs everything including debug messages (huge logs)
-};
-
-extern LogLevels_t logLevel;    //from main.cpp
-
-#define MYDEBUG             if(logLevel >= HUM_LOG_ALL) qDebug() << __FILE__ << ":" << __LINE__
-#define MYINFO              if(logLevel >= HUM_LOG_INFO) qInfo() << __FILE__ << ":" << __LINE__
-#define MYWARNING           if(logLevel >= HUM_LOG_WARNINGS) qWarning() << __FILE__ << ":" << __LINE__
-#define MYCRITICAL          if(logLevel >= HUM_LOG_CRITICAL) qCritical() << __FILE__ << ":" << __LINE__
-#define MYFATAL(str,arg)    if(logLevel >= HUM_LOG_FATAL) qFatal(str,arg)
+#include "humlog.h"
 
 
 class Settings : public QSettings
@@ -35,6 +17,7 @@ public:
     void load();
     void save();
     void reset();
+    void saveSerialPort();              // only the controller port, after auto-discovery
 
     // Sezioni:
 
@@ -51,9 +34,12 @@ public:
     QString dbUser;
     QString dbPassword;
     QString indexPath;
+    int displayRateHz = 0;              // live values refresh rate in the browser
 
     // Controller
     QString serialPort;
+    bool serialAutoDiscovery = false;   // find the controller on any serial port, the winner is saved in serialPort
+    QStringList extraSerialPorts;       // more controllers, one acquisition thread each (ControllerPool)
     QString serialParams;
     QString controllerIP;
     QString wifiSSID;
@@ -62,9 +48,22 @@ public:
     int sampleRate = 0;
     quint32 channelMask = 0;
 
+    // RealTime, acquisition threads (realtime.h)
+    bool realTimeEnabled = false;
+    int realTimePriority = 0;           // SCHED_FIFO, 1..99
+    QString realTimeCpus;               // "2,3": controller N pinned to the (N % count)-th, empty = not pinned
+    bool realTimeLockMemory = false;
+
+    // SharedMemory, frame ring for local analysis processes (humshm.h)
+    bool shmEnabled = false;
+    QString shmName;
+    int shmSlots = 0;
+
     // Database
     QString dbType;
     QString dbAccountUser;
     QString dbAccountPassword;
     QString dbAccountUrl;
+    int examCacheMB = 0;                // RAM budget for decoded exams
+    QString exportPath;                 // exam files exported and imported from the GUI, nowhere else
 };
@@ -0,0 +1,137 @@
+#include "shmframering.h"
+#include "settings.h"
+#include "metrics.h"
+#include "trace.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <cerrno>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif //Q_OS_UNIX
+
+ShmFrameRing::~ShmFrameRing()
+{
+    close();
+}
+
+bool ShmFrameRing::open(const QString &name, int slotCount)
+{
+    close();
+
+#ifdef Q_OS_UNIX
+    quint32 capacity = 1;
+    while (capacity < quint32(qMax(slotCount, 2)) && capacity < (1u << 30))
+    {
+        capacity <<= 1;
+    }
+
+    shmName = name.toLocal8Bit();
+    if (!shmName.startsWith('/'))
+    {
+        shmName.prepend('/');
+    }
+
+    // a segment left by a server that crashed: its readers keep their mapping
+    shm_unlink(shmName.constData());
+    const int fd = shm_open(shmName.constData(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        MYWARNING << "Shared memory" << shmName << ":" << strerror(errno);
+        return false;
+    }
+
+    mapBytes = sizeof(HumShmHeader) + size_t(capacity) * sizeof(HumShmSlot);
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, off_t(mapBytes)) == 0)
+    {
+        map = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    const int error = errno;
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        MYWARNING << "Shared memory" << shmName << ", " << mapBytes << "bytes:" << strerror(error);
+        shm_unlink(shmName.constData());
+        mapBytes = 0;
+        return false;
+    }
+
+    // ftruncate() zeroed everything: slot seq 0 is "never written"
+    header = static_cast<HumShmHeader *>(map);
+    slots = reinterpret_cast<HumShmSlot *>(static_cast<char *>(map) + sizeof(HumShmHeader));
+    mask = capacity - 1;
+    writeSeq = 0;
+
+    std::memcpy(header->magic, HUM_SHM_MAGIC, sizeof(header->magic));
+    header->version = HUM_SHM_VERSION;
+    header->headerBytes = sizeof(HumShmHeader);
+    header->slotBytes = sizeof(HumShmSlot);
+    header->capacity = capacity;
+    header->channels = HUM_SHM_CHANNELS;
+    header->units = HUM_SHM_UNITS_ADC;
+    header->startEpochMs = QDateTime::currentMSecsSinceEpoch();
+    header->serverPid = int32_t(QCoreApplication::applicationPid());
+    __atomic_store_n(&header->writeSeq, 0, __ATOMIC_RELEASE);
+
+    MYINFO << "Frame ring in shared memory" << shmName << "," << capacity << "samples";
+    return true;
+#else
+    Q_UNUSED(slotCount);
+    MYWARNING << "Shared memory frame ring" << name << "not available: POSIX shared memory only";
+    return false;
+#endif
+}
+
+void ShmFrameRing::close()
+{
+#ifdef Q_OS_UNIX
+    if (!header)
+    {
+        return;
+    }
+    __atomic_or_fetch(&header->flags, HUM_SHM_CLOSED, __ATOMIC_RELEASE);
+    munmap(header, mapBytes);
+    shm_unlink(shmName.constData());
+    header = nullptr;
+    slots = nullptr;
+    mapBytes = 0;
+#endif
+}
+
+// Per slot: odd seq, payload, even seq (humshm.h). The release fence keeps the
+// payload stores after the odd seq, the final release store keeps them before
+// the even one.
+void ShmFrameRing::publish(const ExamSamples &samples)
+{
+#ifdef Q_OS_UNIX
+    if (!header || samples.isEmpty())
+    {
+        return;
+    }
+
+    HUM_TRACE("shm", "publish");
+    for (const ExamSample &s : samples)
+    {
+        HumShmSlot &slot = slots[writeSeq & mask];
+        __atomic_store_n(&slot.seq, 2 * writeSeq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        slot.sample.timestamp = s.timestamp;
+        slot.sample.pad = s.padAddress;
+        slot.sample.controller = s.controller;
+        std::memcpy(slot.sample.channel, s.channel, sizeof(slot.sample.channel));
+
+        __atomic_store_n(&slot.seq, 2 * writeSeq + 2, __ATOMIC_RELEASE);
+        ++writeSeq;
+    }
+    __atomic_store_n(&header->writeSeq, writeSeq, __ATOMIC_RELEASE);
+    metrics().shmSamplesPublished.add(quint64(samples.size()));
+#else
+    Q_UNUSED(samples);
+#endif
+}
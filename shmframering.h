@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include "examdata.h"
+
+#define HUM_SHM_NO_READER
+#include "humshm.h"
+
+// Writer side of the shared-memory frame ring for local analysis processes:
+// layout, protocol and the C reader are in humshm.h. publish() copies the
+// samples into the ring and never waits for the readers, the slowest ones
+// lose samples instead (HumShmReader::lost). POSIX only: on other systems
+// open() fails and says so.
+class ShmFrameRing
+{
+public:
+    static const int DEFAULT_SLOTS = 1 << 18;       // 8 MB, 16 s of 16 pads at 1 kHz
+
+    ~ShmFrameRing();
+
+    // Creates the segment (a stale one with the same name is replaced), 'slots'
+    // rounded up to a power of two
+    bool open(const QString &name, int slots = DEFAULT_SLOTS);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    // Single writer: always from the same thread
+    void publish(const ExamSamples &samples);
+
+    quint64 published() const { return writeSeq; }
+
+private:
+    HumShmHeader *header = nullptr;
+    HumShmSlot *slots = nullptr;
+    size_t mapBytes = 0;
+    quint64 mask = 0;
+    quint64 writeSeq = 0;
+    QByteArray shmName;
+};
@@ -0,0 +1,370 @@
+#include "startupsequence.h"
+#include "SystemKeyStore.h"
+#include "ControllerInterface.h"
+#include "LicenseServerInterface.h"
+#include "MariaDBInterface.h"
+#include "serialdiscovery.h"
+#include <QSqlDatabase>
+#include <QTimer>
+#include <cstdio>
+#include <memory>
+
+// Activation key typed on the console, blocks until a valid one is entered
+static QByteArray readActivationKey()
+{
+    QByteArray activationKeyBytes;
+    bool validKey = false;
+
+    while (!validKey)
+    {
+        MYINFO << "Enter activation key (64 hex characters): ";
+
+        // Usa input C standard invece di QTextStream
+        char buffer[128];
+        if (!fgets(buffer, sizeof(buffer), stdin))
+        {
+            MYWARNING << "Error reading input.";
+            continue;
+        }
+
+        // Converti a QString e pulisci
+        QString hexString = QString::fromLocal8Bit(buffer).trimmed();
+
+        if (hexString.length() != 64)
+        {
+            MYWARNING << "Error: activation key must be exactly 64 hex characters.";
+            continue;
+        }
+
+        // Verify only hex characters
+        bool isValidHex = true;
+        for (const QChar &c : hexString)
+        {
+            if (!c.isDigit() && (c.toLower() < 'a' || c.toLower() > 'f'))
+            {
+                isValidHex = false;
+                break;
+            }
+        }
+
+        if (!isValidHex)
+        {
+            MYWARNING << "Error: activation key contains invalid characters. Use only 0-9 and A-F.\n";
+            continue;
+        }
+
+        // Convert from hex to bytes
+        activationKeyBytes = QByteArray::fromHex(hexString.toUtf8());
+
+        if (activationKeyBytes.size() == 32)
+        {
+            validKey = true;
+            MYINFO << "Activation key accepted.\n";
+        }
+        else
+        {
+            MYWARNING << "Error in activation key conversion.\n";
+        }
+    }
+    return activationKeyBytes;
+}
+
+// Runs in a worker thread: console input and the license server round trip may
+// take as long as they need without holding the event loop
+static bool validateLicense(Settings &settings, SystemKeyStore &systemStore, QString serialID, bool newDevice)
+{
+    if (newDevice)
+    {
+        //Registering new controller device
+        systemStore.createTempToken(serialID);
+
+        // Request activation key from CLI
+        const QByteArray activationKeyBytes = readActivationKey();
+
+        LicenseServerInterface license(settings);
+        const QByteArray humToken = license.requestValidatedToken(activationKeyBytes, systemStore.getTempToken());
+        if (humToken.isEmpty())
+        {
+            MYCRITICAL << "License validation error. System in test mode.";
+            return false;
+        }
+
+        systemStore.setToken(humToken);
+        settings.activationKeyBytes = activationKeyBytes;
+        MYINFO << "New license valid, renewal date: " << systemStore.renewalDate() << ", system fully operational";
+        return true;
+    }
+
+    //Current token offline validity check
+    if (systemStore.isTokenStillValid(serialID))
+    {
+        MYINFO << "License valid, renewal date: " << systemStore.renewalDate() << ", system fully operational";
+        return true;
+    }
+
+    //invalid token
+    if (!systemStore.isTokenExpired(serialID))
+    {
+        MYWARNING << "This license is invalid. System in test mode.";
+
+        //I casi sono due:
+        //1-questo PC è stato associato ad un altro controller, cosa che non deve accadere.
+        //2-è stato alterato l'hardware del PC associato, la pedana è la stessa. Contattare
+        // via mail per richiedere una nuova activation key
+        return false;
+    }
+
+    MYWARNING << "Token validity expired, internet connection required for renewal";
+
+    LicenseServerInterface license(settings);
+    const QByteArray humToken = license.requestValidatedToken(settings.activationKeyBytes, systemStore.getTempToken());
+    if (humToken.isEmpty())
+    {
+        MYCRITICAL << "License validation error. System in test mode.";
+        return false;
+    }
+
+    MYINFO << "License renewed";
+    systemStore.setToken(humToken);
+    return true;
+}
+
+StartupSequence::StartupSequence(Settings &settingsRef, SystemKeyStore &storeRef, ControllerInterface *ctrl,
+                                 QObject *parent)
+    : QObject(parent),
+      settings(settingsRef),
+      store(storeRef),
+      controller(ctrl)
+{
+    connect(controller, &ControllerInterface::serialNumberReceived, this, &StartupSequence::onSerialNumber);
+
+    if (settings.serialAutoDiscovery)
+    {
+        discovery = new SerialPortDiscovery(settings.serialParams, this);
+        discovery->setExcludedPorts(settings.extraSerialPorts);
+        connect(discovery, &SerialPortDiscovery::found, this, &StartupSequence::onPortFound);
+        connect(discovery, &SerialPortDiscovery::finished, this, [this](const QList<SerialPortDiscovery::Result> &results) {
+            if (results.isEmpty())
+            {
+                onSerialNumber(QString());
+            }
+        });
+    }
+}
+
+void StartupSequence::start(bool isNewDevice)
+{
+    clock.start();
+    newDevice = isNewDevice;
+
+    setStage("database", "waiting");
+    probeController();
+
+    // A known device is checked against the controller its token was issued for,
+    // without waiting for the probe; the probe must then find that same controller.
+    // A new device needs the serial number to register.
+    if (!newDevice)
+    {
+        checkLicense(store.tokenControllerID());
+    }
+    else
+    {
+        setStage("license", "waiting for controller");
+    }
+}
+
+void StartupSequence::probeController()
+{
+    if (!serialID.isEmpty())
+    {
+        return;
+    }
+    setStage("controller", "probing");
+    discovering = false;
+
+    // the saved port first, discovery only when it does not answer
+    if (!controller->reopen())
+    {
+        onSerialNumber(QString());
+        return;
+    }
+    controller->requestSerialNumber();
+}
+
+void StartupSequence::onPortFound(const QString &portName, const QString &id)
+{
+    if (!serialID.isEmpty())
+    {
+        return;     // the first answer wins
+    }
+
+    const bool changed = portName != settings.serialPort;
+    if (!controller->switchPort(portName))
+    {
+        onSerialNumber(QString());      // retried later
+        return;
+    }
+    if (changed)
+    {
+        MYINFO << "Controller port is now" << portName;
+        settings.saveSerialPort();
+    }
+    onSerialNumber(id);
+}
+
+void StartupSequence::onSerialNumber(const QString &id)
+{
+    if (!serialID.isEmpty())
+    {
+        return;
+    }
+
+    if (id.isEmpty() && discovery && !discovering)
+    {
+        // the saved port is probed with all the others, it must not be held open
+        MYINFO << "No controller on" << settings.serialPort << ", probing every serial port";
+        discovering = true;
+        controller->closePort();
+        discovery->start();
+        return;
+    }
+
+    if (id.isEmpty())
+    {
+        setStage("controller", "not found");
+        MYWARNING << "No answer from the controller, retrying in" << PROBE_RETRY_MS / 1000 << "s";
+        QTimer::singleShot(PROBE_RETRY_MS, this, &StartupSequence::probeController);
+        return;
+    }
+
+    serialID = id;
+    MYINFO << "Controller" << serialID << "found after" << clock.elapsed() << "ms";
+    setStage("controller", "ok");
+
+    if (newDevice)
+    {
+        checkLicense(serialID);
+    }
+    decide();
+}
+
+void StartupSequence::checkLicense(const QString &controllerID)
+{
+    if (licenseStarted)
+    {
+        return;
+    }
+    licenseStarted = true;
+    setStage("license", "checking");
+
+    Settings *settingsPtr = &settings;
+    SystemKeyStore *storePtr = &store;
+    const bool registering = newDevice;
+    // the worker never touches this object, which may be gone when it ends (the
+    // activation prompt waits on stdin): the result comes back through finished(),
+    // disconnected if we are destroyed first
+    auto valid = std::make_shared<bool>(false);
+    QThread *worker = QThread::create([settingsPtr, storePtr, controllerID, registering, valid]() {
+        *valid = validateLicense(*settingsPtr, *storePtr, controllerID, registering);
+    });
+    connect(worker, &QThread::finished, this, [this, controllerID, valid]() {
+        onLicenseChecked(controllerID, *valid);
+    });
+    connect(worker, &QThread::finished, worker, &QObject::deleteLater);
+    worker->start();
+}
+
+void StartupSequence::onLicenseChecked(const QString &controllerID, bool valid)
+{
+    licensedID = controllerID;
+    license = valid ? LICENSE_VALID : LICENSE_INVALID;
+    MYDEBUG << "License checked after" << clock.elapsed() << "ms:" << valid;
+    decide();
+}
+
+void StartupSequence::decide()
+{
+    if (decided || serialID.isEmpty() || license == LICENSE_PENDING)
+    {
+        return;
+    }
+    decided = true;
+
+    registered = license == LICENSE_VALID && licensedID == serialID;
+    if (license == LICENSE_VALID && !registered)
+    {
+        MYWARNING << "The license belongs to controller" << licensedID << "not to" << serialID << ". System in test mode.";
+    }
+    setStage("license", registered ? "valid" : "test mode");
+
+    MYINFO << "Startup decided after" << clock.elapsed() << "ms," << (registered ? "registered" : "test mode");
+    emit ready(registered);
+
+    if (registered)
+    {
+        startDatabase();
+    }
+    else
+    {
+        setStage("database", "disabled");
+    }
+}
+
+void StartupSequence::startDatabase()
+{
+    MYDEBUG << "Available SQL drivers:" << QSqlDatabase::drivers();
+
+    if (!QSqlDatabase::isDriverAvailable("QMARIADB" /* "QMYSQL" */))
+    {
+        MYCRITICAL << "QMYSQL driver is not available, System in test mode.!";
+        registered = false;
+        setStage("database", "disabled");
+        return;
+    }
+
+    QString dbHost = settings.dbAccountUrl.section(':', 0, 0);
+    int dbPort = settings.dbAccountUrl.section(':', 1, 1).toInt();
+    if (dbPort <= 0)
+    {
+        dbPort = 3306;
+    }
+
+    // Il DB gira in un thread dedicato, così le query lanciate dalla GUI
+    // non bloccano l'event loop principale
+    dbIf = new MariaDBInterface();
+    dbIf->examCache()->setBudget(qint64(settings.examCacheMB) * 1024 * 1024);
+    dbIf->moveToThread(&dbThread);
+    dbThread.setObjectName("database");
+    connect(&dbThread, &QThread::finished, dbIf, &QObject::deleteLater);
+    dbThread.start();
+
+    setStage("database", "connecting");
+
+    // Le richieste della GUI vengono accodate dopo questa, quindi trovano il DB già aperto
+    MariaDBInterface *db = dbIf;
+    QString dbUser = settings.dbAccountUser;
+    QString dbPassword = settings.dbAccountPassword;
+    QMetaObject::invokeMethod(db, [this, db, dbHost, dbPort, dbUser, dbPassword]() {
+        const bool ok = db->connect(dbHost, dbPort, dbUser, dbPassword) && db->ensureDatabaseAndTables();
+        QMetaObject::invokeMethod(this, [this, db, ok]() {
+            setStage("database", ok ? "ok" : "failed");
+            if (ok)
+            {
+                MYINFO << "Database ready after" << clock.elapsed() << "ms";
+                emit databaseReady(db);
+            }
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+void StartupSequence::shutdown()
+{
+    dbThread.quit();
+    dbThread.wait();
+}
+
+void StartupSequence::setStage(const QString &stage, const QString &state)
+{
+    MYDEBUG << "Startup:" << stage << state;
+    emit stageChanged(stage, state);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QElapsedTimer>
+#include "settings.h"
+
+class SystemKeyStore;
+class ControllerInterface;
+class MariaDBInterface;
+class SerialPortDiscovery;
+
+// Startup after the servers are listening, driven by events instead of blocking
+// main(): the controller is probed asynchronously (and again every PROBE_RETRY_MS
+// while it does not answer) on the saved port; with auto-discovery enabled in the
+// settings, only if that fails, on every serial port at once (SerialPortDiscovery).
+// The license is checked in a worker thread at the
+// same time, against the controller the stored token was issued for. When both
+// are known the system is registered or in test mode, and only when registered
+// the database thread is started. Every step is reported with stageChanged():
+//
+//   controller   probing, ok, not found
+//   license      checking, valid, renewed, invalid, test mode
+//   database     waiting, connecting, ok, failed, disabled
+class StartupSequence : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int PROBE_RETRY_MS = 5000;
+
+    StartupSequence(Settings &settings, SystemKeyStore &store, ControllerInterface *controller,
+                    QObject *parent = nullptr);
+
+    void start(bool newDevice);
+    void shutdown();                    // stops the database thread
+
+    bool isRegistered() const { return registered; }
+    MariaDBInterface *database() const { return dbIf; }
+
+signals:
+    void stageChanged(const QString &stage, const QString &state);
+    void ready(bool registered);        // controller and license known
+    void databaseReady(MariaDBInterface *db);
+
+private:
+    enum ELicenseState
+    {
+        LICENSE_PENDING,
+        LICENSE_VALID,
+        LICENSE_INVALID
+    };
+
+    void probeController();
+    void onSerialNumber(const QString &serialID);
+    void onPortFound(const QString &portName, const QString &serialID);
+    void checkLicense(const QString &controllerID);
+    void onLicenseChecked(const QString &controllerID, bool valid);
+    void decide();
+    void startDatabase();
+    void setStage(const QString &stage, const QString &state);
+
+    Settings &settings;
+    SystemKeyStore &store;
+    ControllerInterface *controller;
+    bool newDevice = false;
+    SerialPortDiscovery *discovery = nullptr;
+    bool discovering = false;           // the saved port did not answer, trying them all
+
+    QString serialID;                   // from the controller
+    QString licensedID;                 // controller the license was checked for
+    ELicenseState license = LICENSE_PENDING;
+    bool licenseStarted = false;
+    bool decided = false;
+    bool registered = false;
+
+    QThread dbThread;
+    MariaDBInterface *dbIf = nullptr;
+    QElapsedTimer clock;
+};
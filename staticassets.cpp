@@ -0,0 +1,215 @@
+#include "staticassets.h"
+#include "settings.h"
+#include <QHttpServerRequest>
+#include <QHttpHeaders>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QLocale>
+#include <QMimeDatabase>
+#include <QtEndian>
+
+static const char CACHE_CONTROL[] = "no-cache";     // always revalidate, the ETag makes it a 304
+
+StaticAssetService::StaticAssetService(const QString &rootPath, QObject *parent)
+    : QObject(parent),
+      root(QDir(rootPath).absolutePath())
+{
+    connect(&watcher, &QFileSystemWatcher::fileChanged, this, &StaticAssetService::onFileChanged);
+    connect(&watcher, &QFileSystemWatcher::directoryChanged, this, &StaticAssetService::onDirectoryChanged);
+}
+
+static const QStringList &assetPatterns()
+{
+    static const QStringList patterns = { "*.html", "*.htm", "*.js", "*.css", "*.json", "*.svg",
+                                          "*.png", "*.jpg", "*.ico", "*.woff2" };
+    return patterns;
+}
+
+int StaticAssetService::load()
+{
+    assets.clear();
+
+    // only the top level: the root is the working directory and may hold anything below
+    const QFileInfoList entries = QDir(root).entryInfoList(assetPatterns(), QDir::Files);
+    for (const QFileInfo &fi : entries)
+    {
+        loadFile(fi.absoluteFilePath());
+    }
+
+    watcher.addPath(root);
+    MYDEBUG << "Static assets:" << assets.size() << "files from" << root;
+    return assets.size();
+}
+
+QString StaticAssetService::key(const QString &filePath) const
+{
+    return QDir(root).relativeFilePath(filePath);
+}
+
+bool StaticAssetService::loadFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        assets.remove(key(filePath));
+        return false;
+    }
+
+    static const QMimeDatabase mimeDb;
+    const QMimeType mime = mimeDb.mimeTypeForFile(filePath, QMimeDatabase::MatchExtension);
+
+    Asset asset;
+    asset.data = file.readAll();
+    asset.mimeType = mime.name().toLatin1();
+    if (mime.inherits("text/plain") || asset.mimeType.endsWith("javascript")
+        || asset.mimeType.endsWith("json") || asset.mimeType.endsWith("xml"))
+    {
+        asset.mimeType += "; charset=utf-8";
+        const QByteArray gz = gzip(asset.data);
+        if (gz.size() < asset.data.size())
+        {
+            asset.gzipped = gz;
+        }
+    }
+    asset.etag = '"' + QCryptographicHash::hash(asset.data, QCryptographicHash::Sha256).toHex().left(32) + '"';
+    asset.modified = QFileInfo(file).lastModified();
+
+    assets.insert(key(filePath), asset);
+    if (!watcher.files().contains(filePath))
+    {
+        watcher.addPath(filePath);
+    }
+    return true;
+}
+
+void StaticAssetService::onFileChanged(const QString &filePath)
+{
+    // editors often replace the file: the watch is lost and has to be added again
+    MYDEBUG << "Static asset changed:" << filePath;
+    watcher.removePath(filePath);
+    if (QFile::exists(filePath))
+    {
+        loadFile(filePath);
+    }
+    else
+    {
+        assets.remove(key(filePath));
+    }
+}
+
+void StaticAssetService::onDirectoryChanged(const QString &dirPath)
+{
+    // files added after startup
+    const QFileInfoList entries = QDir(dirPath).entryInfoList(assetPatterns(), QDir::Files);
+    for (const QFileInfo &fi : entries)
+    {
+        if (!assets.contains(key(fi.absoluteFilePath())))
+        {
+            loadFile(fi.absoluteFilePath());
+        }
+    }
+}
+
+QHttpServerResponse StaticAssetService::serve(const QString &path, const QHttpServerRequest &request) const
+{
+    QString name = path;
+    while (name.startsWith('/'))
+    {
+        name.remove(0, 1);
+    }
+    if (name.isEmpty())
+    {
+        name = "index.html";
+    }
+
+    // only preloaded files are served, so "../" cannot escape the root
+    auto it = assets.constFind(name);
+    if (it == assets.cend())
+    {
+        return QHttpServerResponse(QHttpServerResponder::StatusCode::NotFound);
+    }
+    const Asset &asset = it.value();
+
+    const QHttpHeaders requestHeaders = request.headers();
+    const QByteArray ifNoneMatch = requestHeaders.value(QHttpHeaders::WellKnownHeader::IfNoneMatch).toByteArray();
+    if (!ifNoneMatch.isEmpty() && (ifNoneMatch.trimmed() == "*" || ifNoneMatch.contains(asset.etag)))
+    {
+        QHttpServerResponse notModified(QHttpServerResponder::StatusCode::NotModified);
+        QHttpHeaders headers;
+        headers.append(QHttpHeaders::WellKnownHeader::ETag, asset.etag);
+        headers.append(QHttpHeaders::WellKnownHeader::CacheControl, CACHE_CONTROL);
+        notModified.setHeaders(std::move(headers));
+        return notModified;
+    }
+
+    const bool useGzip = !asset.gzipped.isEmpty()
+                         && requestHeaders.value(QHttpHeaders::WellKnownHeader::AcceptEncoding).toByteArray().contains("gzip");
+
+    QHttpServerResponse response(asset.mimeType, useGzip ? asset.gzipped : asset.data);
+    QHttpHeaders headers = response.headers();
+    headers.append(QHttpHeaders::WellKnownHeader::ETag, asset.etag);
+    headers.append(QHttpHeaders::WellKnownHeader::CacheControl, CACHE_CONTROL);
+    headers.append(QHttpHeaders::WellKnownHeader::LastModified,
+                   QLocale::c().toString(asset.modified.toUTC(), "ddd, dd MMM yyyy hh:mm:ss 'GMT'").toLatin1());
+    if (!asset.gzipped.isEmpty())
+    {
+        headers.append(QHttpHeaders::WellKnownHeader::Vary, "Accept-Encoding");
+    }
+    if (useGzip)
+    {
+        headers.append(QHttpHeaders::WellKnownHeader::ContentEncoding, "gzip");
+    }
+    response.setHeaders(std::move(headers));
+    return response;
+}
+
+// CRC-32 (IEEE) for the gzip trailer
+static quint32 crc32(const QByteArray &data)
+{
+    static quint32 table[256];
+    static bool tableReady = false;
+    if (!tableReady)
+    {
+        for (quint32 i = 0; i < 256; ++i)
+        {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+
+    quint32 crc = 0xFFFFFFFFu;
+    for (const char ch : data)
+    {
+        crc = table[(crc ^ quint8(ch)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+QByteArray StaticAssetService::gzip(const QByteArray &data)
+{
+    // qCompress() gives a 4 byte length + zlib stream (2 byte header, raw deflate,
+    // 4 byte adler32): the raw deflate is rewrapped with the gzip header and trailer
+    const QByteArray zlib = qCompress(data, 9);
+    if (zlib.size() < 4 + 2 + 4)
+    {
+        return {};
+    }
+
+    QByteArray out;
+    out.reserve(zlib.size() + 12);
+    static const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 2, '\xff' };
+    out.append(header, sizeof(header));
+    out.append(zlib.constData() + 6, zlib.size() - 6 - 4);
+
+    char trailer[8];
+    qToLittleEndian<quint32>(crc32(data), trailer);
+    qToLittleEndian<quint32>(quint32(data.size()), trailer + 4);
+    out.append(trailer, sizeof(trailer));
+    return out;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QByteArray>
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QHttpServerResponse>
+
+class QHttpServerRequest;
+
+// Serves the files of a directory (the web GUI) from memory. Every file is read
+// and, for text types, gzip-compressed once, then kept with a strong ETag so that
+// a reload costs a 304. Files are reloaded when the watcher sees them change.
+class StaticAssetService : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StaticAssetService(const QString &rootPath, QObject *parent = nullptr);
+
+    int load();        // number of assets loaded
+
+    // 'path' relative to the root, "" or "/" is index.html
+    QHttpServerResponse serve(const QString &path, const QHttpServerRequest &request) const;
+
+    static QByteArray gzip(const QByteArray &data);
+
+private slots:
+    void onFileChanged(const QString &filePath);
+    void onDirectoryChanged(const QString &dirPath);
+
+private:
+    struct Asset
+    {
+        QByteArray mimeType;
+        QByteArray data;
+        QByteArray gzipped;         // empty when compression does not pay off
+        QByteArray etag;            // quoted, strong
+        QDateTime modified;
+    };
+
+    bool loadFile(const QString &filePath);
+    QString key(const QString &filePath) const;
+
+    QString root;
+    QHash<QString, Asset> assets;   // by path relative to root, '/' separated
+    QFileSystemWatcher watcher;
+};
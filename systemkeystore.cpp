@@ -26,6 +26,11 @@ SystemKeyStore::SystemKeyStore(QObject *parent)
 
 QByteArray SystemKeyStore::getToken()
 {
+    if (tokenLoaded)
+    {
+        return cachedToken;
+    }
+
     QByteArray token = readToken();
 
     if (token.isEmpty())
@@ -37,7 +42,9 @@ QByteArray SystemKeyStore::getToken()
         MYDEBUG << "[SystemKeyStore] Loaded existing hum_token:" << token;
     }
 
-    return  QByteArray::fromHex(token);
+    cachedToken = QByteArray::fromHex(token);
+    tokenLoaded = true;
+    return cachedToken;
 }
 
 void SystemKeyStore::createTempToken(QString& ctrlID)
@@ -99,6 +106,11 @@ bool SystemKeyStore::isTokenExpired(QString& ctrlID)
 void SystemKeyStore::setToken(const QByteArray &token)
 {
     writeToken(token);
+
+    // same result as reading it back from the registry
+    tempToken = HumToken::fromByteArray(token);
+    cachedToken = QByteArray::fromHex(tempToken.toByteArray());
+    tokenLoaded = true;
 }
 
 void SystemKeyStore::writeToken(const QByteArray &token)
@@ -120,6 +132,13 @@ QByteArray SystemKeyStore::readToken()
 }
 
 QByteArray SystemKeyStore::getFingerprint()
+{
+    // interfaces enumeration, hostname lookup and hash: once, the hardware does not change
+    static const QByteArray fingerprint = computeFingerprint();
+    return fingerprint;
+}
+
+QByteArray SystemKeyStore::computeFingerprint()
 {
     QByteArray hwInfo;
 
@@ -27,16 +27,31 @@ public:
         return tempToken.getCheckTime().toString();
     }
 
+    // the token is valid while this date is in the future
+    QDate checkDate() const
+    {
+        return tempToken.getCheckTime();
+    }
+
+    // controller the stored token was issued for, empty without a token
+    QString tokenControllerID() const
+    {
+        return tempToken.getControllerID().trimmed();
+    }
+
     bool isTokenStillValid(QString ctrlID);
     bool isTokenExpired(QString& ctrlID);
 
 private:
     QSettings *registry;
-    HumToken tempToken;
+    HumToken tempToken;             // parsed once, kept in sync by setToken()
+    QByteArray cachedToken;
+    bool tokenLoaded = false;
 
     QByteArray readToken();
     void writeToken(const QByteArray &token);
-    QByteArray getFingerprint();  // UUID derived from hardware identity
+    QByteArray getFingerprint();  // UUID derived from hardware identity, computed once per process
+    static QByteArray computeFingerprint();
 
 
 };
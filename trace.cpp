@@ -0,0 +1,224 @@
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QThread>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+
+// One thread's spans. Only the owning thread writes; chromeTrace() reads while it
+// writes, so the fields are relaxed atomics and 'head' (release/acquire) tells how
+// far the ring is complete. Slots overwritten during a read are detected by
+// reading 'head' again and are skipped.
+struct ThreadBuffer
+{
+    struct Event
+    {
+        std::atomic<const char *> category;
+        std::atomic<const char *> name;
+        std::atomic<qint64> startNs;
+        std::atomic<qint64> durationNs;
+    };
+
+    explicit ThreadBuffer(int id)
+        : id(id), events(new Event[HumTrace::EVENTS_PER_THREAD])
+    {
+    }
+
+    const int id;
+    std::unique_ptr<Event[]> events;
+    std::atomic<quint64> head{0};
+    std::atomic<bool> retired{false};
+
+    std::mutex nameMutex;
+    QString name;
+};
+
+const int MAX_RETIRED = 8;      // rings of finished threads still dumped
+
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    int nextID = 1;
+};
+
+Registry &registry()
+{
+    static Registry reg;
+    return reg;
+}
+
+// Marks the ring as retired when its thread ends, the registry drops the oldest
+// retired rings beyond MAX_RETIRED
+struct ThreadSlot
+{
+    ~ThreadSlot()
+    {
+        if (buffer)
+        {
+            buffer->retired.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    std::shared_ptr<ThreadBuffer> buffer;
+};
+
+thread_local ThreadSlot threadSlot;
+
+ThreadBuffer *currentBuffer()
+{
+    if (threadSlot.buffer)
+    {
+        return threadSlot.buffer.get();
+    }
+
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    int retired = 0;
+    for (auto it = reg.buffers.rbegin(); it != reg.buffers.rend(); ++it)
+    {
+        if ((*it)->retired.load(std::memory_order_relaxed) && ++retired > MAX_RETIRED)
+        {
+            reg.buffers.erase(std::next(it).base());
+            break;                  // at most one per new thread is enough to stay bounded
+        }
+    }
+
+    auto buffer = std::make_shared<ThreadBuffer>(reg.nextID++);
+    const QString objectName = QThread::currentThread()->objectName();
+    buffer->name = objectName.isEmpty() ? QString("thread %1").arg(buffer->id) : objectName;
+    reg.buffers.push_back(buffer);
+    threadSlot.buffer = buffer;
+    return buffer.get();
+}
+
+void appendJsonString(QByteArray &out, const QString &text)
+{
+    out += '"';
+    for (const char c : text.toUtf8())
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (uchar(c) < 0x20)
+        {
+            out += ' ';
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+void HumTrace::setThreadName(const QString &name)
+{
+    ThreadBuffer *buffer = currentBuffer();
+    std::lock_guard<std::mutex> lock(buffer->nameMutex);
+    buffer->name = name;
+}
+
+qint64 HumTrace::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void HumTrace::record(const char *category, const char *name, qint64 startNs, qint64 durationNs)
+{
+    ThreadBuffer *buffer = currentBuffer();
+    const quint64 head = buffer->head.load(std::memory_order_relaxed);
+    ThreadBuffer::Event &event = buffer->events[head % EVENTS_PER_THREAD];
+    event.category.store(category, std::memory_order_relaxed);
+    event.name.store(name, std::memory_order_relaxed);
+    event.startNs.store(startNs, std::memory_order_relaxed);
+    event.durationNs.store(durationNs, std::memory_order_relaxed);
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+QByteArray HumTrace::chromeTrace(int seconds)
+{
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffers = reg.buffers;
+    }
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    const qint64 sinceNs = nowNs() - qint64(qMax(1, seconds)) * 1000000000;
+
+    QByteArray out;
+    out.reserve(1024 * 1024);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&out, &first]() {
+        if (!first)
+        {
+            out += ",\n";
+        }
+        first = false;
+    };
+
+    for (const auto &buffer : buffers)
+    {
+        QString name;
+        {
+            std::lock_guard<std::mutex> lock(buffer->nameMutex);
+            name = buffer->name;
+        }
+        separator();
+        out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + QByteArray::number(pid)
+               + ",\"tid\":" + QByteArray::number(buffer->id) + ",\"args\":{\"name\":";
+        appendJsonString(out, name);
+        out += "}}";
+
+        const quint64 head = buffer->head.load(std::memory_order_acquire);
+        const quint64 begin = head > quint64(EVENTS_PER_THREAD) ? head - EVENTS_PER_THREAD : 0;
+        struct Copy { const char *category; const char *name; qint64 startNs; qint64 durationNs; };
+        std::vector<Copy> copies;
+        copies.reserve(head - begin);
+        for (quint64 i = begin; i < head; i++)
+        {
+            const ThreadBuffer::Event &event = buffer->events[i % EVENTS_PER_THREAD];
+            copies.push_back({ event.category.load(std::memory_order_relaxed), event.name.load(std::memory_order_relaxed),
+                               event.startNs.load(std::memory_order_relaxed), event.durationNs.load(std::memory_order_relaxed) });
+        }
+
+        // the owner kept writing meanwhile: slots below this index may hold newer spans,
+        // and the slot of event headAfter (the one of headAfter - EVENTS_PER_THREAD)
+        // may be half written
+        const quint64 headAfter = buffer->head.load(std::memory_order_acquire);
+        const quint64 validFrom = headAfter >= quint64(EVENTS_PER_THREAD) ? headAfter - EVENTS_PER_THREAD + 1 : 0;
+
+        for (quint64 i = qMax(begin, validFrom); i < head; i++)
+        {
+            const Copy &event = copies[i - begin];
+            if (event.startNs + event.durationNs < sinceNs || !event.name)
+            {
+                continue;
+            }
+            separator();
+            out += "{\"ph\":\"X\",\"cat\":\"";
+            out += event.category;
+            out += "\",\"name\":\"";
+            out += event.name;
+            out += "\",\"pid\":" + QByteArray::number(pid) + ",\"tid\":" + QByteArray::number(buffer->id)
+                   + ",\"ts\":" + QByteArray::number(double(event.startNs) / 1000.0, 'f', 3)
+                   + ",\"dur\":" + QByteArray::number(double(event.durationNs) / 1000.0, 'f', 3) + "}";
+        }
+    }
+    out += "]}\n";
+    return out;
+}
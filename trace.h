@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+
+// Scoped trace spans for finding out which stage made a frame late.
+//
+//     void FrameStreamServer::flush()
+//     {
+//         HUM_TRACE("stream", "flush");
+//         ...
+//
+// Each thread records completed spans into its own ring (the last EVENTS_PER_THREAD
+// spans are kept, older ones are overwritten): no lock and no allocation on the
+// recording side once the ring exists. While tracing is off a span costs one relaxed
+// load. chromeTrace() turns the last seconds of every ring into Chrome trace JSON
+// ("Trace Event Format"), which Perfetto and chrome://tracing open directly.
+// Defining HUM_NO_TRACE removes the spans from the build.
+//
+// Names and categories must be string literals: only the pointers are stored.
+
+class HumTrace
+{
+public:
+    static const int EVENTS_PER_THREAD = 16384;     // 512 KB per thread that records
+
+    static void setEnabled(bool on) { enabledFlag().store(on, std::memory_order_relaxed); }
+    static bool isEnabled() { return enabledFlag().load(std::memory_order_relaxed); }
+
+    // Shown as the track name, by default the QThread objectName or "thread N"
+    static void setThreadName(const QString &name);
+
+    static qint64 nowNs();
+    static void record(const char *category, const char *name, qint64 startNs, qint64 durationNs);
+
+    // Spans that ended in the last 'seconds', all threads
+    static QByteArray chromeTrace(int seconds);
+
+private:
+    static std::atomic<bool> &enabledFlag()
+    {
+        static std::atomic<bool> enabled{false};
+        return enabled;
+    }
+};
+
+class TraceScope
+{
+public:
+    TraceScope(const char *category, const char *name)
+        : category(category), name(name), startNs(HumTrace::isEnabled() ? HumTrace::nowNs() : -1)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (startNs >= 0)
+        {
+            HumTrace::record(category, name, startNs, HumTrace::nowNs() - startNs);
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *category;
+    const char *name;
+    qint64 startNs;
+};
+
+#define HUM_TRACE_CONCAT2(a, b)     a##b
+#define HUM_TRACE_CONCAT(a, b)      HUM_TRACE_CONCAT2(a, b)
+
+#ifdef HUM_NO_TRACE
+#define HUM_TRACE(category, name)   do {} while (0)
+#else
+#define HUM_TRACE(category, name)   TraceScope HUM_TRACE_CONCAT(humTraceScope, __LINE__)(category, name)
+#endif
@@ -4,31 +4,104 @@
 #include <QWebSocket>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include "compactjson.h"
+#include "metrics.h"
+#include "trace.h"
 
+// QWebChannel messages travel as UTF-8 JSON in binary WebSocket frames: no
+// QString in between, neither when sending nor when receiving. Text frames
+// are still accepted from clients that send them.
+//
+// QWebChannel runs an invoked method while the message is being delivered, so
+// current() tells a Q_INVOKABLE which client called it (nullptr outside calls).
 class WebSocketTransport : public QWebChannelAbstractTransport {
     Q_OBJECT
 public:
     explicit WebSocketTransport(QWebSocket *socket, QObject *parent = nullptr)
         : QWebChannelAbstractTransport(parent), m_socket(socket) {
+        connect(m_socket, &QWebSocket::binaryMessageReceived,
+                this, &WebSocketTransport::onBinaryMessageReceived);
         connect(m_socket, &QWebSocket::textMessageReceived,
                 this, &WebSocketTransport::onTextMessageReceived);
     }
 
+    // QWebChannel broadcasts property updates and signals by calling sendMessage()
+    // on every transport with the same QJsonObject: it is serialised for the first
+    // one and the shared bytes are reused for the others (operator== on the same
+    // shared data returns immediately).
     void sendMessage(const QJsonObject &message) override {
-        QJsonDocument doc(message);
-        m_socket->sendTextMessage(QString::fromUtf8(doc.toJson(QJsonDocument::Compact)));
+        HUM_TRACE("ws", "channel.send");
+        const QByteArray &utf8 = serialise(message);
+        m_socket->sendBinaryMessage(utf8);
+        metrics().channelMessagesSent.add();
+        metrics().channelBytesSent.add(quint64(utf8.size()));
     }
 
-private slots:
-    void onTextMessageReceived(const QString &message) {
+    // Serialises into a buffer shared by all transports (they all live in the main
+    // thread). The buffer keeps its capacity: sendBinaryMessage() copies the bytes
+    // into the socket, so no one else holds a reference when the next message comes.
+    static const QByteArray &serialise(const QJsonObject &message) {
+        SerialisedMessage &last = lastSerialised();
+        if (last.valid && last.message == message)
+            return last.utf8;
+
+        last.message = message;
+        last.utf8.resize(0);
+        writeCompactJson(message, last.utf8);
+        last.valid = true;
+        return last.utf8;
+    }
+
+    static WebSocketTransport *current() { return currentTransport(); }
+
+    static bool parse(const QByteArray &utf8, QJsonObject &message) {
         QJsonParseError error;
-        QJsonDocument doc = QJsonDocument::fromJson(message.toUtf8(), &error);
-        if (error.error == QJsonParseError::NoError && doc.isObject())
-            emit messageReceived(doc.object(), this);
-        else
+        QJsonDocument doc = QJsonDocument::fromJson(utf8, &error);
+        if (error.error != QJsonParseError::NoError || !doc.isObject()) {
             qWarning() << "Errore parsing JSON:" << error.errorString();
+            return false;
+        }
+        message = doc.object();
+        return true;
+    }
+
+private slots:
+    void onBinaryMessageReceived(const QByteArray &message) {
+        QJsonObject object;
+        if (parse(message, object))
+            deliver(object);
+    }
+
+    void onTextMessageReceived(const QString &message) {
+        QJsonObject object;
+        if (parse(message.toUtf8(), object))
+            deliver(object);
     }
 
 private:
+    void deliver(const QJsonObject &object) {
+        WebSocketTransport *&active = currentTransport();
+        WebSocketTransport *previous = active;
+        active = this;
+        emit messageReceived(object, this);
+        active = previous;
+    }
+
+    static WebSocketTransport *&currentTransport() {
+        static WebSocketTransport *transport = nullptr;    // main thread only
+        return transport;
+    }
+
+    struct SerialisedMessage {
+        QJsonObject message;
+        QByteArray utf8;
+        bool valid = false;
+    };
+
+    static SerialisedMessage &lastSerialised() {
+        static SerialisedMessage last;
+        return last;
+    }
+
     QWebSocket *m_socket;
 };